@@ -0,0 +1,89 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+// Minimal benchmark harness. Each benchmark reports the mean wall time and the
+// mean number of RichErrors allocations per operation. Allocations are counted
+// by installing a forwarding allocator via RERR_Allocator_Set().
+
+#include "RichErrors/RichErrors.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace bench {
+
+inline std::atomic<std::uint64_t> &AllocationCount() {
+    static std::atomic<std::uint64_t> count{0};
+    return count;
+}
+
+inline RERR_Allocator &BaseAllocator() {
+    static RERR_Allocator base;
+    return base;
+}
+
+inline void *CountingAlloc(void *context, size_t size) {
+    (void)context;
+    AllocationCount().fetch_add(1, std::memory_order_relaxed);
+    return BaseAllocator().alloc(BaseAllocator().context, size);
+}
+
+inline void *CountingRealloc(void *context, void *ptr, size_t size) {
+    (void)context;
+    AllocationCount().fetch_add(1, std::memory_order_relaxed);
+    return BaseAllocator().realloc(BaseAllocator().context, ptr, size);
+}
+
+inline void CountingFree(void *context, void *ptr) {
+    (void)context;
+    BaseAllocator().free(BaseAllocator().context, ptr);
+}
+
+/// Install the counting allocator; call at the start of main().
+inline void InstallCountingAllocator() {
+    RERR_Allocator_Get(&BaseAllocator());
+    RERR_Allocator counting{CountingAlloc, CountingRealloc, CountingFree,
+                            nullptr};
+    RERR_ErrorPtr err = RERR_Allocator_Set(&counting);
+    RERR_Error_Destroy(err);
+}
+
+/// Print the result of a benchmark.
+inline void Report(std::string const &name, double nsPerOp,
+                   double allocsPerOp) {
+    std::printf("%-44s %10.1f ns/op %8.2f allocs/op\n", name.c_str(), nsPerOp,
+                allocsPerOp);
+    std::fflush(stdout);
+}
+
+/// Time op (called with no arguments) and report ns/op and allocs/op.
+/**
+ * The number of iterations is doubled until the total time is at least 100
+ * milliseconds.
+ */
+template <typename F> void Run(std::string const &name, F &&op) {
+    using Clock = std::chrono::steady_clock;
+    for (std::uint64_t iterations = 1;; iterations *= 2) {
+        std::uint64_t allocsBefore = AllocationCount().load();
+        auto start = Clock::now();
+        for (std::uint64_t i = 0; i < iterations; ++i) {
+            op();
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+            Clock::now() - start;
+        std::uint64_t allocs = AllocationCount().load() - allocsBefore;
+        if (elapsed.count() >= 1e8 || iterations >= (1u << 30)) {
+            Report(name, elapsed.count() / iterations,
+                   static_cast<double>(allocs) / iterations);
+            return;
+        }
+    }
+}
+
+} // namespace bench
@@ -0,0 +1,122 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Benchmark: error map register/retrieve round trips under concurrency. The
+// reported time is per round trip on each thread, so perfect scaling shows as
+// constant time regardless of thread count. Batch round trips on a single
+// thread are reported per error. A map declared single-threaded, which is
+// used without locking, is measured on one thread.
+
+#include "Bench.hpp"
+
+#include "RichErrors/Err2Code.h"
+#include "RichErrors/RichErrors.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int roundTripsPerThread = 20000;
+
+void RoundTrips(RERR_ErrorMapPtr map, RERR_ErrorPtr proto) {
+    for (int i = 0; i < roundTripsPerThread; ++i) {
+        RERR_ErrorPtr err;
+        RERR_Error_Copy(proto, &err);
+        int32_t code = RERR_ErrorMap_RegisterThreadLocal(map, err);
+        RERR_Error_Destroy(RERR_ErrorMap_RetrieveThreadLocal(map, code));
+    }
+}
+
+} // namespace
+
+int main() {
+    bench::InstallCountingAllocator();
+
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 1000000;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+    RERR_ErrorMapPtr map;
+    RERR_Error_Destroy(RERR_ErrorMap_Create(&map, &config));
+
+    RERR_ErrorPtr proto = RERR_Error_CreateStatic("Something failed");
+
+    for (int nThreads : {1, 2, 4, 8, 16, 64}) {
+        std::uint64_t allocsBefore = bench::AllocationCount().load();
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nThreads; ++t) {
+            threads.emplace_back(RoundTrips, map, proto);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::uint64_t allocs =
+            bench::AllocationCount().load() - allocsBefore;
+        double ops = static_cast<double>(roundTripsPerThread) * nThreads;
+        bench::Report("Register/Retrieve (" + std::to_string(nThreads) +
+                          " threads)",
+                      elapsed.count() * nThreads / ops, allocs / ops);
+    }
+
+    {
+        RERR_ErrorMapOptions options{};
+        options.flags = RERR_ErrorMapFlag_SingleThreaded;
+        RERR_ErrorMapPtr stMap;
+        RERR_Error_Destroy(
+            RERR_ErrorMap_CreateWithOptions(&stMap, &config, &options));
+        std::uint64_t allocsBefore = bench::AllocationCount().load();
+        auto start = std::chrono::steady_clock::now();
+        RoundTrips(stMap, proto);
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::uint64_t allocs =
+            bench::AllocationCount().load() - allocsBefore;
+        double ops = roundTripsPerThread;
+        bench::Report("Register/Retrieve (single-threaded map)",
+                      elapsed.count() / ops, allocs / ops);
+        RERR_ErrorMap_Destroy(stMap);
+    }
+
+    for (std::size_t batchSize : {64, 1024}) {
+        std::vector<RERR_ErrorPtr> errors(batchSize);
+        std::vector<int32_t> codes(batchSize);
+        std::uint64_t allocsBefore = bench::AllocationCount().load();
+        auto start = std::chrono::steady_clock::now();
+        std::size_t batches = roundTripsPerThread / batchSize;
+        for (std::size_t b = 0; b < batches; ++b) {
+            for (auto &err : errors) {
+                RERR_Error_Copy(proto, &err);
+            }
+            RERR_ErrorMap_RegisterThreadLocalBatch(map, errors.data(),
+                                                   batchSize, codes.data());
+            RERR_ErrorMap_RetrieveThreadLocalBatch(map, codes.data(),
+                                                   batchSize, errors.data());
+            for (auto err : errors) {
+                RERR_Error_Destroy(err);
+            }
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::uint64_t allocs =
+            bench::AllocationCount().load() - allocsBefore;
+        double ops = static_cast<double>(batches) * batchSize;
+        bench::Report("Batch Register/Retrieve (" +
+                          std::to_string(batchSize) + " per batch)",
+                      elapsed.count() / ops, allocs / ops);
+    }
+
+    RERR_Error_Destroy(proto);
+    RERR_ErrorMap_Destroy(map);
+    return 0;
+}
@@ -0,0 +1,67 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Benchmarks: error creation, destruction, wrapping, and code formatting.
+
+#include "Bench.hpp"
+
+#include "RichErrors/InfoMap.h"
+#include "RichErrors/RichErrors.h"
+
+#include <string>
+
+int main() {
+    bench::InstallCountingAllocator();
+
+    const char *domain = "ErrorBench";
+    RERR_Error_Destroy(RERR_Domain_Register(domain, RERR_CodeFormat_I32));
+    RERR_DomainHandle handle;
+    RERR_Error_Destroy(RERR_Domain_Lookup(domain, &handle));
+
+    bench::Run("Create/Destroy", [] {
+        RERR_Error_Destroy(RERR_Error_Create("Something failed"));
+    });
+
+    bench::Run("CreateStatic/Destroy", [] {
+        RERR_Error_Destroy(RERR_Error_CreateStatic("Something failed"));
+    });
+
+    bench::Run("CreateWithCode/Destroy", [domain] {
+        RERR_Error_Destroy(
+            RERR_Error_CreateWithCode(domain, 42, "Something failed"));
+    });
+
+    bench::Run("CreateWithDomainHandle/Destroy", [handle] {
+        RERR_Error_Destroy(RERR_Error_CreateWithDomainHandle(
+            handle, 42, "Something failed"));
+    });
+
+    bench::Run("CreateWithInfo(2 items)/Destroy", [domain] {
+        RERR_InfoMapPtr info = RERR_InfoMap_Create();
+        RERR_InfoMap_SetString(info, "path", "/some/file/path");
+        RERR_InfoMap_SetI64(info, "offset", 4096);
+        RERR_Error_Destroy(
+            RERR_Error_CreateWithInfo(domain, 42, info, "Something failed"));
+    });
+
+    for (int depth : {1, 4, 16, 64}) {
+        bench::Run("Wrap chain depth " + std::to_string(depth), [depth] {
+            RERR_ErrorPtr err = RERR_Error_Create("Root cause");
+            for (int i = 0; i < depth; ++i) {
+                err = RERR_Error_Wrap(err, "Context");
+            }
+            RERR_Error_Destroy(err);
+        });
+    }
+
+    RERR_ErrorPtr coded = RERR_Error_CreateWithCode(domain, -12345, "Failed");
+    bench::Run("FormatCode", [coded] {
+        char buf[RERR_FORMATTED_CODE_MAX_SIZE];
+        RERR_Error_FormatCode(coded, buf, sizeof(buf));
+    });
+    RERR_Error_Destroy(coded);
+
+    RERR_Domain_UnregisterAll();
+    return 0;
+}
@@ -0,0 +1,122 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Benchmark: hand an error (with cause and info) to a consumer thread, either
+// by reconstructing it from scratch (necessary when copies could not be
+// shared between threads) or by copying it (sharing via reference count).
+
+#include "Bench.hpp"
+
+#include "RichErrors/InfoMap.h"
+#include "RichErrors/RichErrors.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr int iterations = 200000;
+
+class Queue {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<RERR_ErrorPtr> items;
+
+  public:
+    void Push(RERR_ErrorPtr err) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(err);
+        }
+        cv.notify_one();
+    }
+
+    RERR_ErrorPtr Pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !items.empty(); });
+        RERR_ErrorPtr ret = items.front();
+        items.pop_front();
+        return ret;
+    }
+};
+
+RERR_ErrorPtr Reconstruct(RERR_ErrorPtr err) {
+    if (err == RERR_NO_ERROR) {
+        return RERR_NO_ERROR;
+    }
+    RERR_ErrorPtr cause = Reconstruct(RERR_Error_GetCause(err));
+    const char *domain =
+        RERR_Error_HasCode(err) ? RERR_Error_GetDomain(err) : nullptr;
+    RERR_InfoMapPtr shared = RERR_Error_GetInfo(err);
+    RERR_InfoMapPtr info = RERR_InfoMap_MutableCopy(shared);
+    RERR_InfoMap_Destroy(shared);
+    const char *message = RERR_Error_GetMessage(err);
+    if (cause == RERR_NO_ERROR) {
+        return RERR_Error_CreateWithInfo(domain, RERR_Error_GetCode(err), info,
+                                         message);
+    }
+    return RERR_Error_WrapWithInfo(cause, domain, RERR_Error_GetCode(err),
+                                   info, message);
+}
+
+RERR_ErrorPtr ShareCopy(RERR_ErrorPtr err) {
+    RERR_ErrorPtr ret;
+    RERR_Error_Copy(err, &ret);
+    return ret;
+}
+
+void RunHandoff(char const *name, RERR_ErrorPtr err,
+                RERR_ErrorPtr (*handoffCopy)(RERR_ErrorPtr)) {
+    Queue queue;
+    std::uint64_t allocsBefore = bench::AllocationCount().load();
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&queue] {
+        for (int i = 0; i < iterations; ++i) {
+            RERR_ErrorPtr received = queue.Pop();
+            (void)RERR_Error_GetMessage(received);
+            RERR_Error_Destroy(received);
+        }
+    });
+    for (int i = 0; i < iterations; ++i) {
+        queue.Push(handoffCopy(err));
+    }
+    consumer.join();
+    auto stop = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed = stop - start;
+    std::uint64_t allocs = bench::AllocationCount().load() - allocsBefore;
+    bench::Report(name, elapsed.count() / iterations,
+                  static_cast<double>(allocs) / iterations);
+}
+
+} // namespace
+
+int main() {
+    bench::InstallCountingAllocator();
+
+    const char *domain = "HandoffBench";
+    RERR_ErrorPtr err = RERR_Domain_Register(domain, RERR_CodeFormat_I32);
+    if (err != RERR_NO_ERROR) {
+        std::fprintf(stderr, "%s\n", RERR_Error_GetMessage(err));
+        return 1;
+    }
+
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(info, "path", "/some/file/path");
+    RERR_InfoMap_SetI64(info, "offset", 4096);
+    err = RERR_Error_CreateWithInfo(domain, 2, info,
+                                    "Read from device failed");
+    err = RERR_Error_WrapWithCode(err, domain, 1, "Could not load settings");
+
+    RunHandoff("Handoff by reconstruction", err, Reconstruct);
+    RunHandoff("Handoff by shared copy", err, ShareCopy);
+
+    RERR_Error_Destroy(err);
+    RERR_Domain_UnregisterAll();
+    return 0;
+}
@@ -0,0 +1,103 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Benchmarks: info map construction, lookup, and copying at various sizes.
+
+#include "Bench.hpp"
+
+#include "RichErrors/InfoMap.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> MakeKeys(std::size_t n) {
+    std::vector<std::string> keys;
+    for (std::size_t i = 0; i < n; ++i) {
+        keys.push_back("key" + std::to_string(i * 7919 % 1000));
+    }
+    return keys;
+}
+
+RERR_InfoMapPtr MakeMap(std::vector<std::string> const &keys) {
+    RERR_InfoMapPtr map = RERR_InfoMap_Create();
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2) {
+            RERR_InfoMap_SetString(map, keys[i].c_str(), "some value");
+        } else {
+            RERR_InfoMap_SetI64(map, keys[i].c_str(),
+                                static_cast<int64_t>(i));
+        }
+    }
+    return map;
+}
+
+} // namespace
+
+int main() {
+    bench::InstallCountingAllocator();
+
+    for (std::size_t n : {1, 4, 16, 64, 256}) {
+        auto keys = MakeKeys(n);
+        std::string suffix = " (" + std::to_string(n) + " items)";
+
+        bench::Run("Set*/Destroy" + suffix,
+                   [&keys] { RERR_InfoMap_Destroy(MakeMap(keys)); });
+
+        std::vector<RERR_InfoMapInitItem> items(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            items[i].key = keys[i].c_str();
+            if (i % 2) {
+                items[i].type = RERR_InfoValueTypeString;
+                items[i].value.string = "some value";
+            } else {
+                items[i].type = RERR_InfoValueTypeI64;
+                items[i].value.i64 = static_cast<int64_t>(i);
+            }
+        }
+        bench::Run("CreateFromItems/Destroy" + suffix, [&items] {
+            RERR_InfoMap_Destroy(
+                RERR_InfoMap_CreateFromItems(items.data(), items.size(), 0));
+        });
+
+        RERR_InfoMapPtr map = MakeMap(keys);
+        bench::Run("Get* (all keys)" + suffix, [&keys, map] {
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                if (i % 2) {
+                    const char *s;
+                    RERR_InfoMap_GetString(map, keys[i].c_str(), &s);
+                } else {
+                    int64_t v;
+                    RERR_InfoMap_GetI64(map, keys[i].c_str(), &v);
+                }
+            }
+        });
+
+        bench::Run("MutableCopy/Destroy" + suffix, [map] {
+            RERR_InfoMap_Destroy(RERR_InfoMap_MutableCopy(map));
+        });
+
+        RERR_InfoMap_MakeImmutable(map);
+        bench::Run("Copy immutable/Destroy" + suffix, [map] {
+            RERR_InfoMap_Destroy(RERR_InfoMap_Copy(map));
+        });
+
+        // Adding context: base items plus one more, attached immutably
+        bench::Run("MutableCopy+Set/MakeImmutable" + suffix, [map] {
+            RERR_InfoMapPtr m = RERR_InfoMap_MutableCopy(map);
+            RERR_InfoMap_SetI64(m, "extra", 1);
+            RERR_InfoMap_MakeImmutable(m);
+            RERR_InfoMap_Destroy(m);
+        });
+        bench::Run("CreateOverlay+Set/MakeImmutable" + suffix, [map] {
+            RERR_InfoMapPtr m = RERR_InfoMap_CreateOverlay(map);
+            RERR_InfoMap_SetI64(m, "extra", 1);
+            RERR_InfoMap_MakeImmutable(m);
+            RERR_InfoMap_Destroy(m);
+        });
+        RERR_InfoMap_Destroy(map);
+    }
+    return 0;
+}
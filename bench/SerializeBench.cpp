@@ -0,0 +1,71 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+// Benchmarks: binary serialization and deserialization of error chains.
+
+#include "Bench.hpp"
+
+#include "RichErrors/InfoMap.h"
+#include "RichErrors/RichErrors.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main() {
+    bench::InstallCountingAllocator();
+
+    const char *domain = "SerializeBench";
+    RERR_Error_Destroy(RERR_Domain_Register(domain, RERR_CodeFormat_I32));
+
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(info, "path", "/some/file/path");
+    RERR_InfoMap_SetI64(info, "offset", 4096);
+    RERR_InfoMap_SetF64(info, "elapsed", 0.125);
+    RERR_ErrorPtr withInfo =
+        RERR_Error_CreateWithInfo(domain, 42, info, "Something failed");
+
+    RERR_ErrorPtr chain = RERR_Error_CreateWithCode(domain, 7, "Root cause");
+    for (int i = 0; i < 4; ++i) {
+        chain = RERR_Error_Wrap(chain, "While doing something");
+    }
+
+    struct Case {
+        const char *name;
+        RERR_ErrorPtr error;
+    };
+    for (Case c : {Case{"info (3 items)", withInfo},
+                   Case{"chain depth 5", chain}}) {
+        std::vector<unsigned char> buf(RERR_Error_Serialize(c.error, nullptr,
+                                                            0));
+        std::printf("Serialized size, %-28s %10zu bytes\n", c.name,
+                    buf.size());
+
+        RERR_ErrorPtr e = c.error;
+        bench::Run(std::string("Serialize ") + c.name, [e, &buf] {
+            RERR_Error_Serialize(e, buf.data(), buf.size());
+        });
+
+        bench::Run(std::string("Deserialize/Destroy ") + c.name, [&buf] {
+            RERR_ErrorPtr decoded;
+            RERR_Error_Destroy(RERR_Error_Deserialize(buf.data(), buf.size(),
+                                                      0, &decoded));
+            RERR_Error_Destroy(decoded);
+        });
+
+        bench::Run(std::string("Deserialize(borrow)/Destroy ") + c.name,
+                   [&buf] {
+                       RERR_ErrorPtr decoded;
+                       RERR_Error_Destroy(RERR_Error_Deserialize(
+                           buf.data(), buf.size(),
+                           RERR_DeserializeBorrowStrings, &decoded));
+                       RERR_Error_Destroy(decoded);
+                   });
+    }
+
+    RERR_Error_Destroy(withInfo);
+    RERR_Error_Destroy(chain);
+    RERR_Domain_UnregisterAll();
+    return 0;
+}
@@ -0,0 +1,261 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+/** \file
+ * \brief Statically described error code domains for the C++ interface.
+ */
+
+#ifndef __cplusplus
+#error This header is for C++ only.
+#endif
+
+#include "RichErrors/RichErrors.h"
+#include "RichErrors/RichErrors.hpp"
+#include "RichErrors/StringRef.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace RERR {
+
+namespace internal {
+
+// Compile-time equivalents of the checks made by RERR_Domain_Register().
+
+constexpr bool IsValidCodeFormat(RERR_CodeFormat format) noexcept {
+    switch (format & ~RERR_CodeFormat_HexNoPad) {
+    case RERR_CodeFormat_I32:
+    case RERR_CodeFormat_U32:
+    case RERR_CodeFormat_Hex32:
+    case RERR_CodeFormat_I32 | RERR_CodeFormat_Hex32:
+    case RERR_CodeFormat_U32 | RERR_CodeFormat_Hex32:
+    case RERR_CodeFormat_I16:
+    case RERR_CodeFormat_U16:
+    case RERR_CodeFormat_Hex16:
+    case RERR_CodeFormat_I16 | RERR_CodeFormat_Hex16:
+    case RERR_CodeFormat_U16 | RERR_CodeFormat_Hex16:
+        return true;
+    default:
+        return false;
+    }
+}
+
+constexpr bool IsValidDomainName(const char *name) noexcept {
+    std::size_t len = 0;
+    for (; name[len] != '\0'; ++len) {
+        if (name[len] < ' ' || name[len] > '~' || len == 63) {
+            return false;
+        }
+    }
+    return len > 0;
+}
+
+// Whether Traits provides a message catalog, Traits::Message(CodeType).
+template <typename Traits, typename = void>
+struct HasMessageCatalog : std::false_type {};
+
+template <typename Traits>
+struct HasMessageCatalog<
+    Traits, decltype((void)Traits::Message(
+                std::declval<typename Traits::CodeType>()))>
+    : std::true_type {};
+
+} // namespace internal
+
+/// An error code domain with a statically declared name, code type, and
+/// code format.
+/**
+ * \p Traits is a class describing the domain with the following static
+ * members:
+ * - `CodeType`: an enumeration (usually a scoped `enum class`) whose values
+ *   are the domain's error codes; its values must fit in `int32_t`.
+ * - `static constexpr const char *Name()`: the domain name.
+ * - `static constexpr RERR_CodeFormat CodeFormat()`: the code format.
+ * - Optionally, `static constexpr const char *Message(CodeType)`: a message
+ *   catalog, returning a string with static storage duration for each code.
+ *
+ * The name and code format are checked at compile time. The domain is
+ * registered once with Register(), which caches its handle, so that errors are
+ * created from typed codes without looking up the domain name. Codes with a
+ * catalog message can be created without a message argument; the catalog
+ * string is referenced (as with RERR_Error_CreateStatic()), not copied.
+ *
+ * \code{.cpp}
+ * enum class CameraCode : int32_t { Timeout = 1, NoDevice = 2 };
+ *
+ * struct CameraTraits {
+ *     using CodeType = CameraCode;
+ *     static constexpr const char *Name() { return "Camera"; }
+ *     static constexpr RERR_CodeFormat CodeFormat() {
+ *         return RERR_CodeFormat_Hex32;
+ *     }
+ *     static constexpr const char *Message(CameraCode code) {
+ *         switch (code) {
+ *         case CameraCode::Timeout:
+ *             return "Camera timed out";
+ *         case CameraCode::NoDevice:
+ *             return "No camera found";
+ *         }
+ *         return nullptr;
+ *     }
+ * };
+ *
+ * using CameraDomain = RERR::Domain<CameraTraits>;
+ *
+ * // At startup:
+ * CameraDomain::Register().ThrowIfError();
+ *
+ * RERR::Error Snap() {
+ *     return CameraDomain::Create(CameraCode::Timeout);
+ * }
+ * \endcode
+ */
+template <typename Traits> class Domain final {
+    static std::atomic<RERR_DomainHandle> handle;
+
+    static constexpr int32_t ToInt(typename Traits::CodeType code) noexcept {
+        return static_cast<int32_t>(code);
+    }
+
+  public:
+    /// Enumeration of the codes of this domain.
+    using CodeType = typename Traits::CodeType;
+
+    static_assert(std::is_enum<CodeType>::value,
+                  "Domain code type must be an enumeration");
+    static_assert(sizeof(CodeType) <= sizeof(int32_t),
+                  "Domain code type must fit in int32_t");
+    static_assert(internal::IsValidDomainName(Traits::Name()),
+                  "Domain name must be 1-63 ASCII graphic characters or "
+                  "spaces");
+    static_assert(internal::IsValidCodeFormat(Traits::CodeFormat()),
+                  "Invalid code format for domain");
+
+    Domain() = delete;
+
+    /// Whether this domain has a message catalog.
+    static constexpr bool HasMessageCatalog() noexcept {
+        return internal::HasMessageCatalog<Traits>::value;
+    }
+
+    /// Return the domain name.
+    static constexpr const char *Name() noexcept { return Traits::Name(); }
+
+    /// Return the code format.
+    static constexpr RERR_CodeFormat CodeFormat() noexcept {
+        return Traits::CodeFormat();
+    }
+
+    /// Register this domain and cache its handle.
+    /**
+     * Call once (typically at startup) before creating errors; the result is
+     * as for RegisterDomain(). After UnregisterAllDomains() (in tests), this
+     * must be called again.
+     */
+    static Error Register() noexcept {
+        Error err(RERR_Domain_Register(Name(), CodeFormat()));
+        if (err.IsError()) {
+            return err;
+        }
+        RERR_DomainHandle h;
+        err = LookupDomain(Name(), h);
+        handle.store(h, std::memory_order_release);
+        return err;
+    }
+
+    /// Return the cached domain handle.
+    /**
+     * If Register() has not succeeded, the domain is looked up (in case it
+     * was registered by other means); null is returned if it is not
+     * registered.
+     */
+    static RERR_DomainHandle Handle() noexcept {
+        RERR_DomainHandle h = handle.load(std::memory_order_acquire);
+        if (!h) {
+            RERR_Error_Destroy(RERR_Domain_Lookup(Name(), &h));
+            handle.store(h, std::memory_order_release);
+        }
+        return h;
+    }
+
+    /// Return the catalog message for a code.
+    /**
+     * Only available if the domain has a message catalog.
+     */
+    template <typename T = Traits>
+    static constexpr const char *Message(CodeType code) noexcept {
+        static_assert(internal::HasMessageCatalog<T>::value,
+                      "Domain has no message catalog");
+        return T::Message(code) ? T::Message(code) : "Unknown error code";
+    }
+
+    /// Create an error with the catalog message for its code.
+    /**
+     * Only available if the domain has a message catalog.
+     */
+    static Error Create(CodeType code) noexcept {
+        return Error(RERR_Error_CreateWithDomainHandleStatic(
+            Handle(), ToInt(code), Message(code)));
+    }
+
+    /// Create an error with the given message.
+    static Error Create(CodeType code, StringRef message) noexcept {
+        return Error(Handle(), ToInt(code), message);
+    }
+
+    /// Create an error with the given message, without copying it.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    static Error Create(CodeType code, StaticMessage message) noexcept {
+        return Error(Handle(), ToInt(code), message);
+    }
+
+    /// Create an error with a cause and the catalog message for its code.
+    /**
+     * Only available if the domain has a message catalog.
+     */
+    static Error Wrap(Error &&cause, CodeType code) noexcept {
+        return Error(RERR_Error_WrapWithDomainHandleStatic(
+            cause.ReleaseCPtr(), Handle(), ToInt(code), Message(code)));
+    }
+
+    /// Create an error with a cause and the given message.
+    static Error Wrap(Error &&cause, CodeType code,
+                      StringRef message) noexcept {
+        return Error(std::move(cause), Handle(), ToInt(code), message);
+    }
+
+    /// Create an error with a cause and the given message, without copying
+    /// it.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    static Error Wrap(Error &&cause, CodeType code,
+                      StaticMessage message) noexcept {
+        return Error(std::move(cause), Handle(), ToInt(code), message);
+    }
+
+    /// Return whether an error has a code in this domain.
+    static bool Is(ErrorView error) noexcept {
+        return error.HasCode() &&
+               std::strcmp(error.GetDomain(), Name()) == 0;
+    }
+
+    /// Return whether an error has the given code in this domain.
+    static bool Is(ErrorView error, CodeType code) noexcept {
+        return Is(error) && error.GetCode() == ToInt(code);
+    }
+};
+
+template <typename Traits>
+std::atomic<RERR_DomainHandle> Domain<Traits>::handle{nullptr};
+
+} // namespace RERR
@@ -54,6 +54,14 @@ typedef struct RERR_ErrorMap *RERR_ErrorMapPtr;
  * not map an error to a code for any other reason (for example code range
  * exhaustion). `outOfMemoryCode` is also used when the original error
  * indicated out-of-memory.
+ *
+ * Every code in the range can be assigned. Codes are allocated independently
+ * for groups of threads (chosen by a hash of the thread), so each thread can
+ * have as many errors registered at a time as there are codes in the range
+ * (or 2^31, if fewer), less the number registered by other threads in the
+ * same group. Within a group, codes are assigned in rotation through the
+ * range, so a code that has been retrieved is not reassigned until the group
+ * has cycled through the rest of the range.
  */
 typedef struct RERR_ErrorMapConfig {
     int32_t minMappedCode;   ///< Minimum of code range
@@ -67,6 +75,73 @@ typedef struct RERR_ErrorMapConfig {
     // be used. This is to prevent silent misconfiguration.
 } RERR_ErrorMapConfig;
 
+/// Policies for the entries of a thread that exits.
+/**
+ * For RERR_ErrorMapOptions::threadExitPolicy.
+ */
+enum {
+    /// Keep the entries until the map is destroyed (default)
+    RERR_ErrorMapThreadExit_Keep = 0,
+    /// Release the entries when the thread exits
+    RERR_ErrorMapThreadExit_Release = 1,
+    /// Release the entries in the next RERR_ErrorMap_ReapDeadThreads()
+    RERR_ErrorMapThreadExit_Defer = 2,
+};
+
+/// Policies for registering an error when the map is full.
+/**
+ * For RERR_ErrorMapOptions::evictionPolicy.
+ */
+enum {
+    /// Fail, returning the map-failure code (default)
+    RERR_ErrorMapEviction_None = 0,
+    /// Destroy the oldest entry in the registering thread's shard
+    RERR_ErrorMapEviction_Oldest = 1,
+};
+
+/// Flags for RERR_ErrorMapOptions::flags.
+enum {
+    /// The map is only used from one thread.
+    /**
+     * All access to the map (other than creation and destruction) must be
+     * from a single thread; in builds without `NDEBUG`, this is checked by
+     * assertion against the first thread to use the map. The map then keeps
+     * a single slot table that is accessed without locking or looking up the
+     * calling thread. Cannot be combined with a thread-exit policy.
+     */
+    RERR_ErrorMapFlag_SingleThreaded = 1,
+};
+
+/// Optional settings for error map.
+/**
+ * A zero-initialized struct gives the behavior of RERR_ErrorMap_Create().
+ *
+ * With a `threadExitPolicy` other than ::RERR_ErrorMapThreadExit_Keep,
+ * registrations are tied to the registering thread (rather than to its thread
+ * id, which may be reused by a later thread), and a thread-exit hook
+ * (`pthread_key_create()` destructor or Windows FLS callback) releases or
+ * marks the thread's entries. This bounds memory in programs whose threads
+ * come and go (such as thread pools that rotate workers) without requiring
+ * each thread to call RERR_ErrorMap_ClearThreadLocal() before exiting. One
+ * thread-local storage key is used per map, so the number of such maps is
+ * limited by the platform.
+ *
+ * If `maxEntries` is nonzero, the total number of registered errors in the
+ * map is limited to that number. With ::RERR_ErrorMapEviction_Oldest, the
+ * oldest registration in the same shard as the registering thread (which
+ * always includes the thread's own registrations) is destroyed to make room;
+ * its code then retrieves an error with code ::RERR_ECODE_MAP_INVALID_CODE.
+ * If there is no such registration, or with ::RERR_ErrorMapEviction_None,
+ * the map-failure code is returned. The eviction policy also applies when
+ * the shard has used all of the codes it can address.
+ */
+typedef struct RERR_ErrorMapOptions {
+    int threadExitPolicy; ///< One of the RERR_ErrorMapThreadExit_* values
+    uint32_t maxEntries;  ///< Maximum number of registered errors, or 0
+    int evictionPolicy;   ///< One of the RERR_ErrorMapEviction_* values
+    unsigned flags;       ///< Bitwise OR of RERR_ErrorMapFlag_* values
+} RERR_ErrorMapOptions;
+
 /// Create an error map.
 /**
  * The created map can be accessed from any thread. The caller is responsible
@@ -77,10 +152,24 @@ typedef struct RERR_ErrorMapConfig {
 RERR_ErrorPtr RERR_ErrorMap_Create(RERR_ErrorMapPtr *map,
                                    const RERR_ErrorMapConfig *config);
 
+/// Create an error map with optional settings.
+/**
+ * As RERR_ErrorMap_Create(), but with the settings in \p options (which may
+ * be null for the defaults). An error with code
+ * ::RERR_ECODE_MAP_INVALID_CONFIG is returned if a policy or flag is unknown
+ * or the options conflict, and with code ::RERR_ECODE_MAP_FAILURE if a
+ * thread-local storage key could not be created.
+ */
+RERR_ErrorPtr
+RERR_ErrorMap_CreateWithOptions(RERR_ErrorMapPtr *map,
+                                const RERR_ErrorMapConfig *config,
+                                const RERR_ErrorMapOptions *options);
+
 /// Destroy an error map.
 /**
  * The caller is responsible for synchronizing destruction of the map with
- * creation and access.
+ * creation and access. For maps with a thread-exit policy, threads that have
+ * used the map must not exit concurrently with its destruction.
  */
 void RERR_ErrorMap_Destroy(RERR_ErrorMapPtr map);
 
@@ -96,6 +185,19 @@ void RERR_ErrorMap_Destroy(RERR_ErrorMapPtr map);
 int32_t RERR_ErrorMap_RegisterThreadLocal(RERR_ErrorMapPtr map,
                                           RERR_ErrorPtr error);
 
+/// Assign integer codes to an array of rich error objects.
+/**
+ * Equivalent to calling RERR_ErrorMap_RegisterThreadLocal() on each of the
+ * `count` elements of `errors`, storing the resulting codes in the
+ * corresponding elements of `codes`, but more efficient for large batches.
+ *
+ * This function takes ownership of all of the error objects; each element of
+ * `errors` is set to `RERR_NO_ERROR` upon return.
+ */
+void RERR_ErrorMap_RegisterThreadLocalBatch(RERR_ErrorMapPtr map,
+                                            RERR_ErrorPtr *errors,
+                                            size_t count, int32_t *codes);
+
 /// Return whether an error is registered under the given code.
 /**
  * In the case where the given code is one of the special codes (no-error,
@@ -115,6 +217,19 @@ bool RERR_ErrorMap_IsRegisteredThreadLocal(RERR_ErrorMapPtr map, int32_t code);
 RERR_ErrorPtr RERR_ErrorMap_RetrieveThreadLocal(RERR_ErrorMapPtr map,
                                                 int32_t mappedCode);
 
+/// Retrieve the rich error objects registered with an array of codes.
+/**
+ * Equivalent to calling RERR_ErrorMap_RetrieveThreadLocal() on each of the
+ * `count` elements of `mappedCodes`, storing the resulting errors in the
+ * corresponding elements of `errors`, but more efficient for large batches.
+ *
+ * The caller is responsible for destroying all of the returned errors.
+ */
+void RERR_ErrorMap_RetrieveThreadLocalBatch(RERR_ErrorMapPtr map,
+                                            const int32_t *mappedCodes,
+                                            size_t count,
+                                            RERR_ErrorPtr *errors);
+
 /// Clear the error code registrations for the current thread.
 /**
  * A central part of the application can call this function at carefully chosen
@@ -126,6 +241,17 @@ RERR_ErrorPtr RERR_ErrorMap_RetrieveThreadLocal(RERR_ErrorMapPtr map,
  */
 void RERR_ErrorMap_ClearThreadLocal(RERR_ErrorMapPtr map);
 
+/// Release the registrations of threads that have exited.
+/**
+ * Only has an effect on maps created with ::RERR_ErrorMapThreadExit_Defer,
+ * for which this should be called periodically (from any thread). Deferring
+ * the release keeps thread exit cheap and avoids destroying errors in
+ * thread-exit hooks.
+ *
+ * Nothing is done if the given map is NULL.
+ */
+void RERR_ErrorMap_ReapDeadThreads(RERR_ErrorMapPtr map);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -15,7 +15,9 @@
 #include "RichErrors/Err2Code.h"
 #include "RichErrors/RichErrors.hpp"
 
+#include <cstddef>
 #include <cstring>
+#include <utility>
 
 namespace RERR {
 
@@ -23,6 +25,9 @@ namespace RERR {
 class ErrorMap final {
     RERR_ErrorMapPtr ptr;
 
+    // Number of errors passed at a time to the C batch functions
+    static constexpr std::size_t BatchChunkSize = 64;
+
   public:
     ~ErrorMap() { RERR_ErrorMap_Destroy(ptr); }
 
@@ -48,6 +53,7 @@ class ErrorMap final {
         friend class ErrorMap;
         RERR_ErrorMapConfig c;
         RERR_ErrorMapConfig ok; // Record set fields
+        RERR_ErrorMapOptions o;
 
         bool IsComplete() const noexcept {
             return ok.minMappedCode && ok.maxMappedCode && ok.noErrorCode &&
@@ -59,6 +65,7 @@ class ErrorMap final {
         Config() noexcept {
             memset(&c, 0, sizeof(c));
             memset(&ok, 0, sizeof(ok));
+            memset(&o, 0, sizeof(o));
         }
 
         /// Set the code range for mapping errors.
@@ -90,6 +97,43 @@ class ErrorMap final {
             ok.mapFailureCode = 1;
             return *this;
         }
+
+        /// Set what to do with the registrations of threads that exit.
+        /**
+         * `policy` is one of the `RERR_ErrorMapThreadExit_*` values (see
+         * RERR_ErrorMapOptions).
+         */
+        Config &SetThreadExitPolicy(int policy) noexcept {
+            o.threadExitPolicy = policy;
+            return *this;
+        }
+
+        /// Limit the number of registered errors.
+        /**
+         * `evictionPolicy` is one of the `RERR_ErrorMapEviction_*` values
+         * (see RERR_ErrorMapOptions).
+         */
+        Config &SetMaxEntries(
+            uint32_t maxEntries,
+            int evictionPolicy = RERR_ErrorMapEviction_None) noexcept {
+            o.maxEntries = maxEntries;
+            o.evictionPolicy = evictionPolicy;
+            return *this;
+        }
+
+        /// Declare that the map is only used from one thread.
+        /**
+         * See ::RERR_ErrorMapFlag_SingleThreaded.
+         */
+        Config &SetSingleThreaded(bool singleThreaded = true) noexcept {
+            if (singleThreaded) {
+                o.flags |= RERR_ErrorMapFlag_SingleThreaded;
+            } else {
+                o.flags &= ~static_cast<unsigned>(
+                    RERR_ErrorMapFlag_SingleThreaded);
+            }
+            return *this;
+        }
     };
 
     /// Construct new.
@@ -102,7 +146,8 @@ class ErrorMap final {
                   "Incomplete error map configuration (programming error)")
                 .ThrowIfError();
         }
-        ThrowIfError(RERR_ErrorMap_Create(&ptr, &config.c));
+        ThrowIfError(
+            RERR_ErrorMap_CreateWithOptions(&ptr, &config.c, &config.o));
     }
 
     explicit ErrorMap(RERR_ErrorMapPtr const &) = delete;
@@ -130,6 +175,39 @@ class ErrorMap final {
         return RERR_ErrorMap_RegisterThreadLocal(ptr, cError);
     }
 
+    /// Register a range of errors and assign integer codes.
+    /**
+     * The errors in [`first`, `last`) are moved from, and the assigned codes
+     * are written to `codes` in the same order. Returns the end of the
+     * output range.
+     *
+     * The errors are passed to RERR_ErrorMap_RegisterThreadLocalBatch() in
+     * fixed-size chunks, so no memory is allocated. If the input iterator
+     * throws, the errors moved from in the current chunk are destroyed; if
+     * writing to `codes` throws, the registered errors remain in the map.
+     */
+    template <typename InputIt, typename OutputIt>
+    OutputIt RegisterThreadLocal(InputIt first, InputIt last, OutputIt codes) {
+        while (first != last) {
+            // Errors stay owned by held until the chunk has been read
+            Error held[BatchChunkSize];
+            std::size_t n = 0;
+            for (; n < BatchChunkSize && first != last; ++first) {
+                held[n++] = std::move(*first);
+            }
+            RERR_ErrorPtr cErrors[BatchChunkSize];
+            int32_t cCodes[BatchChunkSize];
+            for (std::size_t i = 0; i < n; ++i) {
+                cErrors[i] = held[i].ReleaseCPtr();
+            }
+            RERR_ErrorMap_RegisterThreadLocalBatch(ptr, cErrors, n, cCodes);
+            for (std::size_t i = 0; i < n; ++i) {
+                *codes++ = cCodes[i];
+            }
+        }
+        return codes;
+    }
+
     /// Return whether an error is registered under an integer code.
     bool IsRegisteredThreadLocal(int32_t code) noexcept {
         return RERR_ErrorMap_IsRegisteredThreadLocal(ptr, code);
@@ -140,8 +218,45 @@ class ErrorMap final {
         return Error(RERR_ErrorMap_RetrieveThreadLocal(ptr, mappedCode));
     }
 
+    /// Retrieve errors by a range of assigned integer codes.
+    /**
+     * The errors registered under the codes in [`first`, `last`) are written
+     * to `errors` in the same order. Returns the end of the output range.
+     *
+     * The codes are passed to RERR_ErrorMap_RetrieveThreadLocalBatch() in
+     * fixed-size chunks, so no memory is allocated. If writing to `errors`
+     * throws, the retrieved errors not yet written are destroyed.
+     */
+    template <typename InputIt, typename OutputIt>
+    OutputIt RetrieveThreadLocal(InputIt first, InputIt last,
+                                 OutputIt errors) {
+        while (first != last) {
+            int32_t cCodes[BatchChunkSize];
+            std::size_t n = 0;
+            for (; n < BatchChunkSize && first != last; ++first) {
+                cCodes[n++] = *first;
+            }
+            RERR_ErrorPtr cErrors[BatchChunkSize];
+            RERR_ErrorMap_RetrieveThreadLocalBatch(ptr, cCodes, n, cErrors);
+            Error retrieved[BatchChunkSize];
+            for (std::size_t i = 0; i < n; ++i) {
+                retrieved[i] = Error(std::move(cErrors[i]));
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                *errors++ = std::move(retrieved[i]);
+            }
+        }
+        return errors;
+    }
+
     /// Clear integer code assignments for the current thread.
     void ClearThreadLocal() noexcept { RERR_ErrorMap_ClearThreadLocal(ptr); }
+
+    /// Release the registrations of threads that have exited.
+    /**
+     * See RERR_ErrorMap_ReapDeadThreads().
+     */
+    void ReapDeadThreads() noexcept { RERR_ErrorMap_ReapDeadThreads(ptr); }
 };
 
 } // namespace RERR
@@ -22,8 +22,8 @@ extern "C" {
 /// Handle for error information map.
 /**
  * This is an opaque type, for use as a container for very small key-value
- * mappings, where the keys are strings and the values are strings, numbers, or
- * boolean.
+ * mappings, where the keys are strings and the values are strings, numbers,
+ * boolean, byte strings, or numeric arrays.
  *
  * It is optimized for very small maps and will be very inefficient if large
  * numbers of items are added. Use in a context where an unbound number of
@@ -70,6 +70,9 @@ enum {
     RERR_InfoValueTypeI64,         ///< Signed integer value
     RERR_InfoValueTypeU64,         ///< Unsigned integer value
     RERR_InfoValueTypeF64,         ///< Floating-point value
+    RERR_InfoValueTypeBytes,       ///< Byte string value
+    RERR_InfoValueTypeI64Array,    ///< Array of signed integers
+    RERR_InfoValueTypeF64Array,    ///< Array of floating-point values
 };
 
 /// Create an info map.
@@ -80,6 +83,57 @@ enum {
  */
 RERR_InfoMapPtr RERR_InfoMap_Create(void);
 
+/// Key-value item for initializing an info map.
+/**
+ * \sa RERR_InfoMap_CreateFromItems()
+ */
+typedef struct RERR_InfoMapInitItem {
+    const char *key;         ///< The key
+    RERR_InfoValueType type; ///< The value type
+    /// The value (the member corresponding to `type` is used).
+    union {
+        const char *string; ///< String value
+        bool boolean;       ///< Boolean value
+        int64_t i64;        ///< Signed integer value
+        uint64_t u64;       ///< Unsigned integer value
+        double f64;         ///< Floating-point value
+    } value;
+} RERR_InfoMapInitItem;
+
+/// Flags for RERR_InfoMap_CreateFromItems().
+enum {
+    /// The items are given in strictly increasing order of key (by `strcmp()`)
+    RERR_InfoMapCreatePresorted = 1,
+    /// Make the created map immutable
+    RERR_InfoMapCreateImmutable = 2,
+    /// Do not copy the keys (see RERR_InfoMap_SetStringStaticKey())
+    RERR_InfoMapCreateStaticKeys = 4,
+};
+
+/// Create an info map populated with the given items.
+/**
+ * The result is the same as calling RERR_InfoMap_Create() followed by the
+ * `RERR_InfoMap_SetXxx()` function corresponding to the type of each item, in
+ * order (so that the last item wins if keys are duplicated), but storage is
+ * allocated only once and the items are sorted in a single pass (or not at all
+ * if ::RERR_InfoMapCreatePresorted is given).
+ *
+ * Items with a null key, a null string value, or an invalid type are recorded
+ * as programming errors (see RERR_InfoMap_HasProgrammingErrors()) and
+ * skipped. Byte string and array values cannot be given as items.
+ *
+ * If ::RERR_InfoMapCreatePresorted is given, the keys must be in strictly
+ * increasing order; otherwise the behavior of the map is undefined.
+ *
+ * \param items array of \p count items (may be null if \p count is zero)
+ * \param count number of items
+ * \param flags bitwise OR of zero or more of ::RERR_InfoMapCreatePresorted,
+ * ::RERR_InfoMapCreateImmutable, and ::RERR_InfoMapCreateStaticKeys
+ * \return Opaque pointer to map (never null).
+ */
+RERR_InfoMapPtr RERR_InfoMap_CreateFromItems(const RERR_InfoMapInitItem *items,
+                                             size_t count, uint32_t flags);
+
 /// Create an info map, simulating an allocation failure.
 /**
  * This function is provided for testing purposes.
@@ -102,13 +156,12 @@ void RERR_InfoMap_Destroy(RERR_InfoMapPtr map);
  * If \p source is immutable, the returned map is also immutable and may share
  * storage with the source.
  *
- * As a consequence, copying is not thread-safe: making a copy is not
- * not sufficient for safe sharing of a map across threads. This is
- * intentional, as info maps are not intended for such use. (See the
- * documentation for RERR_Error_Copy()). If you need a new copy of the map that
- * is independent of the original (for example, because you want to add to it
- * or modify it before attaching to a new error), you should use
- * RERR_InfoMap_MutableCopy().
+ * Sharing is thread safe: copies of an immutable map may be read and destroyed
+ * concurrently on different threads (see RERR_Error_Copy()). Attempting to
+ * mutate a shared immutable map (which is a programming error) is not thread
+ * safe. If you need a new copy of the map that is independent of the original
+ * (for example, because you want to add to it or modify it before attaching to
+ * a new error), you should use RERR_InfoMap_MutableCopy().
  *
  * The return value is guaranteed to be non-null if \p source is not null and
  * is immutable.
@@ -143,6 +196,51 @@ RERR_InfoMapPtr RERR_InfoMap_MutableCopy(RERR_InfoMapPtr source);
  */
 RERR_InfoMapPtr RERR_InfoMap_ImmutableCopy(RERR_InfoMapPtr source);
 
+/// Create a mutable info map layered over an existing one.
+/**
+ * The new map initially contains the same items as \p base. If \p base is
+ * immutable, its items are not copied: the new map keeps a reference to it
+ * and stores only the items subsequently set or removed, so that adding a few
+ * items of context to the info of a cause costs time proportional to the
+ * number of items added, not to the size of \p base. Lookups search the
+ * added items first, then \p base.
+ *
+ * If \p base is mutable, this is equivalent to RERR_InfoMap_MutableCopy(). If
+ * \p base is null or empty, it is equivalent to RERR_InfoMap_Create().
+ *
+ * The returned map behaves in every respect as an ordinary map. Iterating a
+ * mutable overlay first flattens it (see RERR_InfoMap_Flatten()); iterating an
+ * immutable one creates (once, in a thread-safe manner) a flattened copy that
+ * lives as long as the overlay. Each overlay of an overlay adds a layer; when
+ * the number of layers reaches an internal limit, the new overlay is instead
+ * based on a flattened copy of \p base.
+ *
+ * \code{.c}
+ * RERR_InfoMapPtr info = RERR_InfoMap_CreateOverlay(causeInfo);
+ * RERR_InfoMap_SetString(info, "stage", "focus");
+ * return RERR_Error_WrapWithInfo(cause, "mydomain", code, info, "Failed");
+ * \endcode
+ *
+ * \return Null or the out-of-memory map if allocation failed (as for
+ * RERR_InfoMap_MutableCopy()).
+ * \return Opaque pointer to the new map otherwise.
+ */
+RERR_InfoMapPtr RERR_InfoMap_CreateOverlay(RERR_InfoMapPtr base);
+
+/// Copy the items of an overlay's base map into the overlay.
+/**
+ * After this call, \p map no longer references the base map given to
+ * RERR_InfoMap_CreateOverlay(); its contents are unchanged. This costs time
+ * proportional to the number of items, and can be used to release a large
+ * base map or to speed up many subsequent lookups.
+ *
+ * Nothing is done if \p map is null, immutable, or not an overlay. If
+ * allocation fails, \p map switches to the out-of-memory state. Like other
+ * modifications, flattening (including when iterating a mutable overlay)
+ * invalidates strings and arrays previously retrieved from \p map.
+ */
+void RERR_InfoMap_Flatten(RERR_InfoMapPtr map);
+
 /// Forbid further modification of an info map.
 /**
  * If \p map is null, nothing is done. If \p map is already immutable, nothing
@@ -230,6 +328,15 @@ void RERR_InfoMap_ReserveCapacity(RERR_InfoMapPtr map, size_t capacity);
 void RERR_InfoMap_SetString(RERR_InfoMapPtr map, const char *key,
                             const char *value);
 
+/// Add or replace a string value, given with its length, in an info map.
+/**
+ * Same as RERR_InfoMap_SetString(), except that \p value need not be
+ * null-terminated: exactly \p valueLen characters, which must not include a
+ * null character, are copied.
+ */
+void RERR_InfoMap_SetStringN(RERR_InfoMapPtr map, const char *key,
+                             const char *value, size_t valueLen);
+
 /// Add or replace a boolean value in an info map.
 /**
  * The key is copied.
@@ -298,6 +405,80 @@ void RERR_InfoMap_SetU64(RERR_InfoMapPtr map, const char *key, uint64_t value);
  */
 void RERR_InfoMap_SetF64(RERR_InfoMapPtr map, const char *key, double value);
 
+/// Add or replace a byte string value in an info map.
+/**
+ * The key and the \p size bytes at \p data are copied into the map. The
+ * bytes are stored in the map's own storage, without a key per element, so
+ * this is the efficient way to attach a binary dump; copies of an immutable
+ * map share the bytes.
+ *
+ * \p data may be null if \p size is zero. Otherwise, null \p data is
+ * recorded as a programming error (see RERR_InfoMap_HasProgrammingErrors()).
+ * Other behavior is as for RERR_InfoMap_SetString().
+ */
+void RERR_InfoMap_SetBytes(RERR_InfoMapPtr map, const char *key,
+                           const void *data, size_t size);
+
+/// Add or replace an array of signed integers in an info map.
+/**
+ * The \p count elements at \p values are copied, as for
+ * RERR_InfoMap_SetBytes().
+ */
+void RERR_InfoMap_SetI64Array(RERR_InfoMapPtr map, const char *key,
+                              const int64_t *values, size_t count);
+
+/// Add or replace an array of floating-point values in an info map.
+/**
+ * The \p count elements at \p values are copied, as for
+ * RERR_InfoMap_SetBytes().
+ */
+void RERR_InfoMap_SetF64Array(RERR_InfoMapPtr map, const char *key,
+                              const double *values, size_t count);
+
+/// Add or replace a string value in an info map, without copying the key.
+/**
+ * This function is equivalent to RERR_InfoMap_SetString(), except that \p key
+ * is not copied: the map refers to the given string, which must therefore
+ * remain valid and unchanged for as long as the map (or any copy of it)
+ * exists. It is intended for string literals and other strings with static
+ * storage duration. If the map already contains \p key, its existing key
+ * storage is kept.
+ */
+void RERR_InfoMap_SetStringStaticKey(RERR_InfoMapPtr map, const char *key,
+                                     const char *value);
+
+/// Add or replace a boolean value in an info map, without copying the key.
+/**
+ * This function is equivalent to RERR_InfoMap_SetBool(), except that \p key
+ * is not copied (see RERR_InfoMap_SetStringStaticKey()).
+ */
+void RERR_InfoMap_SetBoolStaticKey(RERR_InfoMapPtr map, const char *key,
+                                   bool value);
+
+/// Add or replace a signed integer value, without copying the key.
+/**
+ * This function is equivalent to RERR_InfoMap_SetI64(), except that \p key
+ * is not copied (see RERR_InfoMap_SetStringStaticKey()).
+ */
+void RERR_InfoMap_SetI64StaticKey(RERR_InfoMapPtr map, const char *key,
+                                  int64_t value);
+
+/// Add or replace an unsigned integer value, without copying the key.
+/**
+ * This function is equivalent to RERR_InfoMap_SetU64(), except that \p key
+ * is not copied (see RERR_InfoMap_SetStringStaticKey()).
+ */
+void RERR_InfoMap_SetU64StaticKey(RERR_InfoMapPtr map, const char *key,
+                                  uint64_t value);
+
+/// Add or replace a floating-point value, without copying the key.
+/**
+ * This function is equivalent to RERR_InfoMap_SetF64(), except that \p key
+ * is not copied (see RERR_InfoMap_SetStringStaticKey()).
+ */
+void RERR_InfoMap_SetF64StaticKey(RERR_InfoMapPtr map, const char *key,
+                                  double value);
+
 /// Remove a key from an info map.
 /**
  * Nothing is done if \p map is null or if \p map does not contain \p key.
@@ -339,8 +520,9 @@ RERR_InfoValueType RERR_InfoMap_GetType(RERR_InfoMapPtr map, const char *key);
  *
  * Otherwise `*value` is set to an internal copy of the string value, and
  * `true` is returned. The string returned in `*value` is valid until the map
- * is destroyed (if the map is immutable) or until the key is removed or
- * overwritten (if the map is mutable).
+ * is destroyed or (if the map is mutable) next modified. Items and strings
+ * share one storage block, which may be moved by any modification, so that
+ * setting even a different key invalidates the string.
  *
  * \param map the info map
  * \param[in] key the key
@@ -412,10 +594,43 @@ bool RERR_InfoMap_GetU64(RERR_InfoMapPtr map, const char *key,
  */
 bool RERR_InfoMap_GetF64(RERR_InfoMapPtr map, const char *key, double *value);
 
+/// Retrieve a byte string value from an info map.
+/**
+ * If \p map or \p key is null, or if \p map does not contain a byte string
+ * value for \p key, then `*data` is set to NULL, `*size` to zero, and `false`
+ * is returned.
+ *
+ * If \p data or \p size is null, nothing is done and `false` is returned.
+ *
+ * Otherwise `*data` is set to the map's copy of the bytes (which is suitably
+ * aligned for any 64-bit type), `*size` to their number, and `true` is
+ * returned. The bytes remain valid until the map is destroyed or (if the map
+ * is mutable) next modified, as for RERR_InfoMap_GetString().
+ */
+bool RERR_InfoMap_GetBytes(RERR_InfoMapPtr map, const char *key,
+                           const void **data, size_t *size);
+
+/// Retrieve an array of signed integers from an info map.
+/**
+ * Same as RERR_InfoMap_GetBytes(), but for an array value; `*count` is set to
+ * the number of elements.
+ */
+bool RERR_InfoMap_GetI64Array(RERR_InfoMapPtr map, const char *key,
+                              const int64_t **values, size_t *count);
+
+/// Retrieve an array of floating-point values from an info map.
+/**
+ * Same as RERR_InfoMap_GetBytes(), but for an array value; `*count` is set to
+ * the number of elements.
+ */
+bool RERR_InfoMap_GetF64Array(RERR_InfoMapPtr map, const char *key,
+                              const double **values, size_t *count);
+
 /// Get the beginning of the map as an iterator.
 /**
  * Like a C++ iterator, the result can be used to iterate over all items in the
- * map.
+ * map. Items are visited in increasing order of key (as compared by
+ * `strcmp()`).
  *
  * \sa RERR_InfoMap_End(), RERR_InfoMap_Advance()
  */
@@ -443,7 +658,9 @@ RERR_InfoMapIterator RERR_InfoMap_End(RERR_InfoMapPtr map);
  *     }
  *
  * Iterator support for info maps is intended for reading out items only.
- * Iterators are invalid if the map is mutable and is modified.
+ * Iterators, and the keys, strings, byte strings and arrays obtained through
+ * them, are invalid once the map is destroyed or (if the map is mutable)
+ * modified.
  */
 RERR_InfoMapIterator RERR_InfoMap_Advance(RERR_InfoMapPtr map,
                                           RERR_InfoMapIterator it);
@@ -485,6 +702,34 @@ uint64_t RERR_InfoMapIterator_GetU64(RERR_InfoMapIterator it);
  */
 double RERR_InfoMapIterator_GetF64(RERR_InfoMapIterator it);
 
+/// Get the byte string value of an item pointed to by an iterator.
+/**
+ * The number of bytes is stored in `*size`.
+ *
+ * If the item does not contain a byte string value, behavior is undefined.
+ */
+const void *RERR_InfoMapIterator_GetBytes(RERR_InfoMapIterator it,
+                                          size_t *size);
+
+/// Get the signed integer array of an item pointed to by an iterator.
+/**
+ * The number of elements is stored in `*count`.
+ *
+ * If the item does not contain a signed integer array, behavior is undefined.
+ */
+const int64_t *RERR_InfoMapIterator_GetI64Array(RERR_InfoMapIterator it,
+                                                size_t *count);
+
+/// Get the floating-point array of an item pointed to by an iterator.
+/**
+ * The number of elements is stored in `*count`.
+ *
+ * If the item does not contain a floating-point array, behavior is
+ * undefined.
+ */
+const double *RERR_InfoMapIterator_GetF64Array(RERR_InfoMapIterator it,
+                                               size_t *count);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
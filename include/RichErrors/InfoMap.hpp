@@ -13,14 +13,66 @@
 #endif
 
 #include "RichErrors/InfoMap.h"
+#include "RichErrors/StringRef.hpp"
 
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <iterator>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace RERR {
 
+/// Non-owning, read-only view of a contiguous array.
+/**
+ * Used for byte string and array values in info maps. Parameters of this
+ * type accept a pointer with a count, a `std::vector`, a C array, or a braced
+ * list of values.
+ */
+template <typename T> class Span final {
+    const T *ptr;
+    std::size_t count;
+
+  public:
+    /// Construct an empty span.
+    Span() noexcept : ptr{nullptr}, count{0} {}
+
+    /// Refer to \p n elements starting at \p p.
+    Span(const T *p, std::size_t n) noexcept : ptr{p}, count{n} {}
+
+    /// Refer to the elements of a vector.
+    Span(std::vector<T> const &v) noexcept : ptr{v.data()}, count{v.size()} {}
+
+    /// Refer to the elements of an array.
+    template <std::size_t N>
+    Span(const T (&a)[N]) noexcept : ptr{a}, count{N} {}
+
+    /// Refer to the elements of an initializer list.
+    Span(std::initializer_list<T> l) noexcept
+        : ptr{l.begin()}, count{l.size()} {}
+
+    /// Return a pointer to the first element.
+    const T *Data() const noexcept { return ptr; }
+
+    /// Return the number of elements.
+    std::size_t Size() const noexcept { return count; }
+
+    /// Return whether there are no elements.
+    bool IsEmpty() const noexcept { return count == 0; }
+
+    /// Access an element.
+    const T &operator[](std::size_t i) const noexcept { return ptr[i]; }
+
+    /// Return an iterator to the first element.
+    const T *begin() const noexcept { return ptr; }
+
+    /// Return an iterator past the last element.
+    const T *end() const noexcept { return ptr + count; }
+};
+
 /// Error information map.
 class InfoMap final {
     RERR_InfoMapPtr ptr;
@@ -52,9 +104,89 @@ class InfoMap final {
         return *this;
     }
 
+    /// Typed key-value item for initializing an info map.
+    /**
+     * Items are created with the static member functions named for the value
+     * type, so that the type used for each key is explicit.
+     *
+     * \sa InfoMap(std::initializer_list<InitItem>)
+     */
+    class InitItem final {
+        friend class InfoMap;
+        std::string key;
+        std::string string;
+        RERR_InfoMapInitItem item;
+
+        InitItem(std::string k, RERR_InfoValueType type) : key{std::move(k)} {
+            item.type = type;
+        }
+
+      public:
+        /// Create a string item.
+        static InitItem String(std::string key, std::string value) {
+            InitItem ret(std::move(key), RERR_InfoValueTypeString);
+            ret.string = std::move(value);
+            return ret;
+        }
+
+        /// Create a boolean item.
+        static InitItem Bool(std::string key, bool value) {
+            InitItem ret(std::move(key), RERR_InfoValueTypeBool);
+            ret.item.value.boolean = value;
+            return ret;
+        }
+
+        /// Create a signed integer item.
+        static InitItem I64(std::string key, int64_t value) {
+            InitItem ret(std::move(key), RERR_InfoValueTypeI64);
+            ret.item.value.i64 = value;
+            return ret;
+        }
+
+        /// Create an unsigned integer item.
+        static InitItem U64(std::string key, uint64_t value) {
+            InitItem ret(std::move(key), RERR_InfoValueTypeU64);
+            ret.item.value.u64 = value;
+            return ret;
+        }
+
+        /// Create a floating point item.
+        static InitItem F64(std::string key, double value) {
+            InitItem ret(std::move(key), RERR_InfoValueTypeF64);
+            ret.item.value.f64 = value;
+            return ret;
+        }
+    };
+
     /// Construct empty map.
     InfoMap() noexcept : ptr{RERR_InfoMap_Create()} {}
 
+    /// Construct a map populated with the given items.
+    /**
+     * Storage is allocated once for all items. If a key is given more than
+     * once, the last item wins. May throw `std::bad_alloc` if a temporary
+     * buffer could not be allocated.
+     *
+     * \code{.cpp}
+     * RERR::InfoMap info{
+     *     RERR::InfoMap::InitItem::String("device", "camera0"),
+     *     RERR::InfoMap::InitItem::I64("channel", 3),
+     * };
+     * \endcode
+     */
+    InfoMap(std::initializer_list<InitItem> items) : ptr{nullptr} {
+        std::vector<RERR_InfoMapInitItem> cItems;
+        cItems.reserve(items.size());
+        for (InitItem const &item : items) {
+            cItems.push_back(item.item);
+            cItems.back().key = item.key.c_str();
+            if (item.item.type == RERR_InfoValueTypeString) {
+                cItems.back().value.string = item.string.c_str();
+            }
+        }
+        ptr = RERR_InfoMap_CreateFromItems(cItems.data(), cItems.size(), 0);
+    }
+
     explicit InfoMap(RERR_InfoMapPtr const &) = delete;
 
     /// Construct from a C pointer.
@@ -87,6 +219,20 @@ class InfoMap final {
     /// Forbid further modification of this info map.
     void MakeImmutable() noexcept { RERR_InfoMap_MakeImmutable(ptr); }
 
+    /// Create a map layered over \p base, sharing its items if immutable.
+    /**
+     * \sa RERR_InfoMap_CreateOverlay()
+     */
+    static InfoMap Overlay(InfoMap const &base) noexcept {
+        return InfoMap(RERR_InfoMap_CreateOverlay(base.ptr));
+    }
+
+    /// Copy the items of an overlay's base map into this map.
+    /**
+     * \sa RERR_InfoMap_Flatten()
+     */
+    void Flatten() noexcept { RERR_InfoMap_Flatten(ptr); }
+
     /// Return whether this info map is mutable.
     bool IsMutable() const noexcept { return RERR_InfoMap_IsMutable(ptr); }
 
@@ -141,52 +287,104 @@ class InfoMap final {
      */
 
     /// Add or replace a string value in this info map.
-    void SetString(std::string const &key, std::string const &value) noexcept {
-        RERR_InfoMap_SetString(ptr, key.c_str(), value.c_str());
+    void SetString(CStringRef key, StringRef value) noexcept {
+        RERR_InfoMap_SetStringN(ptr, key.CStr(), value.Data(), value.Size());
     }
 
     /// Add or replace a boolean value in this info map.
-    void SetBool(std::string const &key, bool value) noexcept {
-        RERR_InfoMap_SetBool(ptr, key.c_str(), value);
+    void SetBool(CStringRef key, bool value) noexcept {
+        RERR_InfoMap_SetBool(ptr, key.CStr(), value);
     }
 
     /// Add or replace a signed integer value in this info map.
-    void SetI64(std::string const &key, int64_t value) noexcept {
-        RERR_InfoMap_SetI64(ptr, key.c_str(), value);
+    void SetI64(CStringRef key, int64_t value) noexcept {
+        RERR_InfoMap_SetI64(ptr, key.CStr(), value);
     }
 
     /// Add or replace an unsigned integer value in this info map.
-    void SetU64(std::string const &key, uint64_t value) noexcept {
-        RERR_InfoMap_SetU64(ptr, key.c_str(), value);
+    void SetU64(CStringRef key, uint64_t value) noexcept {
+        RERR_InfoMap_SetU64(ptr, key.CStr(), value);
     }
 
     /// Add or replace a floating point value in this info map.
-    void SetF64(std::string const &key, double value) noexcept {
-        RERR_InfoMap_SetF64(ptr, key.c_str(), value);
+    void SetF64(CStringRef key, double value) noexcept {
+        RERR_InfoMap_SetF64(ptr, key.CStr(), value);
+    }
+
+    /// Add or replace a byte string value in this info map.
+    void SetBytes(CStringRef key, Span<unsigned char> value) noexcept {
+        RERR_InfoMap_SetBytes(ptr, key.CStr(), value.Data(), value.Size());
+    }
+
+    /// Add or replace a byte string value in this info map.
+    void SetBytes(CStringRef key, const void *data,
+                  std::size_t size) noexcept {
+        RERR_InfoMap_SetBytes(ptr, key.CStr(), data, size);
+    }
+
+    /// Add or replace an array of signed integers in this info map.
+    void SetI64Array(CStringRef key, Span<int64_t> values) noexcept {
+        RERR_InfoMap_SetI64Array(ptr, key.CStr(), values.Data(),
+                                 values.Size());
+    }
+
+    /// Add or replace an array of floating point values in this info map.
+    void SetF64Array(CStringRef key, Span<double> values) noexcept {
+        RERR_InfoMap_SetF64Array(ptr, key.CStr(), values.Data(),
+                                 values.Size());
+    }
+
+    /// Add or replace a string value, without copying the key.
+    /**
+     * The key must remain valid for as long as this info map (or any copy
+     * of it) exists; typically it is a string literal.
+     */
+    void SetStringStaticKey(const char *key, CStringRef value) noexcept {
+        RERR_InfoMap_SetStringStaticKey(ptr, key, value.CStr());
+    }
+
+    /// Add or replace a boolean value, without copying the key.
+    void SetBoolStaticKey(const char *key, bool value) noexcept {
+        RERR_InfoMap_SetBoolStaticKey(ptr, key, value);
+    }
+
+    /// Add or replace a signed integer value, without copying the key.
+    void SetI64StaticKey(const char *key, int64_t value) noexcept {
+        RERR_InfoMap_SetI64StaticKey(ptr, key, value);
+    }
+
+    /// Add or replace an unsigned integer value, without copying the key.
+    void SetU64StaticKey(const char *key, uint64_t value) noexcept {
+        RERR_InfoMap_SetU64StaticKey(ptr, key, value);
+    }
+
+    /// Add or replace a floating point value, without copying the key.
+    void SetF64StaticKey(const char *key, double value) noexcept {
+        RERR_InfoMap_SetF64StaticKey(ptr, key, value);
     }
 
     /// Remove a key from this info map.
-    void Remove(std::string const &key) noexcept {
-        RERR_InfoMap_Remove(ptr, key.c_str());
+    void Remove(CStringRef key) noexcept {
+        RERR_InfoMap_Remove(ptr, key.CStr());
     }
 
     /// Remove all items from this info map.
     void Clear() noexcept { RERR_InfoMap_Clear(ptr); }
 
     /// Return whether this info map contains the given key.
-    bool HasKey(std::string const &key) const noexcept {
-        return RERR_InfoMap_HasKey(ptr, key.c_str());
+    bool HasKey(CStringRef key) const noexcept {
+        return RERR_InfoMap_HasKey(ptr, key.CStr());
     }
 
     /// Get the value type for the given key.
-    RERR_InfoValueType GetType(std::string const &key) const noexcept {
-        return RERR_InfoMap_GetType(ptr, key.c_str());
+    RERR_InfoValueType GetType(CStringRef key) const noexcept {
+        return RERR_InfoMap_GetType(ptr, key.CStr());
     }
 
     /// Retrieve a string value from this info map.
-    bool GetString(std::string const &key, std::string &value) const {
+    bool GetString(CStringRef key, std::string &value) const {
         const char *v;
-        bool ok = RERR_InfoMap_GetString(ptr, key.c_str(), &v);
+        bool ok = RERR_InfoMap_GetString(ptr, key.CStr(), &v);
         if (ok) {
             value = v;
         } else {
@@ -195,24 +393,75 @@ class InfoMap final {
         return ok;
     }
 
+#ifdef RERR_HAVE_STRING_VIEW
+    /// Retrieve a string value from this info map, without copying.
+    /**
+     * The view refers to storage in this map and is valid until the map is
+     * modified or destroyed.
+     */
+    bool GetString(CStringRef key, std::string_view &value) const noexcept {
+        const char *v;
+        bool ok = RERR_InfoMap_GetString(ptr, key.CStr(), &v);
+        value = ok ? std::string_view(v) : std::string_view();
+        return ok;
+    }
+#endif
+
     /// Retrieve a boolean value from this info map.
-    bool GetBool(std::string const &key, bool &value) const {
-        return RERR_InfoMap_GetBool(ptr, key.c_str(), &value);
+    bool GetBool(CStringRef key, bool &value) const {
+        return RERR_InfoMap_GetBool(ptr, key.CStr(), &value);
     }
 
     /// Retrieve a signed integer value from this info map.
-    bool GetI64(std::string const &key, int64_t &value) const {
-        return RERR_InfoMap_GetI64(ptr, key.c_str(), &value);
+    bool GetI64(CStringRef key, int64_t &value) const {
+        return RERR_InfoMap_GetI64(ptr, key.CStr(), &value);
     }
 
     /// Retrieve an unsigned integer value from this info map.
-    bool GetU64(std::string const &key, uint64_t &value) const {
-        return RERR_InfoMap_GetU64(ptr, key.c_str(), &value);
+    bool GetU64(CStringRef key, uint64_t &value) const {
+        return RERR_InfoMap_GetU64(ptr, key.CStr(), &value);
     }
 
     /// Retrieve a floaing point value from this info map.
-    bool GetF64(std::string const &key, double &value) const {
-        return RERR_InfoMap_GetF64(ptr, key.c_str(), &value);
+    bool GetF64(CStringRef key, double &value) const {
+        return RERR_InfoMap_GetF64(ptr, key.CStr(), &value);
+    }
+
+    /// Retrieve a byte string value from this info map, without copying.
+    /**
+     * The span refers to storage in this map and is valid until the map is
+     * modified or destroyed.
+     */
+    bool GetBytes(CStringRef key, Span<unsigned char> &value) const noexcept {
+        const void *data;
+        std::size_t size;
+        bool ok = RERR_InfoMap_GetBytes(ptr, key.CStr(), &data, &size);
+        value = {static_cast<const unsigned char *>(data), size};
+        return ok;
+    }
+
+    /// Retrieve an array of signed integers from this info map.
+    /**
+     * \sa GetBytes()
+     */
+    bool GetI64Array(CStringRef key, Span<int64_t> &value) const noexcept {
+        const int64_t *values;
+        std::size_t count;
+        bool ok = RERR_InfoMap_GetI64Array(ptr, key.CStr(), &values, &count);
+        value = {values, count};
+        return ok;
+    }
+
+    /// Retrieve an array of floating point values from this info map.
+    /**
+     * \sa GetBytes()
+     */
+    bool GetF64Array(CStringRef key, Span<double> &value) const noexcept {
+        const double *values;
+        std::size_t count;
+        bool ok = RERR_InfoMap_GetF64Array(ptr, key.CStr(), &values, &count);
+        value = {values, count};
+        return ok;
     }
 
     /// Get all keys in this info map as a vector of strings.
@@ -270,6 +519,17 @@ class InfoMap final {
             return s ? s : "";
         }
 
+#ifdef RERR_HAVE_STRING_VIEW
+        /// Return the string value for this item, without copying.
+        /**
+         * If this item's value is not a string, an empty view is returned.
+         */
+        std::string_view GetStringView() const noexcept {
+            auto s = RERR_InfoMapIterator_GetString(it);
+            return s ? std::string_view(s) : std::string_view();
+        }
+#endif
+
         /// Return the boolean value for this item.
         /**
          * If this item's value is not a boolean, the returned value is
@@ -297,6 +557,39 @@ class InfoMap final {
          * returned value is undefined.
          */
         double GetF64() const { return RERR_InfoMapIterator_GetF64(it); }
+
+        /// Return the byte string value for this item.
+        /**
+         * If this item's value is not a byte string, the returned span is
+         * undefined.
+         */
+        Span<unsigned char> GetBytes() const noexcept {
+            std::size_t size;
+            auto data = RERR_InfoMapIterator_GetBytes(it, &size);
+            return {static_cast<const unsigned char *>(data), size};
+        }
+
+        /// Return the signed integer array for this item.
+        /**
+         * If this item's value is not a signed integer array, the returned
+         * span is undefined.
+         */
+        Span<int64_t> GetI64Array() const noexcept {
+            std::size_t count;
+            auto values = RERR_InfoMapIterator_GetI64Array(it, &count);
+            return {values, count};
+        }
+
+        /// Return the floating point array for this item.
+        /**
+         * If this item's value is not a floating point array, the returned
+         * span is undefined.
+         */
+        Span<double> GetF64Array() const noexcept {
+            std::size_t count;
+            auto values = RERR_InfoMapIterator_GetF64Array(it, &count);
+            return {values, count};
+        }
     };
 
     /// Iterator.
@@ -378,6 +671,124 @@ class InfoMap final {
 
     /// Return an iterator pointing past the last item of this info map.
     const_iterator end() const noexcept { return cend(); }
+
+    /// Return the C pointer, retaining ownership.
+    RERR_InfoMapPtr GetCPtr() const noexcept { return ptr; }
+};
+
+/// Non-owning, read-only view of an info map.
+/**
+ * A view is a plain pointer: copying it does not copy the map or touch its
+ * reference count, and none of the member functions allocate. The viewed map
+ * must outlive the view. A default-constructed view is empty.
+ *
+ * Views are usually obtained from ErrorView::GetInfo() or
+ * Error::BorrowInfo().
+ */
+class InfoMapView final {
+    RERR_InfoMapPtr ptr; // non-owning, may be null
+
+  public:
+    /// Construct an empty view.
+    InfoMapView() noexcept : ptr{nullptr} {}
+
+    /// Construct from a borrowed C pointer.
+    explicit InfoMapView(RERR_InfoMapPtr map) noexcept : ptr{map} {}
+
+    /// View an info map.
+    InfoMapView(InfoMap const &map) noexcept : ptr{map.GetCPtr()} {}
+
+    /// Return the C pointer (not owned).
+    RERR_InfoMapPtr GetCPtr() const noexcept { return ptr; }
+
+    /// Return the number of items in the viewed map.
+    size_t GetSize() const noexcept { return RERR_InfoMap_GetSize(ptr); }
+
+    /// Return whether the viewed map is empty.
+    bool IsEmpty() const noexcept { return RERR_InfoMap_IsEmpty(ptr); }
+
+    /// Return whether the viewed map contains the given key.
+    bool HasKey(const char *key) const noexcept {
+        return RERR_InfoMap_HasKey(ptr, key);
+    }
+
+    /// Get the value type for the given key.
+    RERR_InfoValueType GetType(const char *key) const noexcept {
+        return RERR_InfoMap_GetType(ptr, key);
+    }
+
+    /// Retrieve a string value, valid until the viewed map is modified.
+    bool GetString(const char *key, const char *&value) const noexcept {
+        return RERR_InfoMap_GetString(ptr, key, &value);
+    }
+
+#ifdef RERR_HAVE_STRING_VIEW
+    /// Retrieve a string value, valid until the viewed map is modified.
+    bool GetString(const char *key, std::string_view &value) const noexcept {
+        const char *v;
+        bool ok = RERR_InfoMap_GetString(ptr, key, &v);
+        value = ok ? std::string_view(v) : std::string_view();
+        return ok;
+    }
+#endif
+
+    /// Retrieve a boolean value.
+    bool GetBool(const char *key, bool &value) const noexcept {
+        return RERR_InfoMap_GetBool(ptr, key, &value);
+    }
+
+    /// Retrieve a signed integer value.
+    bool GetI64(const char *key, int64_t &value) const noexcept {
+        return RERR_InfoMap_GetI64(ptr, key, &value);
+    }
+
+    /// Retrieve an unsigned integer value.
+    bool GetU64(const char *key, uint64_t &value) const noexcept {
+        return RERR_InfoMap_GetU64(ptr, key, &value);
+    }
+
+    /// Retrieve a floating point value.
+    bool GetF64(const char *key, double &value) const noexcept {
+        return RERR_InfoMap_GetF64(ptr, key, &value);
+    }
+
+    /// Retrieve a byte string, valid until the viewed map is modified.
+    bool GetBytes(const char *key,
+                  Span<unsigned char> &value) const noexcept {
+        const void *data;
+        std::size_t size;
+        bool ok = RERR_InfoMap_GetBytes(ptr, key, &data, &size);
+        value = {static_cast<const unsigned char *>(data), size};
+        return ok;
+    }
+
+    /// Retrieve a signed integer array, valid until the map is modified.
+    bool GetI64Array(const char *key, Span<int64_t> &value) const noexcept {
+        const int64_t *values;
+        std::size_t count;
+        bool ok = RERR_InfoMap_GetI64Array(ptr, key, &values, &count);
+        value = {values, count};
+        return ok;
+    }
+
+    /// Retrieve a floating point array, valid until the map is modified.
+    bool GetF64Array(const char *key, Span<double> &value) const noexcept {
+        const double *values;
+        std::size_t count;
+        bool ok = RERR_InfoMap_GetF64Array(ptr, key, &values, &count);
+        value = {values, count};
+        return ok;
+    }
+
+    /// Return an iterator pointing at the first item of the viewed map.
+    InfoMap::const_iterator begin() const noexcept {
+        return {ptr, RERR_InfoMap_Begin(ptr)};
+    }
+
+    /// Return an iterator pointing past the last item of the viewed map.
+    InfoMap::const_iterator end() const noexcept {
+        return {ptr, RERR_InfoMap_End(ptr)};
+    }
 };
 
 } // namespace RERR
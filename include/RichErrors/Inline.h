@@ -0,0 +1,88 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+/** \file
+ * \brief Optional inline versions of frequently called error accessors.
+ *
+ * The functions in RichErrors.h are not inlined into user code. This header
+ * exposes just enough of the error representation (the out-of-memory sentinel
+ * and a stable prefix of the error object) for the most common predicates to
+ * be inlined, so that checking an error costs a pointer comparison or a
+ * field load.
+ *
+ * Because user code compiled against this header depends on the layout of
+ * the library's error objects, it must be used with a library built with the
+ * same #RERR_INLINE_ABI_VERSION; call RERR_INLINE_ABI_IS_COMPATIBLE() once
+ * (e.g. at startup) to check.
+ *
+ * To have the C++ interface use these functions, define
+ * `RERR_USE_INLINE_ACCESSORS` (consistently for the whole program) before
+ * including RichErrors.hpp.
+ */
+
+#include "RichErrors/RichErrors.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Version of the error object layout assumed by this header.
+/**
+ * Maintainer: increment whenever struct RERR_ErrorInlinePrefix, its position
+ * in the error object, or the out-of-memory sentinel changes.
+ */
+#define RERR_INLINE_ABI_VERSION 1
+
+/// The value of the out-of-memory error.
+#define RERR_INLINE_OUT_OF_MEMORY ((RERR_ErrorPtr)-1)
+
+/// The leading members of every error object other than #RERR_NO_ERROR and
+/// #RERR_INLINE_OUT_OF_MEMORY.
+struct RERR_ErrorInlinePrefix {
+    RERR_DomainHandle domain; ///< Null if the error has no code
+    int32_t code;             ///< Zero if the error has no code
+};
+
+/// Return the #RERR_INLINE_ABI_VERSION with which the library was built.
+int RERR_Inline_GetABIVersion(void);
+
+/// Return whether the library is compatible with this header.
+#define RERR_INLINE_ABI_IS_COMPATIBLE()                                       \
+    (RERR_Inline_GetABIVersion() == RERR_INLINE_ABI_VERSION)
+
+/// Inline equivalent of RERR_Error_IsOutOfMemory().
+static inline bool RERR_Inline_IsOutOfMemory(RERR_ErrorPtr error) {
+    return error == RERR_INLINE_OUT_OF_MEMORY;
+}
+
+/// Inline equivalent of RERR_Error_HasCode().
+static inline bool RERR_Inline_HasCode(RERR_ErrorPtr error) {
+    if (!error) {
+        return false;
+    }
+    if (error == RERR_INLINE_OUT_OF_MEMORY) {
+        return true;
+    }
+    return ((const struct RERR_ErrorInlinePrefix *)error)->domain != NULL;
+}
+
+/// Inline equivalent of RERR_Error_GetCode().
+static inline int32_t RERR_Inline_GetCode(RERR_ErrorPtr error) {
+    if (!error) {
+        return 0;
+    }
+    if (error == RERR_INLINE_OUT_OF_MEMORY) {
+        return RERR_ECODE_OUT_OF_MEMORY;
+    }
+    return ((const struct RERR_ErrorInlinePrefix *)error)->code;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -61,8 +61,10 @@ extern "C" {
  * directly compared to #RERR_NO_ERROR using the `==` operator.
  *
  * Error objects can be created by RERR_Error_Create(),
- * RERR_Error_CreateWithCode(), RERR_Error_CreateOutOfMemory(),
- * RERR_Error_Wrap(), or RERR_Error_WrapWithCode().
+ * RERR_Error_CreateWithCode(), RERR_Error_CreateWithDomainHandle(),
+ * RERR_Error_CreateOutOfMemory(), RERR_Error_Wrap(),
+ * RERR_Error_WrapWithCode(), or RERR_Error_WrapWithDomainHandle(), or the
+ * corresponding `Static` variants that do not copy the message.
  *
  * An error object (unless known to be #RERR_NO_ERROR) must be deallocated by
  * RERR_Error_Destroy().
@@ -122,6 +124,10 @@ enum {
 
     // Code formats
     RERR_ECODE_CODEFORMAT_INVALID = 401, ///< Invalid error code format
+
+    // Serialization
+    RERR_ECODE_SERIAL_MALFORMED = 501, ///< Malformed serialized error
+    RERR_ECODE_SERIAL_VERSION = 502,   ///< Unsupported serialization version
 };
 
 /// Error code formatting mode.
@@ -150,6 +156,19 @@ typedef uint32_t RERR_CodeFormat;
 /// Modifier to remove leading zeros from hex formats
 #define RERR_CodeFormat_HexNoPad (1U << 31)
 
+/// Handle for a registered error code domain.
+/**
+ * A domain handle is obtained by calling RERR_Domain_Lookup() and can be used
+ * in place of the domain name when creating errors with
+ * RERR_Error_CreateWithDomainHandle() or RERR_Error_WrapWithDomainHandle().
+ * This avoids validating and looking up the domain name on every error
+ * creation. Typically a module looks up its domain once, after registration,
+ * and keeps the handle.
+ *
+ * A domain handle remains valid until RERR_Domain_UnregisterAll() is called.
+ */
+typedef const struct RERR_Domain *RERR_DomainHandle;
+
 /// Maximum length of formatted error code.
 #define RERR_FORMATTED_CODE_MAX_LEN 63
 
@@ -175,6 +194,19 @@ void RERR_Domain_UnregisterAll(void);
 RERR_ErrorPtr RERR_Domain_Register(const char *domainName,
                                    RERR_CodeFormat codeFormat);
 
+/// Look up a registered error code domain, obtaining its handle.
+/**
+ * The domain may be a domain registered with RERR_Domain_Register(), or one of
+ * #RERR_DOMAIN_RICHERRORS and #RERR_DOMAIN_CRITICAL.
+ *
+ * On success, `*handle` is set to the domain handle and #RERR_NO_ERROR is
+ * returned. Otherwise, `*handle` is set to `NULL` (if \p handle is not null)
+ * and an error is returned, with code ::RERR_ECODE_DOMAIN_NOT_REGISTERED if
+ * the domain is valid but not registered.
+ */
+RERR_ErrorPtr RERR_Domain_Lookup(const char *domainName,
+                                 RERR_DomainHandle *handle);
+
 /// Create an error without an error code.
 /**
  * Errors without an error code can be used when it is not expected that the
@@ -191,6 +223,27 @@ RERR_ErrorPtr RERR_Domain_Register(const char *domainName,
  */
 RERR_ErrorPtr RERR_Error_Create(const char *message);
 
+/// Create an error without an error code, given the message length.
+/**
+ * This function is equivalent to RERR_Error_Create(), except that the message
+ * need not be null-terminated: exactly \p messageLen characters, which must
+ * not include a null character, are copied. This avoids measuring a string
+ * whose length is already known (e.g. from a C++ `std::string_view`).
+ *
+ * The other functions ending in `N` likewise take the length of the message.
+ */
+RERR_ErrorPtr RERR_Error_CreateN(const char *message, size_t messageLen);
+
+/// Create an error without an error code, without copying the message.
+/**
+ * This function is equivalent to RERR_Error_Create(), except that the message
+ * is not copied: the error refers to the given string, which must therefore
+ * remain valid and unchanged for as long as the error (or any copy of it)
+ * exists. It is intended for string literals and other strings with static
+ * storage duration.
+ */
+RERR_ErrorPtr RERR_Error_CreateStatic(const char *message);
+
 /// Create an error with an error code.
 /**
  * The domain name must be an error code domain previously registered via
@@ -212,6 +265,55 @@ RERR_ErrorPtr RERR_Error_Create(const char *message);
 RERR_ErrorPtr RERR_Error_CreateWithCode(const char *domainName, int32_t code,
                                         const char *message);
 
+/// Create an error with an error code, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_CreateWithCodeN(const char *domainName, int32_t code,
+                                         const char *message,
+                                         size_t messageLen);
+
+/// Create an error with an error code, without copying the message.
+/**
+ * This function is equivalent to RERR_Error_CreateWithCode(), except that the
+ * message is not copied (see RERR_Error_CreateStatic()).
+ */
+RERR_ErrorPtr RERR_Error_CreateWithCodeStatic(const char *domainName,
+                                              int32_t code,
+                                              const char *message);
+
+/// Create an error with an error code, given a domain handle.
+/**
+ * This function is equivalent to RERR_Error_CreateWithCode(), except that the
+ * domain is given as a handle obtained from RERR_Domain_Lookup(). No domain
+ * name validation or lookup takes place.
+ *
+ * If \p domain is `NULL` and code is zero, this function is equivalent to
+ * RERR_Error_Create(). If \p domain is `NULL` but code is nonzero, this
+ * function fails with an error.
+ */
+RERR_ErrorPtr RERR_Error_CreateWithDomainHandle(RERR_DomainHandle domain,
+                                                int32_t code,
+                                                const char *message);
+
+/// Create an error with a domain handle, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_CreateWithDomainHandleN(RERR_DomainHandle domain,
+                                                 int32_t code,
+                                                 const char *message,
+                                                 size_t messageLen);
+
+/// Create an error with a domain handle, without copying the message.
+/**
+ * This function is equivalent to RERR_Error_CreateWithDomainHandle(), except
+ * that the message is not copied (see RERR_Error_CreateStatic()).
+ */
+RERR_ErrorPtr
+RERR_Error_CreateWithDomainHandleStatic(RERR_DomainHandle domain, int32_t code,
+                                        const char *message);
+
 /// Create an error with an error code and auxiliary information.
 /**
  * Errors can only have auxiliary information if they also have a domain and
@@ -226,6 +328,15 @@ RERR_ErrorPtr RERR_Error_CreateWithInfo(const char *domainName, int32_t code,
                                         RERR_InfoMapPtr info,
                                         const char *message);
 
+/// Create an error with auxiliary information, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_CreateWithInfoN(const char *domainName, int32_t code,
+                                         RERR_InfoMapPtr info,
+                                         const char *message,
+                                         size_t messageLen);
+
 /// Destroy an error object.
 /**
  * This function is safe to call on any properly constructed error, including
@@ -235,15 +346,14 @@ void RERR_Error_Destroy(RERR_ErrorPtr error);
 
 /// Copy an error object.
 /**
- * Note that there should normally be no need to copy errors in C code. This
- * function exists to support copy construction of C++ exceptions that wrap an
- * error.
+ * This function exists mainly to support copy construction of C++ exceptions
+ * that wrap an error, but it is also the cheap way to hand an error to another
+ * thread.
  *
- * Note also that copy support is not thread safe. Copies cannot safely be
- * shared between threads without external synchronization around copying and
- * destroying of the error. (The current implementation uses reference counting
- * without any synchronization.) This is intentional because copying is
- * supported solely to allow errors to be wrapped in C++ exceptions.
+ * Error objects are immutable once created, and copying and destroying are
+ * thread safe: copies of the same error may be used and destroyed
+ * concurrently on different threads without external synchronization. (The
+ * current implementation uses atomic reference counting.)
  *
  * Because C++ exception objects must be no-throw copyable, this function is
  * designed not to return an error. How this is achieved is an implementation
@@ -280,9 +390,29 @@ RERR_ErrorPtr RERR_Error_CreateOutOfMemory(void);
  * This function may return an out-of-memory error (not containing the given
  * message or cause) if internal memory allocation fails. Even in that case,
  * the cause error is deallocated.
+ *
+ * If the caller holds the only reference to the cause (it has not been
+ * copied with RERR_Error_Copy(), or the copies have been destroyed), the new
+ * error is usually stored next to the cause, so that repeatedly wrapping an
+ * error does not require an allocation per error. This applies to all of the
+ * `RERR_Error_Wrap*()` functions.
  */
 RERR_ErrorPtr RERR_Error_Wrap(RERR_ErrorPtr cause, const char *message);
 
+/// Create a nested error, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_WrapN(RERR_ErrorPtr cause, const char *message,
+                               size_t messageLen);
+
+/// Create a nested error, without copying the message.
+/**
+ * This function is equivalent to RERR_Error_Wrap(), except that the message is
+ * not copied (see RERR_Error_CreateStatic()).
+ */
+RERR_ErrorPtr RERR_Error_WrapStatic(RERR_ErrorPtr cause, const char *message);
+
 /// Create a nested error with error code, taking ownership of the cause.
 /**
  * The cause can later be retrieved by calling RERR_Error_GetCause() on the new
@@ -304,6 +434,56 @@ RERR_ErrorPtr RERR_Error_WrapWithCode(RERR_ErrorPtr cause,
                                       const char *domainName, int32_t code,
                                       const char *message);
 
+/// Create a nested error with error code, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_WrapWithCodeN(RERR_ErrorPtr cause,
+                                       const char *domainName, int32_t code,
+                                       const char *message,
+                                       size_t messageLen);
+
+/// Create a nested error with error code, without copying the message.
+/**
+ * This function is equivalent to RERR_Error_WrapWithCode(), except that the
+ * message is not copied (see RERR_Error_CreateStatic()).
+ */
+RERR_ErrorPtr RERR_Error_WrapWithCodeStatic(RERR_ErrorPtr cause,
+                                            const char *domainName,
+                                            int32_t code, const char *message);
+
+/// Create a nested error with error code, given a domain handle.
+/**
+ * This function is equivalent to RERR_Error_WrapWithCode(), except that the
+ * domain is given as a handle obtained from RERR_Domain_Lookup().
+ *
+ * \sa RERR_Error_CreateWithDomainHandle()
+ */
+RERR_ErrorPtr RERR_Error_WrapWithDomainHandle(RERR_ErrorPtr cause,
+                                              RERR_DomainHandle domain,
+                                              int32_t code,
+                                              const char *message);
+
+/// Create a nested error with a domain handle, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_WrapWithDomainHandleN(RERR_ErrorPtr cause,
+                                               RERR_DomainHandle domain,
+                                               int32_t code,
+                                               const char *message,
+                                               size_t messageLen);
+
+/// Create a nested error with a domain handle, without copying the message.
+/**
+ * This function is equivalent to RERR_Error_WrapWithDomainHandle(), except
+ * that the message is not copied (see RERR_Error_CreateStatic()).
+ */
+RERR_ErrorPtr RERR_Error_WrapWithDomainHandleStatic(RERR_ErrorPtr cause,
+                                                    RERR_DomainHandle domain,
+                                                    int32_t code,
+                                                    const char *message);
+
 /// Created a nested error with error code and auxiliary info.
 /**
  * \sa RERR_Error_WrapWithCode()
@@ -314,6 +494,65 @@ RERR_ErrorPtr RERR_Error_WrapWithInfo(RERR_ErrorPtr cause,
                                       RERR_InfoMapPtr info,
                                       const char *message);
 
+/// Create a nested error with auxiliary info, given the message length.
+/**
+ * \sa RERR_Error_CreateN()
+ */
+RERR_ErrorPtr RERR_Error_WrapWithInfoN(RERR_ErrorPtr cause,
+                                       const char *domainName, int32_t code,
+                                       RERR_InfoMapPtr info,
+                                       const char *message,
+                                       size_t messageLen);
+
+/// Returned by an #RERR_MessageFormatter that cannot produce a message.
+#define RERR_MESSAGE_FORMAT_FAILED ((size_t)-1)
+
+/// Function that renders a deferred error message.
+/**
+ * The function must write the message, truncated to `destSize - 1`
+ * characters, followed by a null character, to \p dest (nothing is written if
+ * \p destSize is zero) and return the length of the untruncated message, like
+ * `snprintf()`. It may return #RERR_MESSAGE_FORMAT_FAILED instead.
+ *
+ * The function may be called more than once, possibly concurrently, for the
+ * same error, and must produce the same message each time.
+ *
+ * \p args points to the library's copy of the arguments given when the error
+ * was created, suitably aligned for any type.
+ */
+typedef size_t (*RERR_MessageFormatter)(char *dest, size_t destSize,
+                                        const void *args);
+
+/// Create an error whose message is formatted only when requested.
+/**
+ * The \p argsSize bytes at \p args are copied into the error, and
+ * \p formatter is called with the copy when the message is first requested
+ * (for example, by RERR_Error_GetMessage()). Errors that are only examined
+ * by domain and code, and then destroyed, thus never pay for formatting the
+ * message. The arguments must remain meaningful for the lifetime of the
+ * error: they should not contain pointers to anything that might be freed
+ * first (string literals are fine).
+ *
+ * \p domain and \p code have the same meaning as for
+ * RERR_Error_CreateWithDomainHandle(). If \p formatter is null, an error in
+ * the #RERR_DOMAIN_RICHERRORS domain is returned. The formatter is never
+ * called by this function.
+ */
+RERR_ErrorPtr RERR_Error_CreateDeferred(RERR_DomainHandle domain,
+                                        int32_t code,
+                                        RERR_MessageFormatter formatter,
+                                        const void *args, size_t argsSize);
+
+/// Create a nested error whose message is formatted only when requested.
+/**
+ * \sa RERR_Error_Wrap()
+ * \sa RERR_Error_CreateDeferred()
+ */
+RERR_ErrorPtr RERR_Error_WrapDeferred(RERR_ErrorPtr cause,
+                                      RERR_DomainHandle domain, int32_t code,
+                                      RERR_MessageFormatter formatter,
+                                      const void *args, size_t argsSize);
+
 /// Return whether the given error has an error domain and code.
 bool RERR_Error_HasCode(RERR_ErrorPtr error);
 
@@ -342,6 +581,18 @@ int32_t RERR_Error_GetCode(RERR_ErrorPtr error);
  */
 void RERR_Error_FormatCode(RERR_ErrorPtr error, char *dest, size_t destSize);
 
+/// Format the error code of the given error and return its length.
+/**
+ * Same as RERR_Error_FormatCode(), except that the length of the string
+ * written to `dest` (not including the null terminator) is returned.
+ *
+ * If `dest` is null or `destSize` is zero, nothing is written and the length
+ * of the complete formatted code is returned. This is never greater than
+ * #RERR_FORMATTED_CODE_MAX_LEN.
+ */
+size_t RERR_Error_FormatCodeLen(RERR_ErrorPtr error, char *dest,
+                                size_t destSize);
+
 /// Return whether the given error has non-empty auxiliary info.
 bool RERR_Error_HasInfo(RERR_ErrorPtr error);
 
@@ -352,6 +603,17 @@ bool RERR_Error_HasInfo(RERR_ErrorPtr error);
  */
 RERR_InfoMapPtr RERR_Error_GetInfo(RERR_ErrorPtr error);
 
+/// Get auxiliary info attached to the given error, without copying.
+/**
+ * Unlike RERR_Error_GetInfo(), no reference is added: the returned info map
+ * is owned by the error and valid for the error's lifetime. It is immutable
+ * and must not be destroyed by the caller.
+ *
+ * If the error has no info, null is returned; all read-only info map
+ * functions treat null as an empty map.
+ */
+RERR_InfoMapPtr RERR_Error_BorrowInfo(RERR_ErrorPtr error);
+
 /// Return the error message of the given error.
 /**
  * A human-readable description is returned in the case that the given error is
@@ -359,6 +621,11 @@ RERR_InfoMapPtr RERR_Error_GetInfo(RERR_ErrorPtr error);
  * empty message. Thus, it is always safe to treat the return value as a C
  * string.
  *
+ * If the error was created with a deferred message (see
+ * RERR_Error_CreateDeferred()), the message is formatted by the first call.
+ * If formatting fails, a description is returned and formatting is retried
+ * by the next call.
+ *
  * The returned string is valid for the lifetime of the error object.
  */
 const char *RERR_Error_GetMessage(RERR_ErrorPtr error);
@@ -383,6 +650,222 @@ RERR_ErrorPtr RERR_Error_GetCause(RERR_ErrorPtr error);
  */
 bool RERR_Error_IsOutOfMemory(RERR_ErrorPtr error);
 
+/// Output function for RERR_Error_Format().
+/**
+ * Called with successive pieces of the formatted output, which is not null
+ * terminated; \p size is never zero. Return false to stop formatting (e.g.
+ * if the output could not be written).
+ */
+typedef bool (*RERR_ErrorFormatSink)(void *context, const char *data,
+                                     size_t size);
+
+/// Options for RERR_Error_Format() (may be combined with bitwise or).
+enum {
+    /// Write a JSON array of objects instead of text
+    RERR_ErrorFormatJSON = 1,
+    /// Leave out auxiliary info
+    RERR_ErrorFormatNoInfo = 2,
+    /// Write only the given error, not its causes
+    RERR_ErrorFormatNoCauses = 4,
+};
+
+/// Render the given error and its chain of causes.
+/**
+ * The output is produced in a single pass through \p sink, without
+ * allocating memory or copying the errors' info maps.
+ *
+ * The text format has one line per error in the chain, outermost first, with
+ * lines after the first prefixed by "Caused by: ". Each line has the message,
+ * the domain and formatted code in square brackets (if the error has a
+ * code), and the info in braces (if not empty). There is no trailing newline.
+ * Byte string info values are written in hexadecimal (prefixed with "0x" in
+ * text and as a string in JSON), and arrays in square brackets.
+ *
+ * With #RERR_ErrorFormatJSON, the output is an array (empty for
+ * #RERR_NO_ERROR) with an object per error, outermost first, having members
+ * `message` and, as applicable, `domain`, `code`, `formattedCode`, and
+ * `info`. Floating point info values that are not finite are written as
+ * `null`.
+ *
+ * \return false if \p sink is null or returned false; true otherwise
+ */
+bool RERR_Error_Format(RERR_ErrorPtr error, RERR_ErrorFormatSink sink,
+                       void *context, uint32_t options);
+
+/// Version of the binary format written by RERR_Error_Serialize().
+#define RERR_SERIAL_VERSION 1
+
+/// Encode the given error and its chain of causes in a binary format.
+/**
+ * The encoding contains, for each error in the chain, its domain name, code,
+ * message, and typed info items. It does not depend on the host's byte order
+ * or on pointers, so it can be decoded by RERR_Error_Deserialize() in another
+ * process (which must have registered the same domains).
+ *
+ * Strings are stored with their length and a null terminator, so that a
+ * decoded error can refer to them in place (see
+ * #RERR_DeserializeBorrowStrings).
+ *
+ * If \p destSize is at least the encoded size, the encoding is written to
+ * \p dest; otherwise nothing is written (\p dest may be null). Either way,
+ * the encoded size in bytes is returned.
+ */
+size_t RERR_Error_Serialize(RERR_ErrorPtr error, void *dest, size_t destSize);
+
+/// Flags for RERR_Error_Deserialize().
+enum {
+    /// Refer to messages and info keys in the serialized data instead of
+    /// copying them. The data must then remain valid and unmodified for as
+    /// long as the decoded error or any copy of it exists. (Info string
+    /// values are always copied.)
+    RERR_DeserializeBorrowStrings = 1,
+};
+
+/// Decode an error encoded by RERR_Error_Serialize().
+/**
+ * On success, the decoded error (which may be #RERR_NO_ERROR) is stored in
+ * \p result and #RERR_NO_ERROR is returned.
+ *
+ * On failure, \p result is set to #RERR_NO_ERROR and an error is returned,
+ * with domain #RERR_DOMAIN_RICHERRORS and code
+ * ::RERR_ECODE_SERIAL_MALFORMED or ::RERR_ECODE_SERIAL_VERSION if \p data is
+ * not a valid encoding, or ::RERR_ECODE_DOMAIN_NOT_REGISTERED if it uses a
+ * domain that is not registered in this process. The data is fully validated
+ * before anything is accessed out of bounds, so untrusted input is safe.
+ *
+ * \param data the serialized error
+ * \param size the size of \p data, in bytes; may be larger than the encoding
+ * \param flags zero or #RERR_DeserializeBorrowStrings
+ * \param result receives the decoded error, owned by the caller
+ */
+RERR_ErrorPtr RERR_Error_Deserialize(const void *data, size_t size,
+                                     uint32_t flags, RERR_ErrorPtr *result);
+
+/// Memory allocator used by RichErrors.
+/**
+ * All memory allocated by RichErrors (for errors, info maps, domains, and
+ * error maps) is obtained through the installed allocator. Each function is
+ * passed \p context as its first argument.
+ *
+ * The functions must behave like the C library functions `malloc()`,
+ * `realloc()`, and `free()`: \p alloc and \p realloc return null on failure
+ * (in which case RichErrors reports out-of-memory as usual), \p realloc may be
+ * passed a null pointer, and \p free may be passed a null pointer. They must
+ * be thread safe if RichErrors is used from more than one thread.
+ *
+ * \sa RERR_Allocator_Set()
+ */
+typedef struct RERR_Allocator {
+    /// Allocate \p size bytes.
+    void *(*alloc)(void *context, size_t size);
+    /// Resize a block, or allocate if \p ptr is null.
+    void *(*realloc)(void *context, void *ptr, size_t size);
+    /// Deallocate a block; do nothing if \p ptr is null.
+    void (*free)(void *context, void *ptr);
+    /// User data passed to the functions.
+    void *context;
+} RERR_Allocator;
+
+/// Install the memory allocator used by RichErrors.
+/**
+ * The allocator is copied. If \p allocator is null, the default allocator
+ * (the C library `malloc()`, `realloc()`, and `free()`) is restored.
+ *
+ * This function is not thread safe. It must be called when no RichErrors
+ * object (error, info map, error map, or registered domain) exists, typically
+ * at program startup, because objects must be deallocated by the allocator
+ * that allocated them. Blocks held by per-thread pools (see
+ * RERR_Pool_SetLimits()) must also have been released.
+ *
+ * \return An error if any of the functions in \p allocator is null.
+ * \return #RERR_NO_ERROR otherwise.
+ */
+RERR_ErrorPtr RERR_Allocator_Set(const RERR_Allocator *allocator);
+
+/// Get the currently installed memory allocator.
+/**
+ * If \p allocator is null, nothing is done.
+ */
+void RERR_Allocator_Get(RERR_Allocator *allocator);
+
+/// Set the calling thread's limits for pooled error and info map blocks.
+/**
+ * When RichErrors is built with the `pool` option, error objects (with short
+ * messages) and info maps are allocated from a per-thread freelist of
+ * fixed-size blocks, falling back to the heap when the list is empty. Freed
+ * blocks are returned to the freelist of the thread that frees them, unless it
+ * already holds the maximum number; excess blocks are returned to the heap.
+ * Each thread's freelists are released when the thread exits.
+ *
+ * This function sets the maximum number of free blocks kept by the calling
+ * thread, releasing any excess blocks. Setting a limit to zero disables
+ * pooling for that kind of object on the calling thread. By default, each
+ * thread keeps up to 32 blocks of each kind.
+ *
+ * When RichErrors is built without the `pool` option, this function does
+ * nothing.
+ */
+void RERR_Pool_SetLimits(size_t maxErrors, size_t maxInfoMaps);
+
+/// Preallocate pooled blocks for the calling thread.
+/**
+ * Ensure that the calling thread's freelists hold at least the given numbers
+ * of blocks, raising the limits (see RERR_Pool_SetLimits()) if necessary. This
+ * allows a latency-sensitive thread to create errors without calling into the
+ * heap allocator, as long as the messages are short or static.
+ *
+ * When RichErrors is built without the `pool` option, this function does
+ * nothing and returns #RERR_NO_ERROR.
+ *
+ * \return An out-of-memory error if allocation failed (blocks allocated up to
+ * that point remain in the freelists).
+ * \return #RERR_NO_ERROR otherwise.
+ */
+RERR_ErrorPtr RERR_Pool_Reserve(size_t errors, size_t infoMaps);
+
+/// Release all free blocks held by the calling thread's pool.
+/**
+ * The limits are not changed. When RichErrors is built without the `pool`
+ * option, this function does nothing.
+ */
+void RERR_Pool_Drain(void);
+
+/// Instrumentation counters.
+/**
+ * Counts of objects currently alive ("live") and created since the process
+ * started, as returned by RERR_Stats_Get(). Out-of-memory sentinel errors and
+ * info maps are not counted. Allocation counts include all memory allocated by
+ * RichErrors via the current allocator (see RERR_Allocator_Set()).
+ */
+typedef struct RERR_Stats {
+    uint64_t errorsLive;             ///< Errors not yet destroyed
+    uint64_t errorsCreated;          ///< Errors created
+    uint64_t infoMapsLive;           ///< Info maps not yet destroyed
+    uint64_t infoMapsCreated;        ///< Info maps created
+    uint64_t domainsRegistered;      ///< Currently registered domains
+    uint64_t errorMapEntriesLive;    ///< Errors registered in error maps
+    uint64_t errorMapEntriesCreated; ///< Error map registrations made
+    uint64_t allocationsLive;        ///< Memory blocks not yet freed
+    uint64_t allocations;            ///< Memory blocks allocated or resized
+    uint64_t bytesAllocated;         ///< Total bytes allocated or resized to
+
+    // Maintainer: Never change or remove fields once released; new fields may
+    // only be added together with a new function to retrieve them.
+} RERR_Stats;
+
+/// Get the instrumentation counters.
+/**
+ * The counters are only maintained when RichErrors is built with the `stats`
+ * option. The values are read individually (without a consistent snapshot),
+ * so they may be slightly inconsistent with each other while other threads
+ * are using RichErrors.
+ *
+ * \return `true` if the counters were retrieved.
+ * \return `false`, setting all fields of \p stats to zero, if RichErrors was
+ * built without the `stats` option.
+ */
+bool RERR_Stats_Get(RERR_Stats *stats);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
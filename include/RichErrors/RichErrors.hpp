@@ -14,15 +14,54 @@
 
 #include "RichErrors/InfoMap.hpp"
 #include "RichErrors/RichErrors.h"
+#include "RichErrors/StringRef.hpp"
 
+#ifdef RERR_USE_INLINE_ACCESSORS
+#include "RichErrors/Inline.h"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <iterator>
+#include <new>
+#include <ostream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 /// C++ interface for RichErrors.
 namespace RERR {
 
+namespace internal {
+
+// Accessors that are inlined if RERR_USE_INLINE_ACCESSORS is defined.
+#ifdef RERR_USE_INLINE_ACCESSORS
+inline bool HasCode(RERR_ErrorPtr e) noexcept {
+    return RERR_Inline_HasCode(e);
+}
+inline int32_t GetCode(RERR_ErrorPtr e) noexcept {
+    return RERR_Inline_GetCode(e);
+}
+inline bool IsOutOfMemory(RERR_ErrorPtr e) noexcept {
+    return RERR_Inline_IsOutOfMemory(e);
+}
+#else
+inline bool HasCode(RERR_ErrorPtr e) noexcept {
+    return RERR_Error_HasCode(e);
+}
+inline int32_t GetCode(RERR_ErrorPtr e) noexcept {
+    return RERR_Error_GetCode(e);
+}
+inline bool IsOutOfMemory(RERR_ErrorPtr e) noexcept {
+    return RERR_Error_IsOutOfMemory(e);
+}
+#endif
+
+} // namespace internal
+
 /// Return the error code domain for errors arising in RichErrors.
 inline std::string const &RichErrorsDomain() {
     static std::string const s = RERR_DOMAIN_RICHERRORS;
@@ -35,6 +74,158 @@ inline std::string const &CriticalDomain() {
     return s;
 }
 
+/// Non-owning, read-only view of an error.
+/**
+ * A view is a plain pointer: copying it, walking the cause chain, and
+ * inspecting info do not allocate or touch reference counts. The viewed error
+ * must outlive the view (causes and info are owned by it).
+ *
+ * \code{.cpp}
+ * for (RERR::ErrorView e : err.View().CauseChain()) {
+ *     if (e.HasCode() && std::strcmp(e.GetDomain(), "MyDomain") == 0) {
+ *         // ...
+ *     }
+ * }
+ * \endcode
+ */
+class ErrorView final {
+    RERR_ErrorPtr ptr; // non-owning
+
+  public:
+    /// Construct a view of no error.
+    ErrorView() noexcept : ptr{RERR_NO_ERROR} {}
+
+    /// Construct from a borrowed C pointer.
+    explicit ErrorView(RERR_ErrorPtr error) noexcept : ptr{error} {}
+
+    /// Return the C pointer (not owned).
+    RERR_ErrorPtr GetCPtr() const noexcept { return ptr; }
+
+    /// Return whether this views an error.
+    bool IsError() const noexcept { return ptr != RERR_NO_ERROR; }
+
+    /// Return whether this views no error.
+    bool IsSuccess() const noexcept { return ptr == RERR_NO_ERROR; }
+
+    /// Return whether the error is an out-of-memory error.
+    bool IsOutOfMemory() const noexcept {
+        return internal::IsOutOfMemory(ptr);
+    }
+
+    /// Return whether the error has a code and domain.
+    bool HasCode() const noexcept { return internal::HasCode(ptr); }
+
+    /// Return the error code domain, or an empty string if no code.
+    char const *GetDomain() const noexcept {
+        return RERR_Error_GetDomain(ptr);
+    }
+
+    /// Return the error code, or zero if no code.
+    int32_t GetCode() const noexcept { return internal::GetCode(ptr); }
+
+    /// Format the error code into a caller-provided buffer.
+    /**
+     * \sa RERR_Error_FormatCodeLen()
+     */
+    std::size_t FormatCode(char *dest, std::size_t destSize) const noexcept {
+        return RERR_Error_FormatCodeLen(ptr, dest, destSize);
+    }
+
+    /// Return the error message.
+    char const *GetMessage() const noexcept {
+        return RERR_Error_GetMessage(ptr);
+    }
+
+    /// Return whether non-empty auxiliary info is attached.
+    bool HasInfo() const noexcept { return RERR_Error_HasInfo(ptr); }
+
+    /// Return a view of the auxiliary info (empty if none).
+    InfoMapView GetInfo() const noexcept {
+        return InfoMapView(RERR_Error_BorrowInfo(ptr));
+    }
+
+    /// Return whether the error has a cause.
+    bool HasCause() const noexcept { return RERR_Error_HasCause(ptr); }
+
+    /// Return a view of the cause (viewing no error if none).
+    ErrorView GetCause() const noexcept {
+        return ErrorView(RERR_Error_GetCause(ptr));
+    }
+
+    /// Forward iterator over a cause chain.
+    class ChainIterator final {
+        RERR_ErrorPtr ptr;
+
+      public:
+        /// The value type of the iterator.
+        using value_type = ErrorView;
+
+        /// The type for difference between two iterators.
+        using difference_type = std::ptrdiff_t;
+
+        /// The type for a reference to a value.
+        using reference = ErrorView;
+
+        /// The type for a pointer to a value.
+        using pointer = void;
+
+        /// The iterator category.
+        using iterator_category = std::forward_iterator_tag;
+
+        /// Construct pointing at the given error (past-end if no error).
+        explicit ChainIterator(RERR_ErrorPtr error = RERR_NO_ERROR) noexcept
+            : ptr{error} {}
+
+        /// Access the current error.
+        ErrorView operator*() const noexcept { return ErrorView(ptr); }
+
+        /// Advance to the cause, returning the new iterator.
+        ChainIterator &operator++() noexcept {
+            ptr = RERR_Error_GetCause(ptr);
+            return *this;
+        }
+
+        /// Advance to the cause, returning the original iterator.
+        ChainIterator operator++(int) noexcept {
+            ChainIterator ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        /// Return whether two iterators point to the same error.
+        bool operator==(ChainIterator const &rhs) const noexcept {
+            return ptr == rhs.ptr;
+        }
+
+        /// Return whether two iterators point to different errors.
+        bool operator!=(ChainIterator const &rhs) const noexcept {
+            return ptr != rhs.ptr;
+        }
+    };
+
+    /// Range over a cause chain, for use with range-based for.
+    class ChainRange final {
+        RERR_ErrorPtr ptr;
+
+      public:
+        /// Construct the range starting at the given error.
+        explicit ChainRange(RERR_ErrorPtr error) noexcept : ptr{error} {}
+
+        /// Return an iterator pointing at the first error.
+        ChainIterator begin() const noexcept { return ChainIterator(ptr); }
+
+        /// Return the past-end iterator.
+        ChainIterator end() const noexcept { return ChainIterator(); }
+    };
+
+    /// Return the chain of this error and its causes, outermost first.
+    /**
+     * Like Error::GetCauseChain(), but without copying: the range is empty
+     * if this views no error.
+     */
+    ChainRange CauseChain() const noexcept { return ChainRange(ptr); }
+};
+
 /// An error.
 /**
  * This is the primary error object.
@@ -43,6 +234,80 @@ class Error final {
     /// The C pointer.
     RERR_ErrorPtr ptr;
 
+    // Sinks for RERR_Error_Format(); exceptions must not cross the C code.
+    struct StringSink {
+        std::string *dest;
+        bool outOfMemory;
+    };
+
+    static bool WriteToString(void *context, const char *data,
+                              std::size_t size) noexcept {
+        auto sink = static_cast<StringSink *>(context);
+        try {
+            sink->dest->append(data, size);
+        } catch (std::bad_alloc const &) {
+            sink->outOfMemory = true;
+            return false;
+        }
+        return true;
+    }
+
+    static bool WriteToStream(void *context, const char *data,
+                              std::size_t size) noexcept {
+        auto &os = *static_cast<std::ostream *>(context);
+        try {
+            os.write(data, static_cast<std::streamsize>(size));
+        } catch (...) { // Only if the stream's exception mask is set
+            return false;
+        }
+        return bool(os);
+    }
+
+    struct BufferSink {
+        char *dest;
+        std::size_t size;
+        std::size_t length; // Untruncated
+    };
+
+    static bool WriteToBuffer(void *context, const char *data,
+                              std::size_t size) noexcept {
+        auto sink = static_cast<BufferSink *>(context);
+        if (sink->length + 1 < sink->size) {
+            std::size_t room = sink->size - 1 - sink->length;
+            std::memcpy(sink->dest + sink->length, data,
+                        size < room ? size : room);
+        }
+        sink->length += size;
+        return true;
+    }
+
+    // Formatters are copied byte-wise into the C error and never destroyed.
+    template <typename F>
+    using EnableIfDeferrable = std::enable_if_t<
+        std::is_trivially_copyable<F>::value &&
+            std::is_trivially_destructible<F>::value &&
+            alignof(F) <= alignof(std::max_align_t),
+        int>;
+
+    // RERR_MessageFormatter calling a copy of a C++ callable.
+    template <typename F>
+    static std::size_t FormatDeferred(char *dest, std::size_t destSize,
+                                      const void *args) noexcept {
+        try {
+            std::string message = (*static_cast<F const *>(args))();
+            if (destSize > 0) {
+                std::size_t n = message.size() < destSize - 1
+                                    ? message.size()
+                                    : destSize - 1;
+                std::memcpy(dest, message.data(), n);
+                dest[n] = '\0';
+            }
+            return message.size();
+        } catch (...) {
+            return RERR_MESSAGE_FORMAT_FAILED;
+        }
+    }
+
   public:
     ~Error() { RERR_Error_Destroy(ptr); }
 
@@ -74,33 +339,40 @@ class Error final {
     Error() noexcept : ptr{RERR_NO_ERROR} {}
 
     /// Construct without error code.
-    explicit Error(std::string const &message) noexcept
-        : ptr{RERR_Error_Create(message.c_str())} {}
+    explicit Error(StringRef message) noexcept
+        : ptr{RERR_Error_CreateN(message.Data(), message.Size())} {}
 
     /// Construct with error code.
-    Error(std::string const &domain, int32_t code,
-          std::string const &message) noexcept
-        : ptr{RERR_Error_CreateWithCode(domain.c_str(), code,
-                                        message.c_str())} {}
+    Error(CStringRef domain, int32_t code, StringRef message) noexcept
+        : ptr{RERR_Error_CreateWithCodeN(domain.CStr(), code, message.Data(),
+                                         message.Size())} {}
+
+    /// Construct with error code, given a domain handle.
+    /**
+     * \sa LookupDomain()
+     */
+    Error(RERR_DomainHandle domain, int32_t code, StringRef message) noexcept
+        : ptr{RERR_Error_CreateWithDomainHandleN(domain, code, message.Data(),
+                                                 message.Size())} {}
 
     /// Construct with error code and auxiliary info.
     /**
      * Because the new error takes ownership of the info map, it must be an
      * rvalue (use `std::move()` if necessary).
      */
-    Error(std::string const &domain, int32_t code, InfoMap &&info,
-          std::string const &message) noexcept
-        : ptr{RERR_Error_CreateWithInfo(domain.c_str(), code,
-                                        info.ReleaseCPtr(), message.c_str())} {
-    }
+    Error(CStringRef domain, int32_t code, InfoMap &&info,
+          StringRef message) noexcept
+        : ptr{RERR_Error_CreateWithInfoN(domain.CStr(), code,
+                                         info.ReleaseCPtr(), message.Data(),
+                                         message.Size())} {}
 
     /// Construct with cause, without error code.
     /**
      * Because the new error takes ownership of the cause, the cause must
      * be an rvalue (use `std::move()` if necessary).
      */
-    Error(Error &&cause, std::string const &message) noexcept
-        : ptr{RERR_Error_Wrap(cause.ptr, message.c_str())} {
+    Error(Error &&cause, StringRef message) noexcept
+        : ptr{RERR_Error_WrapN(cause.ptr, message.Data(), message.Size())} {
         cause.ptr = nullptr;
     }
 
@@ -109,10 +381,23 @@ class Error final {
      * Because the new error takes ownership of the cause, the cause must
      * be an rvalue (use `std::move()` if necessary).
      */
-    Error(Error &&cause, std::string const &domain, int32_t code,
-          std::string const &message) noexcept
-        : ptr{RERR_Error_WrapWithCode(cause.ptr, domain.c_str(), code,
-                                      message.c_str())} {
+    Error(Error &&cause, CStringRef domain, int32_t code,
+          StringRef message) noexcept
+        : ptr{RERR_Error_WrapWithCodeN(cause.ptr, domain.CStr(), code,
+                                       message.Data(), message.Size())} {
+        cause.ptr = nullptr;
+    }
+
+    /// Construct with cause and error code, given a domain handle.
+    /**
+     * Because the new error takes ownership of the cause, the cause must
+     * be an rvalue (use `std::move()` if necessary).
+     */
+    Error(Error &&cause, RERR_DomainHandle domain, int32_t code,
+          StringRef message) noexcept
+        : ptr{RERR_Error_WrapWithDomainHandleN(cause.ptr, domain, code,
+                                               message.Data(),
+                                               message.Size())} {
         cause.ptr = nullptr;
     }
 
@@ -121,10 +406,69 @@ class Error final {
      * Because the new error takes ownership of the cause and the info map,
      * they must be rvalues (use `std::move()` if necessary).
      */
-    Error(Error &&cause, std::string const &domain, int32_t code,
-          InfoMap &&info, std::string const &message) noexcept
-        : ptr{RERR_Error_WrapWithInfo(cause.ptr, domain.c_str(), code,
-                                      info.ReleaseCPtr(), message.c_str())} {
+    Error(Error &&cause, CStringRef domain, int32_t code, InfoMap &&info,
+          StringRef message) noexcept
+        : ptr{RERR_Error_WrapWithInfoN(cause.ptr, domain.CStr(), code,
+                                       info.ReleaseCPtr(), message.Data(),
+                                       message.Size())} {
+        cause.ptr = nullptr;
+    }
+
+    /// Construct without error code, without copying the message.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    explicit Error(StaticMessage message) noexcept
+        : ptr{RERR_Error_CreateStatic(message.CStr())} {}
+
+    /// Construct with error code, without copying the message.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    Error(CStringRef domain, int32_t code, StaticMessage message) noexcept
+        : ptr{RERR_Error_CreateWithCodeStatic(domain.CStr(), code,
+                                              message.CStr())} {}
+
+    /// Construct with error code, given a domain handle, without copying
+    /// the message.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    Error(RERR_DomainHandle domain, int32_t code,
+          StaticMessage message) noexcept
+        : ptr{RERR_Error_CreateWithDomainHandleStatic(domain, code,
+                                                      message.CStr())} {}
+
+    /// Construct with cause, without error code, without copying the
+    /// message.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    Error(Error &&cause, StaticMessage message) noexcept
+        : ptr{RERR_Error_WrapStatic(cause.ptr, message.CStr())} {
+        cause.ptr = nullptr;
+    }
+
+    /// Construct with cause and error code, without copying the message.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    Error(Error &&cause, CStringRef domain, int32_t code,
+          StaticMessage message) noexcept
+        : ptr{RERR_Error_WrapWithCodeStatic(cause.ptr, domain.CStr(), code,
+                                            message.CStr())} {
+        cause.ptr = nullptr;
+    }
+
+    /// Construct with cause and error code, given a domain handle, without
+    /// copying the message.
+    /**
+     * See StaticMessage regarding the lifetime of the message.
+     */
+    Error(Error &&cause, RERR_DomainHandle domain, int32_t code,
+          StaticMessage message) noexcept
+        : ptr{RERR_Error_WrapWithDomainHandleStatic(cause.ptr, domain, code,
+                                                    message.CStr())} {
         cause.ptr = nullptr;
     }
 
@@ -159,6 +503,42 @@ class Error final {
         return Error(RERR_Error_CreateOutOfMemory());
     }
 
+    /// Create an error whose message is formatted only when requested.
+    /**
+     * \p format is called with no arguments, and must return the message as
+     * a `std::string`, when the message is first requested (see
+     * RERR_Error_CreateDeferred()). It is copied into the error, so it must
+     * be trivially copyable (e.g. a lambda capturing only values such as
+     * numbers and string literals). If it throws, the message is reported as
+     * unavailable.
+     */
+    template <typename F, EnableIfDeferrable<F> = 0>
+    static Error Deferred(RERR_DomainHandle domain, int32_t code,
+                          F const &format) noexcept {
+        return Error(RERR_Error_CreateDeferred(domain, code, FormatDeferred<F>,
+                                               &format, sizeof(F)));
+    }
+
+    /// Create a nested error whose message is formatted only when requested.
+    /**
+     * \sa Deferred(RERR_DomainHandle, int32_t, F const &)
+     */
+    template <typename F, EnableIfDeferrable<F> = 0>
+    static Error Deferred(Error &&cause, RERR_DomainHandle domain,
+                          int32_t code, F const &format) noexcept {
+        RERR_ErrorPtr ptr = RERR_Error_WrapDeferred(
+            cause.ptr, domain, code, FormatDeferred<F>, &format, sizeof(F));
+        cause.ptr = nullptr;
+        return Error(std::move(ptr));
+    }
+
+    /// Return a non-owning view of this error.
+    /**
+     * The view is valid while this error object exists and is not assigned
+     * to or moved from.
+     */
+    ErrorView View() const noexcept { return ErrorView(ptr); }
+
     /// Return whether this instance represents an error.
     bool IsError() const noexcept { return ptr != RERR_NO_ERROR; }
 
@@ -166,7 +546,7 @@ class Error final {
     bool IsSuccess() const noexcept { return ptr == RERR_NO_ERROR; }
 
     /// Return whether this error has a code and domain.
-    bool HasCode() const noexcept { return RERR_Error_HasCode(ptr); }
+    bool HasCode() const noexcept { return internal::HasCode(ptr); }
 
     /// Return the error code domain.
     /**
@@ -189,7 +569,7 @@ class Error final {
     /**
      * If this error does not have a code, zero is returned.
      */
-    int32_t GetCode() const noexcept { return RERR_Error_GetCode(ptr); }
+    int32_t GetCode() const noexcept { return internal::GetCode(ptr); }
 
     /// Return the error code, formatted as string.
     /**
@@ -198,8 +578,26 @@ class Error final {
      */
     std::string FormatCode() const noexcept {
         char buf[RERR_FORMATTED_CODE_MAX_SIZE];
-        RERR_Error_FormatCode(ptr, buf, sizeof(buf));
-        return buf;
+        std::size_t len = RERR_Error_FormatCodeLen(ptr, buf, sizeof(buf));
+        return std::string(buf, len);
+    }
+
+    /// Format the error code into a caller-provided buffer.
+    /**
+     * \return the length written, not including the null terminator
+     * \sa RERR_Error_FormatCodeLen()
+     */
+    std::size_t FormatCode(char *dest, std::size_t destSize) const noexcept {
+        return RERR_Error_FormatCodeLen(ptr, dest, destSize);
+    }
+
+    /// Append the formatted error code to a string.
+    /**
+     * The string is not reallocated if its capacity suffices.
+     */
+    void AppendFormattedCode(std::string &dest) const {
+        char buf[RERR_FORMATTED_CODE_MAX_SIZE];
+        dest.append(buf, RERR_Error_FormatCodeLen(ptr, buf, sizeof(buf)));
     }
 
     /// Return whether non-empty auxiliary info is attached.
@@ -210,6 +608,14 @@ class Error final {
         return InfoMap(RERR_Error_GetInfo(ptr));
     }
 
+    /// Get a view of the auxiliary info, without copying.
+    /**
+     * \sa RERR_Error_BorrowInfo()
+     */
+    InfoMapView BorrowInfo() const noexcept {
+        return InfoMapView(RERR_Error_BorrowInfo(ptr));
+    }
+
     /// Return the error message.
     /**
      * This function returns a copy of the message.
@@ -259,9 +665,86 @@ class Error final {
         return ret;
     }
 
+    /// Render this error and its causes, appending to a string.
+    /**
+     * \p options is as for RERR_Error_Format().
+     *
+     * May throw `std::bad_alloc` if the string could not be grown.
+     */
+    void Format(std::string &dest, std::uint32_t options = 0) const {
+        StringSink sink{&dest, false};
+        RERR_Error_Format(ptr, WriteToString, &sink, options);
+        if (sink.outOfMemory) {
+            throw std::bad_alloc();
+        }
+    }
+
+    /// Render this error and its causes as a string.
+    /**
+     * \sa Format(std::string &, std::uint32_t) const
+     */
+    std::string Format(std::uint32_t options = 0) const {
+        std::string ret;
+        Format(ret, options);
+        return ret;
+    }
+
+    /// Render this error and its causes to a stream.
+    /**
+     * Formatting stops if the stream enters a failed state.
+     */
+    void Format(std::ostream &dest, std::uint32_t options = 0) const {
+        RERR_Error_Format(ptr, WriteToStream, &dest, options);
+    }
+
+    /// Render this error and its causes into a fixed buffer.
+    /**
+     * Like `snprintf()`, the output is truncated to fit in \p destSize
+     * bytes, including the null terminator, and the length of the untruncated
+     * output is returned. Nothing is written if \p destSize is zero.
+     */
+    std::size_t Format(char *dest, std::size_t destSize,
+                       std::uint32_t options = 0) const noexcept {
+        BufferSink sink{dest, destSize, 0};
+        RERR_Error_Format(ptr, WriteToBuffer, &sink, options);
+        if (destSize > 0) {
+            dest[sink.length < destSize ? sink.length : destSize - 1] = '\0';
+        }
+        return sink.length;
+    }
+
     /// Return whether this error is an out-of-memory error.
     bool IsOutOfMemory() const noexcept {
-        return RERR_Error_IsOutOfMemory(ptr);
+        return internal::IsOutOfMemory(ptr);
+    }
+
+    /// Encode this error and its causes in the binary format.
+    /**
+     * \sa RERR_Error_Serialize()
+     *
+     * May throw `std::bad_alloc` if the return value could not be
+     * allocated.
+     */
+    std::vector<unsigned char> Serialize() const {
+        std::vector<unsigned char> ret(RERR_Error_Serialize(ptr, nullptr, 0));
+        RERR_Error_Serialize(ptr, ret.data(), ret.size());
+        return ret;
+    }
+
+    /// Decode an error encoded by Serialize().
+    /**
+     * On success, the decoded error is stored in \p result and no-error is
+     * returned; otherwise the returned error describes the failure.
+     *
+     * \sa RERR_Error_Deserialize()
+     */
+    static Error Deserialize(const void *data, std::size_t size,
+                             Error &result,
+                             std::uint32_t flags = 0) noexcept {
+        RERR_ErrorPtr decoded;
+        Error ret(RERR_Error_Deserialize(data, size, flags, &decoded));
+        result = Error(std::move(decoded));
+        return ret;
     }
 };
 
@@ -269,9 +752,18 @@ class Error final {
 inline void UnregisterAllDomains() noexcept { RERR_Domain_UnregisterAll(); }
 
 /// Register an error code domain.
-inline Error RegisterDomain(std::string const &domain,
+inline Error RegisterDomain(CStringRef domain,
                             RERR_CodeFormat codeFormat) noexcept {
-    return Error(RERR_Domain_Register(domain.c_str(), codeFormat));
+    return Error(RERR_Domain_Register(domain.CStr(), codeFormat));
+}
+
+/// Look up a registered error code domain, obtaining its handle.
+/**
+ * On failure, \p handle is set to null and the error is returned.
+ */
+inline Error LookupDomain(CStringRef domain,
+                          RERR_DomainHandle &handle) noexcept {
+    return Error(RERR_Domain_Lookup(domain.CStr(), &handle));
 }
 
 /// An exception that wraps Error.
@@ -0,0 +1,102 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+/** \file
+ * \brief String parameter types for the C++ interface.
+ */
+
+#ifndef __cplusplus
+#error This header is for C++ only.
+#endif
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+/// Defined when `std::string_view` overloads are available (C++17).
+#define RERR_HAVE_STRING_VIEW 1
+#endif
+
+namespace RERR {
+
+/// Non-owning reference to a string argument, with its length.
+/**
+ * Parameters of this type accept a `std::string`, a C string, a pointer with
+ * a length, or (with C++17) a `std::string_view`, without constructing a
+ * temporary `std::string`. The characters need not be null-terminated, but
+ * must not include a null character.
+ */
+class StringRef final {
+    const char *str;
+    std::size_t len;
+
+  public:
+    /// Refer to a null-terminated string.
+    StringRef(const char *s) noexcept : str{s}, len{std::strlen(s)} {}
+
+    /// Refer to \p n characters starting at \p s.
+    StringRef(const char *s, std::size_t n) noexcept : str{s}, len{n} {}
+
+    /// Refer to the contents of a string.
+    StringRef(std::string const &s) noexcept : str{s.data()}, len{s.size()} {}
+
+#ifdef RERR_HAVE_STRING_VIEW
+    /// Refer to the contents of a string view.
+    StringRef(std::string_view s) noexcept : str{s.data()}, len{s.size()} {}
+#endif
+
+    /// Return the first character.
+    const char *Data() const noexcept { return str; }
+
+    /// Return the number of characters.
+    std::size_t Size() const noexcept { return len; }
+};
+
+/// Non-owning reference to a null-terminated string argument.
+/**
+ * Used for domain names and info map keys, which the C interface requires to
+ * be null-terminated. Accepts a `std::string` or a C string without copying.
+ */
+class CStringRef final {
+    const char *str;
+
+  public:
+    /// Refer to a C string.
+    CStringRef(const char *s) noexcept : str{s} {}
+
+    /// Refer to the contents of a string.
+    CStringRef(std::string const &s) noexcept : str{s.c_str()} {}
+
+    /// Return the C string.
+    const char *CStr() const noexcept { return str; }
+};
+
+/// Reference to a message string that is not copied.
+/**
+ * Passing a message as this type to the constructors of Error, or to
+ * Domain::Create() and Domain::Wrap(), stores a pointer to the string instead
+ * of copying it (see RERR_Error_CreateStatic()). The string must remain valid
+ * for as long as any error referring to it, so this should only be used for
+ * strings with static storage duration, such as string literals:
+ *
+ * \code{.cpp}
+ * RERR::Error err(RERR::StaticMessage("Operation failed"));
+ * \endcode
+ */
+class StaticMessage final {
+    const char *str;
+
+  public:
+    /// Refer to a string with static storage duration.
+    explicit StaticMessage(const char *s) noexcept : str{s} {}
+
+    /// Return the C string.
+    const char *CStr() const noexcept { return str; }
+};
+
+} // namespace RERR
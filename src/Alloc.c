@@ -0,0 +1,56 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "Alloc.h"
+
+#include <stdlib.h>
+
+static void *DefaultAlloc(void *context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+static void *DefaultRealloc(void *context, void *ptr, size_t size) {
+    (void)context;
+    return realloc(ptr, size);
+}
+
+static void DefaultFree(void *context, void *ptr) {
+    (void)context;
+    free(ptr);
+}
+
+static const RERR_Allocator defaultAllocator = {
+    DefaultAlloc,
+    DefaultRealloc,
+    DefaultFree,
+    NULL,
+};
+
+RERR_Allocator RERR_Internal_Allocator = {
+    DefaultAlloc,
+    DefaultRealloc,
+    DefaultFree,
+    NULL,
+};
+
+RERR_ErrorPtr RERR_Allocator_Set(const RERR_Allocator *allocator) {
+    if (!allocator) {
+        RERR_Internal_Allocator = defaultAllocator;
+        return RERR_NO_ERROR;
+    }
+    if (!allocator->alloc || !allocator->realloc || !allocator->free) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_NULL_ARGUMENT,
+                                         "Null allocator function given");
+    }
+    RERR_Internal_Allocator = *allocator;
+    return RERR_NO_ERROR;
+}
+
+void RERR_Allocator_Get(RERR_Allocator *allocator) {
+    if (allocator) {
+        *allocator = RERR_Internal_Allocator;
+    }
+}
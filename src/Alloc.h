@@ -0,0 +1,59 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+// All memory allocation in RichErrors goes through these functions, which
+// forward to the allocator installed by RERR_Allocator_Set().
+
+#include "RichErrors/RichErrors.h"
+
+#include "Stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+extern RERR_Allocator RERR_Internal_Allocator;
+
+static inline void *MemAlloc(size_t size) {
+    void *ret =
+        RERR_Internal_Allocator.alloc(RERR_Internal_Allocator.context, size);
+    if (ret) {
+        Stats_Created(StatsCounter_AllocationsLive, StatsCounter_Allocations);
+        Stats_Add(StatsCounter_BytesAllocated, (long long)size);
+    }
+    return ret;
+}
+
+static inline void *MemCalloc(size_t count, size_t size) {
+    if (size > 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ret = MemAlloc(count * size);
+    if (ret) {
+        memset(ret, 0, count * size);
+    }
+    return ret;
+}
+
+static inline void *MemRealloc(void *ptr, size_t size) {
+    void *ret = RERR_Internal_Allocator.realloc(
+        RERR_Internal_Allocator.context, ptr, size);
+    if (ret) {
+        Stats_Add(StatsCounter_AllocationsLive, ptr ? 0 : 1);
+        Stats_Add(StatsCounter_Allocations, 1);
+        Stats_Add(StatsCounter_BytesAllocated, (long long)size);
+    }
+    return ret;
+}
+
+static inline void MemFree(void *ptr) {
+    if (ptr) {
+        Stats_Destroyed(StatsCounter_AllocationsLive);
+    }
+    RERR_Internal_Allocator.free(RERR_Internal_Allocator.context, ptr);
+}
+
+static inline void MemFreeConst(const void *ptr) { MemFree((void *)ptr); }
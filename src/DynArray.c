@@ -4,6 +4,8 @@
 
 #include "DynArray.h"
 
+#include "Alloc.h"
+
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -67,7 +69,7 @@ static inline size_t IdealCapacity(RERR_DynArrayPtr arr, size_t size) {
 // Precondition: newCap >= arr->size
 static inline bool SetCapacity(RERR_DynArrayPtr arr, size_t newCap) {
     if (newCap == 0) {
-        free(arr->elems);
+        MemFree(arr->elems);
         arr->elems = NULL;
         arr->capacity = 0;
         return true;
@@ -75,9 +77,9 @@ static inline bool SetCapacity(RERR_DynArrayPtr arr, size_t newCap) {
 
     char *newElems;
     if (!arr->elems) {
-        newElems = malloc(newCap * arr->elemSize);
+        newElems = MemAlloc(newCap * arr->elemSize);
     } else {
-        newElems = realloc(arr->elems, newCap * arr->elemSize);
+        newElems = MemRealloc(arr->elems, newCap * arr->elemSize);
     }
     if (!newElems) {
         return false;
@@ -153,7 +155,7 @@ RERR_DynArrayPtr RERR_DynArray_Create(size_t elemSize) {
         return NULL;
     }
 
-    RERR_DynArrayPtr ret = calloc(1, sizeof(struct RERR_DynArray));
+    RERR_DynArrayPtr ret = MemCalloc(1, sizeof(struct RERR_DynArray));
     if (!ret) {
         return NULL;
     }
@@ -175,10 +177,10 @@ RERR_DynArrayPtr RERR_DynArray_Create(size_t elemSize) {
 
 void RERR_DynArray_Destroy(RERR_DynArrayPtr arr) {
     arr->size = 0;
-    free(arr->elems);
+    MemFree(arr->elems);
     arr->elems = NULL;
     arr->capacity = 0;
-    free(arr);
+    MemFree(arr);
 }
 
 void RERR_DynArray_ReserveCapacity(RERR_DynArrayPtr arr, size_t capacity) {
@@ -4,23 +4,90 @@
 
 #include "RichErrors/Err2Code.h"
 
-#include "DynArray.h"
+#include "Alloc.h"
+#include "Stats.h"
 #include "Threads.h"
 
+#include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 // Although our map is functionally per-thread, we do not use a thread-local
 // map. This is because cleanup is very difficult without C++, and even in C++
 // it is difficult to avoid leaking errors registered on threads that survive
-// the error map instance. Since this is about error handling, we do not mind
-// the overhead of a straightforward mutex.
+// the error map instance. Instead, the map is divided into shards by a hash of
+// the entry owner, each with its own mutex, so that threads rarely contend.
+// Since all entries for a given thread are in the same shard, per-thread
+// operations only ever lock one shard.
+//
+// By default, the owner of an entry is the registering thread's id, and the
+// entries of threads that exit are leaked until the map is destroyed. With a
+// thread-exit policy, each registering thread instead gets a ThreadRecord,
+// stored in a thread-local storage key whose destructor releases the
+// thread's entries (or marks them for RERR_ErrorMap_ReapDeadThreads()), and
+// the record's address serves as the owner. Unlike thread ids, records are
+// not reused while entries refer to them, so a new thread can never see the
+// entries of an exited thread that had the same id.
+//
+// A single-threaded map uses only the first shard, without locking it and
+// with a constant owner, so that the calling thread is never looked up
+// (except to check affinity in debug builds).
+
+// Within a shard, each registered error occupies a slot in a table indexed by
+// the code's offset from minCode modulo the (power-of-2) table size, so that
+// lookup is a direct index. Codes are assigned in rotation through the whole
+// range, as by a cursor that skips offsets whose slot is occupied, so that a
+// stale code only aliases a newer registration after the shard has cycled
+// through the range. The table is kept at most half full (so that the cursor
+// rarely skips) until it covers the whole range; since growing keeps occupied
+// slots distinct, every code in the range can then be used.
+//
+// Codes only need to be unique per thread, so shards assign codes
+// independently, and all threads hashed to a shard share its range.
+//
+// With the oldest-first eviction policy, each shard also keeps its registered
+// slots in a doubly linked list in registration order. The entry limit is
+// map-wide, so it is counted with an atomic counter, which is only touched
+// if a limit is set.
+
+// Thread id, or address of a ThreadRecord; never 0 for a registered entry.
+typedef uintptr_t Owner;
+
+#define NO_SLOT UINT32_MAX
+
+struct Slot {
+    Owner owner;
+    RERR_ErrorPtr error; // Null if free
+    uint32_t offset;     // Code offset from minCode
+    uint32_t older; // Registration order (only with eviction); or NO_SLOT
+    uint32_t newer;
+};
+
+struct ThreadRecord {
+    RERR_ErrorMapPtr map;
+    struct ThreadRecord *next; // In the shard's list of threads
+    bool exited;               // Awaiting RERR_ErrorMap_ReapDeadThreads()
+};
 
-struct MappedError {
-    ThreadID thread;
-    int32_t code;
-    RERR_ErrorPtr error;
+#define SHARD_BITS 4
+#define SHARD_COUNT (1 << SHARD_BITS)
+
+#define INITIAL_SLOT_COUNT 16
+#define MAX_SLOT_COUNT (UINT32_C(1) << 31)
+
+struct Shard {
+    Mutex mutex;
+    struct Slot *slots;
+    uint32_t slotCount; // Allocated slots; 0 or a power of 2
+    uint32_t usedCount; // Registered slots
+    uint32_t cursor;    // Offset of the next code to try
+    uint32_t oldest; // Registration order (only with eviction); or NO_SLOT
+    uint32_t newest;
+    struct ThreadRecord *threads; // Records hashed to this shard
+    bool hasExited;               // Some of the threads have exited
+    char padding[64];             // Avoid false sharing between shards
 };
 
 struct RERR_ErrorMap {
@@ -29,70 +96,287 @@ struct RERR_ErrorMap {
     int32_t noErrorCode; // const
     int32_t oomCode;     // const
     int32_t failCode;    // const
-
-    Mutex mutex;
-    int32_t nextCode;
-    RERR_DynArrayPtr mappings; // Always sorted (MappedError_Compare)
+    uint32_t rangeSize;  // const; number of mapped codes
+    uint32_t maxSlots;   // const; power of 2 covering range (if possible)
+    uint32_t maxUsed;    // const; min(rangeSize, maxSlots)
+
+    int threadExitPolicy;     // const
+    int evictionPolicy;       // const
+    uint32_t maxEntries;      // const; 0 for no limit
+    ThreadLocalKey threadKey; // const; unless RERR_ErrorMapThreadExit_Keep
+    AtomicCounter entryCount; // Only maintained if maxEntries != 0
+    bool singleThreaded;      // const
+#ifndef NDEBUG
+    ThreadID affineThread; // Single-threaded only: first thread to use map
+    bool hasAffineThread;
+#endif
+
+    struct Shard shards[SHARD_COUNT];
 };
 
-static int MappedError_Compare(const void *l, const void *r) {
-    const struct MappedError *lhs = l;
-    const struct MappedError *rhs = r;
+// Owner of all entries of a single-threaded map.
+#define SINGLE_THREAD_OWNER ((Owner)1)
 
-    if (lhs->thread < rhs->thread) {
-        return -1;
+// Fibonacci hashing; thread ids are often aligned addresses.
+static inline struct Shard *ErrorMap_GetShard(RERR_ErrorMapPtr map,
+                                              Owner owner) {
+    uint64_t h = (uint64_t)owner * UINT64_C(0x9E3779B97F4A7C15);
+    return &map->shards[h >> (64 - SHARD_BITS)];
+}
+
+// Create and install the calling thread's record. Returns null on failure.
+static struct ThreadRecord *ErrorMap_AddThread(RERR_ErrorMapPtr map) {
+    struct ThreadRecord *record = MemAlloc(sizeof(struct ThreadRecord));
+    if (!record) {
+        return NULL;
     }
-    if (lhs->thread > rhs->thread) {
-        return 1;
+    record->map = map;
+    record->exited = false;
+    if (!SetThreadLocal(map->threadKey, record)) {
+        MemFree(record);
+        return NULL;
     }
-    if (lhs->code < rhs->code) {
-        return -1;
+
+    struct Shard *shard = ErrorMap_GetShard(map, (Owner)record);
+    LockMutex(&shard->mutex);
+    record->next = shard->threads;
+    shard->threads = record;
+    UnlockMutex(&shard->mutex);
+    return record;
+}
+
+// Return the owner for entries registered by the calling thread. If the
+// thread has no record yet, one is created if create is true; otherwise (or
+// if creation fails), 0 is returned, which owns no entries.
+static inline Owner ErrorMap_GetOwner(RERR_ErrorMapPtr map, bool create) {
+    if (map->threadExitPolicy == RERR_ErrorMapThreadExit_Keep) {
+        return (Owner)GetThisThreadId();
+    }
+    struct ThreadRecord *record = GetThreadLocal(map->threadKey);
+    if (!record && create) {
+        record = ErrorMap_AddThread(map);
     }
-    if (lhs->code > rhs->code) {
-        return 1;
+    return (Owner)record;
+}
+
+static inline void ErrorMap_CheckAffinity(RERR_ErrorMapPtr map) {
+#ifndef NDEBUG
+    if (!map->hasAffineThread) {
+        map->affineThread = GetThisThreadId();
+        map->hasAffineThread = true;
     }
-    return 0;
+    assert(map->affineThread == GetThisThreadId() &&
+           "Single-threaded error map used from multiple threads");
+#else
+    (void)map;
+#endif
 }
 
-// Returns pointer to item in mapping, or NULL if not found. Mutex must be
-// held.
-static struct MappedError *ErrorMap_Find(RERR_ErrorMapPtr map, ThreadID thread,
-                                         int32_t code) {
-    struct MappedError key;
-    key.thread = thread;
-    key.code = code;
-    key.error = NULL;
+// Return the calling thread's shard, locked, and set owner for the thread's
+// entries. See ErrorMap_GetOwner() regarding create.
+static inline struct Shard *ErrorMap_LockShard(RERR_ErrorMapPtr map,
+                                               bool create, Owner *owner) {
+    if (map->singleThreaded) {
+        ErrorMap_CheckAffinity(map);
+        *owner = SINGLE_THREAD_OWNER;
+        return &map->shards[0];
+    }
+    *owner = ErrorMap_GetOwner(map, create);
+    struct Shard *shard = ErrorMap_GetShard(map, *owner);
+    LockMutex(&shard->mutex);
+    return shard;
+}
 
-    return RERR_DynArray_BSearch(map->mappings, &key, MappedError_Compare);
+static inline void ErrorMap_UnlockShard(RERR_ErrorMapPtr map,
+                                        struct Shard *shard) {
+    if (!map->singleThreaded) {
+        UnlockMutex(&shard->mutex);
+    }
 }
 
-// Inserts item, taking ownership of error on success. Mutex must be held.
-static RERR_ErrorPtr ErrorMap_Insert(RERR_ErrorMapPtr map, ThreadID thread,
-                                     int32_t code, RERR_ErrorPtr error) {
-    struct MappedError key;
-    key.thread = thread;
-    key.code = code;
-    key.error = NULL;
+static inline int32_t ErrorMap_EncodeCode(RERR_ErrorMapPtr map,
+                                          uint32_t offset) {
+    return (int32_t)((uint32_t)map->minCode + offset);
+}
 
-    struct MappedError *p = RERR_DynArray_BSearchInsertionPoint(
-        map->mappings, &key, MappedError_Compare);
-    p = RERR_DynArray_Insert(map->mappings, p);
-    if (!p) {
-        return RERR_Error_CreateOutOfMemory();
+// Returns the slot registered to owner with code, or NULL. Shard mutex must
+// be held.
+static struct Slot *Shard_Find(RERR_ErrorMapPtr map, struct Shard *shard,
+                               Owner owner, int32_t code) {
+    uint32_t offset = (uint32_t)code - (uint32_t)map->minCode;
+    if (offset >= map->rangeSize || shard->slotCount == 0) {
+        return NULL;
     }
-    p->thread = thread;
-    p->code = code;
-    p->error = error;
-    return RERR_NO_ERROR;
+    struct Slot *slot = &shard->slots[offset & (shard->slotCount - 1)];
+    if (!slot->error || slot->offset != offset || slot->owner != owner) {
+        return NULL;
+    }
+    return slot;
 }
 
-// Precondition: code is valid w.r.t. minCode and maxCode
-static inline int32_t IncrementCode(int32_t code, int32_t minCode,
-                                    int32_t maxCode) {
-    if (code == maxCode) {
-        return minCode;
+// Double the slot table (or allocate it), moving the registered slots to
+// their new positions. Returns false on allocation failure. Shard mutex must
+// be held.
+// Precondition: shard->slotCount < map->maxSlots
+static bool Shard_Grow(RERR_ErrorMapPtr map, struct Shard *shard) {
+    uint32_t newCount = shard->slotCount ? shard->slotCount * 2
+                                         : INITIAL_SLOT_COUNT;
+    if (newCount > map->maxSlots) {
+        newCount = map->maxSlots;
+    }
+#if SIZE_MAX <= UINT32_MAX
+    if (newCount > SIZE_MAX / sizeof(struct Slot)) {
+        return false;
+    }
+#endif
+
+    struct Slot *slots = MemAlloc(newCount * sizeof(struct Slot));
+    if (!slots) {
+        return false;
+    }
+    for (uint32_t i = 0; i < newCount; ++i) {
+        slots[i].error = NULL;
     }
-    return code == INT32_MAX ? INT32_MIN : code + 1;
+
+    // Occupied offsets stay distinct under the wider mask.
+    struct Slot *old = shard->slots;
+    uint32_t mask = newCount - 1;
+    for (uint32_t i = 0; i < shard->slotCount; ++i) {
+        if (old[i].error) {
+            slots[old[i].offset & mask] = old[i];
+        }
+    }
+    if (map->evictionPolicy == RERR_ErrorMapEviction_Oldest) {
+        uint32_t prev = NO_SLOT;
+        for (uint32_t i = shard->oldest; i != NO_SLOT; i = old[i].newer) {
+            uint32_t j = old[i].offset & mask;
+            slots[j].older = prev;
+            if (prev == NO_SLOT) {
+                shard->oldest = j;
+            } else {
+                slots[prev].newer = j;
+            }
+            prev = j;
+        }
+        if (prev != NO_SLOT) {
+            slots[prev].newer = NO_SLOT;
+        }
+        shard->newest = prev;
+    }
+
+    MemFree(old);
+    shard->slots = slots;
+    shard->slotCount = newCount;
+    return true;
+}
+
+// Append a slot to the registration order. Shard mutex must be held.
+static inline void Shard_LinkNewest(struct Shard *shard, uint32_t index) {
+    struct Slot *slot = &shard->slots[index];
+    slot->older = shard->newest;
+    slot->newer = NO_SLOT;
+    if (shard->newest == NO_SLOT) {
+        shard->oldest = index;
+    } else {
+        shard->slots[shard->newest].newer = index;
+    }
+    shard->newest = index;
+}
+
+// Remove a slot from the registration order. Shard mutex must be held.
+static inline void Shard_Unlink(struct Shard *shard, struct Slot *slot) {
+    if (slot->older == NO_SLOT) {
+        shard->oldest = slot->newer;
+    } else {
+        shard->slots[slot->older].newer = slot->newer;
+    }
+    if (slot->newer == NO_SLOT) {
+        shard->newest = slot->older;
+    } else {
+        shard->slots[slot->newer].older = slot->older;
+    }
+}
+
+// Release a slot. Shard mutex must be held.
+static inline void Shard_FreeSlot(RERR_ErrorMapPtr map, struct Shard *shard,
+                                  struct Slot *slot) {
+    Stats_Destroyed(StatsCounter_ErrorMapEntriesLive);
+    if (map->evictionPolicy == RERR_ErrorMapEviction_Oldest) {
+        Shard_Unlink(shard, slot);
+    }
+    if (map->maxEntries) {
+        AtomicCounterAdd(&map->entryCount, -1);
+    }
+    slot->error = NULL;
+    --shard->usedCount;
+}
+
+// Destroy the entries of owner. Shard mutex must be held.
+static void Shard_Clear(RERR_ErrorMapPtr map, struct Shard *shard,
+                        Owner owner) {
+    for (uint32_t i = 0; i < shard->slotCount; ++i) {
+        struct Slot *slot = &shard->slots[i];
+        if (slot->error && slot->owner == owner) {
+            RERR_Error_Destroy(slot->error);
+            Shard_FreeSlot(map, shard, slot);
+        }
+    }
+}
+
+// Destroy the oldest entry of the shard, if the eviction policy allows.
+// Returns false if nothing was evicted. Shard mutex must be held.
+static bool Shard_EvictOldest(RERR_ErrorMapPtr map, struct Shard *shard) {
+    if (map->evictionPolicy != RERR_ErrorMapEviction_Oldest ||
+        shard->oldest == NO_SLOT) {
+        return false;
+    }
+    struct Slot *slot = &shard->slots[shard->oldest];
+    RERR_Error_Destroy(slot->error);
+    Shard_FreeSlot(map, shard, slot);
+    return true;
+}
+
+// Count a new entry against the map's limit, evicting if necessary. Returns
+// false if the map is full. Shard mutex must be held.
+static inline bool Shard_Reserve(RERR_ErrorMapPtr map, struct Shard *shard) {
+    if (!map->maxEntries) {
+        return true;
+    }
+    if (AtomicCounterFetchAdd(&map->entryCount, 1) < map->maxEntries ||
+        Shard_EvictOldest(map, shard)) {
+        return true;
+    }
+    AtomicCounterAdd(&map->entryCount, -1);
+    return false;
+}
+
+// Undo Shard_Reserve().
+static inline void ErrorMap_Unreserve(RERR_ErrorMapPtr map) {
+    if (map->maxEntries) {
+        AtomicCounterAdd(&map->entryCount, -1);
+    }
+}
+
+// Thread-exit hook for threads with a record.
+static void THREAD_LOCAL_DESTRUCTOR_CALL ErrorMap_ThreadExit(void *value) {
+    struct ThreadRecord *record = value;
+    RERR_ErrorMapPtr map = record->map;
+    struct Shard *shard = ErrorMap_GetShard(map, (Owner)record);
+
+    LockMutex(&shard->mutex);
+    if (map->threadExitPolicy == RERR_ErrorMapThreadExit_Defer) {
+        record->exited = true;
+        shard->hasExited = true;
+    } else {
+        Shard_Clear(map, shard, (Owner)record);
+        struct ThreadRecord **link = &shard->threads;
+        while (*link != record) {
+            link = &(*link)->next;
+        }
+        *link = record->next;
+        MemFree(record);
+    }
+    UnlockMutex(&shard->mutex);
 }
 
 static inline bool CodeIsInRange(int32_t code, int32_t minCode,
@@ -143,8 +427,43 @@ static inline RERR_ErrorPtr CheckConfig(const RERR_ErrorMapConfig *config) {
     return RERR_NO_ERROR;
 }
 
+static inline RERR_ErrorPtr
+CheckOptions(const RERR_ErrorMapOptions *options) {
+    if (options->threadExitPolicy < RERR_ErrorMapThreadExit_Keep ||
+        options->threadExitPolicy > RERR_ErrorMapThreadExit_Defer) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_MAP_INVALID_CONFIG,
+                                         "Unknown thread-exit policy");
+    }
+    if (options->evictionPolicy < RERR_ErrorMapEviction_None ||
+        options->evictionPolicy > RERR_ErrorMapEviction_Oldest) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_MAP_INVALID_CONFIG,
+                                         "Unknown eviction policy");
+    }
+    if (options->flags & ~(unsigned)RERR_ErrorMapFlag_SingleThreaded) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_MAP_INVALID_CONFIG,
+                                         "Unknown error map flags");
+    }
+    if ((options->flags & RERR_ErrorMapFlag_SingleThreaded) &&
+        options->threadExitPolicy != RERR_ErrorMapThreadExit_Keep) {
+        return RERR_Error_CreateWithCode(
+            RERR_DOMAIN_RICHERRORS, RERR_ECODE_MAP_INVALID_CONFIG,
+            "Single-threaded error map cannot have a thread-exit policy");
+    }
+    return RERR_NO_ERROR;
+}
+
 RERR_ErrorPtr RERR_ErrorMap_Create(RERR_ErrorMapPtr *map,
                                    const RERR_ErrorMapConfig *config) {
+    return RERR_ErrorMap_CreateWithOptions(map, config, NULL);
+}
+
+RERR_ErrorPtr
+RERR_ErrorMap_CreateWithOptions(RERR_ErrorMapPtr *map,
+                                const RERR_ErrorMapConfig *config,
+                                const RERR_ErrorMapOptions *options) {
     if (!map) {
         return RERR_Error_CreateWithCode(
             RERR_DOMAIN_RICHERRORS, RERR_ECODE_NULL_ARGUMENT,
@@ -156,16 +475,17 @@ RERR_ErrorPtr RERR_ErrorMap_Create(RERR_ErrorMapPtr *map,
     if (err != RERR_NO_ERROR) {
         return err;
     }
-
-    RERR_DynArrayPtr mappings =
-        RERR_DynArray_Create(sizeof(struct MappedError));
-    if (!mappings) {
-        return RERR_Error_CreateOutOfMemory();
+    static const RERR_ErrorMapOptions defaultOptions = {0};
+    if (!options) {
+        options = &defaultOptions;
+    }
+    err = CheckOptions(options);
+    if (err != RERR_NO_ERROR) {
+        return err;
     }
 
-    *map = calloc(1, sizeof(struct RERR_ErrorMap));
+    *map = MemCalloc(1, sizeof(struct RERR_ErrorMap));
     if (!*map) {
-        RERR_DynArray_Destroy(mappings);
         return RERR_Error_CreateOutOfMemory();
     }
 
@@ -175,10 +495,35 @@ RERR_ErrorPtr RERR_ErrorMap_Create(RERR_ErrorMapPtr *map,
     (*map)->oomCode = config->outOfMemoryCode;
     (*map)->failCode = config->mapFailureCode;
 
-    InitRecursiveMutex(&(*map)->mutex);
-    (*map)->nextCode = (*map)->minCode;
+    (*map)->rangeSize =
+        (uint32_t)config->maxMappedCode - (uint32_t)config->minMappedCode + 1;
+    uint32_t maxSlots = 1;
+    while (maxSlots < (*map)->rangeSize && maxSlots < MAX_SLOT_COUNT) {
+        maxSlots *= 2;
+    }
+    (*map)->maxSlots = maxSlots;
+    (*map)->maxUsed =
+        (*map)->rangeSize < maxSlots ? (*map)->rangeSize : maxSlots;
+
+    (*map)->threadExitPolicy = options->threadExitPolicy;
+    (*map)->evictionPolicy = options->evictionPolicy;
+    (*map)->maxEntries = options->maxEntries;
+    (*map)->singleThreaded =
+        (options->flags & RERR_ErrorMapFlag_SingleThreaded) != 0;
+    if (options->threadExitPolicy != RERR_ErrorMapThreadExit_Keep &&
+        !CreateThreadLocalKey(&(*map)->threadKey, ErrorMap_ThreadExit)) {
+        MemFree(*map);
+        *map = NULL;
+        return RERR_Error_CreateWithCode(
+            RERR_DOMAIN_RICHERRORS, RERR_ECODE_MAP_FAILURE,
+            "Failed to create thread-local storage key for error map");
+    }
 
-    (*map)->mappings = mappings;
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        InitMutex(&(*map)->shards[i].mutex);
+        (*map)->shards[i].oldest = NO_SLOT;
+        (*map)->shards[i].newest = NO_SLOT;
+    }
 
     return RERR_NO_ERROR;
 }
@@ -188,16 +533,109 @@ void RERR_ErrorMap_Destroy(RERR_ErrorMapPtr map) {
         return;
     }
 
-    struct MappedError *begin = RERR_DynArray_Begin(map->mappings);
-    struct MappedError *end = RERR_DynArray_End(map->mappings);
-    for (struct MappedError *it = begin; it != end;
-         it = RERR_DynArray_Advance(map->mappings, it)) {
-        RERR_Error_Destroy(it->error);
+    // Delete the key first: on Windows, this may run the thread-exit hook.
+    if (map->threadExitPolicy != RERR_ErrorMapThreadExit_Keep) {
+        DeleteThreadLocalKey(map->threadKey);
+    }
+
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        struct Shard *shard = &map->shards[i];
+        for (uint32_t j = 0; j < shard->slotCount; ++j) {
+            if (shard->slots[j].error) {
+                RERR_Error_Destroy(shard->slots[j].error);
+                Stats_Destroyed(StatsCounter_ErrorMapEntriesLive);
+            }
+        }
+        while (shard->threads) {
+            struct ThreadRecord *next = shard->threads->next;
+            MemFree(shard->threads);
+            shard->threads = next;
+        }
+        MemFree(shard->slots);
+        DestroyMutex(&shard->mutex);
+    }
+
+    MemFree(map);
+}
+
+// Shard mutex must be held. Takes ownership of error.
+// Owner 0 indicates failure to create the thread's record.
+static int32_t Shard_Register(RERR_ErrorMapPtr map, struct Shard *shard,
+                              Owner owner, RERR_ErrorPtr error) {
+    if (error == RERR_NO_ERROR) {
+        return map->noErrorCode;
+    }
+    if (RERR_Error_IsOutOfMemory(error)) {
+        return map->oomCode;
+    }
+    if (!owner) {
+        RERR_Error_Destroy(error);
+        return map->oomCode;
     }
 
-    RERR_DynArray_Destroy(map->mappings);
+    if (!Shard_Reserve(map, shard)) {
+        RERR_Error_Destroy(error);
+        return map->failCode;
+    }
+    if (shard->usedCount >= shard->slotCount / 2 &&
+        shard->slotCount < map->maxSlots && !Shard_Grow(map, shard)) {
+        ErrorMap_Unreserve(map);
+        RERR_Error_Destroy(error);
+        return map->oomCode;
+    }
+    if (shard->usedCount >= map->maxUsed && !Shard_EvictOldest(map, shard)) {
+        ErrorMap_Unreserve(map);
+        RERR_Error_Destroy(error);
+        return map->failCode;
+    }
 
-    free(map);
+    // Terminates: the table has a free slot that some offset maps to.
+    uint32_t mask = shard->slotCount - 1;
+    uint32_t offset;
+    uint32_t index;
+    do {
+        offset = shard->cursor;
+        shard->cursor = offset + 1 == map->rangeSize ? 0 : offset + 1;
+        index = offset & mask;
+    } while (shard->slots[index].error);
+
+    struct Slot *slot = &shard->slots[index];
+    slot->owner = owner;
+    slot->error = error;
+    slot->offset = offset;
+    ++shard->usedCount;
+    if (map->evictionPolicy == RERR_ErrorMapEviction_Oldest) {
+        Shard_LinkNewest(shard, index);
+    }
+    Stats_Created(StatsCounter_ErrorMapEntriesLive,
+                  StatsCounter_ErrorMapEntriesCreated);
+    return ErrorMap_EncodeCode(map, offset);
+}
+
+// Shard mutex must be held.
+static RERR_ErrorPtr Shard_Retrieve(RERR_ErrorMapPtr map, struct Shard *shard,
+                                    Owner owner, int32_t mappedCode) {
+    if (mappedCode == map->noErrorCode) {
+        return RERR_NO_ERROR;
+    }
+    if (mappedCode == map->oomCode) {
+        return RERR_Error_CreateOutOfMemory();
+    }
+    if (mappedCode == map->failCode) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_MAP_FAILURE,
+                                         "Failed to assign an error code");
+    }
+
+    struct Slot *found = Shard_Find(map, shard, owner, mappedCode);
+    if (!found) {
+        return RERR_Error_CreateWithCode(
+            RERR_DOMAIN_RICHERRORS, RERR_ECODE_MAP_INVALID_CODE,
+            "Unregistered error code (probably a bug in error handling)");
+    }
+    RERR_ErrorPtr ret = found->error;
+    Shard_FreeSlot(map, shard, found);
+    return ret;
 }
 
 int32_t RERR_ErrorMap_RegisterThreadLocal(RERR_ErrorMapPtr map,
@@ -215,40 +653,30 @@ int32_t RERR_ErrorMap_RegisterThreadLocal(RERR_ErrorMapPtr map,
         return map->oomCode;
     }
 
-    ThreadID thread = GetThisThreadId();
-
-    int32_t ret = map->noErrorCode;
-    LockMutex(&map->mutex);
-    {
-        int32_t firstCandidate = map->nextCode;
-        map->nextCode =
-            IncrementCode(map->nextCode, map->minCode, map->maxCode);
+    Owner owner;
+    struct Shard *shard = ErrorMap_LockShard(map, true, &owner);
+    int32_t ret = Shard_Register(map, shard, owner, error);
+    ErrorMap_UnlockShard(map, shard);
+    return ret;
+}
 
-        int32_t code = firstCandidate;
-        for (;;) {
-            struct MappedError *found = ErrorMap_Find(map, thread, code);
-            if (!found) { // Code is available
-                RERR_ErrorPtr err = ErrorMap_Insert(map, thread, code, error);
-                if (err == RERR_NO_ERROR) {
-                    ret = code;
-                    break;
-                }
-                ret = RERR_Error_IsOutOfMemory(err) ? map->oomCode
-                                                    : map->failCode;
-                RERR_Error_Destroy(error);
-                break;
-            }
+void RERR_ErrorMap_RegisterThreadLocalBatch(RERR_ErrorMapPtr map,
+                                            RERR_ErrorPtr *errors,
+                                            size_t count, int32_t *codes) {
+    if (!map) {
+        abort();
+    }
+    if (count == 0) {
+        return;
+    }
 
-            code = IncrementCode(code, map->minCode, map->maxCode);
-            if (code == firstCandidate) { // Range exhausted
-                ret = map->failCode;
-                RERR_Error_Destroy(error);
-                break;
-            }
-        }
+    Owner owner;
+    struct Shard *shard = ErrorMap_LockShard(map, true, &owner);
+    for (size_t i = 0; i < count; ++i) {
+        codes[i] = Shard_Register(map, shard, owner, errors[i]);
+        errors[i] = RERR_NO_ERROR;
     }
-    UnlockMutex(&map->mutex);
-    return ret;
+    ErrorMap_UnlockShard(map, shard);
 }
 
 bool RERR_ErrorMap_IsRegisteredThreadLocal(RERR_ErrorMapPtr map,
@@ -263,9 +691,10 @@ bool RERR_ErrorMap_IsRegisteredThreadLocal(RERR_ErrorMapPtr map,
         // Special codes are implicitly "registered"
         return true;
     }
-    LockMutex(&map->mutex);
-    struct MappedError *found = ErrorMap_Find(map, GetThisThreadId(), code);
-    UnlockMutex(&map->mutex);
+    Owner owner;
+    struct Shard *shard = ErrorMap_LockShard(map, false, &owner);
+    struct Slot *found = Shard_Find(map, shard, owner, code);
+    ErrorMap_UnlockShard(map, shard);
     return found != NULL;
 }
 
@@ -279,31 +708,36 @@ RERR_ErrorPtr RERR_ErrorMap_RetrieveThreadLocal(RERR_ErrorMapPtr map,
     if (mappedCode == map->noErrorCode) {
         return RERR_NO_ERROR;
     }
-    if (mappedCode == map->oomCode) {
-        return RERR_Error_CreateOutOfMemory();
+
+    Owner owner;
+    struct Shard *shard = ErrorMap_LockShard(map, false, &owner);
+    RERR_ErrorPtr ret = Shard_Retrieve(map, shard, owner, mappedCode);
+    ErrorMap_UnlockShard(map, shard);
+    return ret;
+}
+
+void RERR_ErrorMap_RetrieveThreadLocalBatch(RERR_ErrorMapPtr map,
+                                            const int32_t *mappedCodes,
+                                            size_t count,
+                                            RERR_ErrorPtr *errors) {
+    if (!map) {
+        for (size_t i = 0; i < count; ++i) {
+            errors[i] = RERR_Error_CreateWithCode(
+                RERR_DOMAIN_RICHERRORS, RERR_ECODE_NULL_ARGUMENT,
+                "Null error map pointer given");
+        }
+        return;
     }
-    if (mappedCode == map->failCode) {
-        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
-                                         RERR_ECODE_MAP_FAILURE,
-                                         "Failed to assign an error code");
+    if (count == 0) {
+        return;
     }
 
-    RERR_ErrorPtr ret = RERR_NO_ERROR;
-    LockMutex(&map->mutex);
-    {
-        struct MappedError *found =
-            ErrorMap_Find(map, GetThisThreadId(), mappedCode);
-        if (found) {
-            ret = found->error;
-            RERR_DynArray_Erase(map->mappings, found);
-        } else {
-            ret = RERR_Error_CreateWithCode(
-                RERR_DOMAIN_RICHERRORS, RERR_ECODE_MAP_INVALID_CODE,
-                "Unregistered error code (probably a bug in error handling)");
-        }
+    Owner owner;
+    struct Shard *shard = ErrorMap_LockShard(map, false, &owner);
+    for (size_t i = 0; i < count; ++i) {
+        errors[i] = Shard_Retrieve(map, shard, owner, mappedCodes[i]);
     }
-    UnlockMutex(&map->mutex);
-    return ret;
+    ErrorMap_UnlockShard(map, shard);
 }
 
 void RERR_ErrorMap_ClearThreadLocal(RERR_ErrorMapPtr map) {
@@ -311,20 +745,44 @@ void RERR_ErrorMap_ClearThreadLocal(RERR_ErrorMapPtr map) {
         return;
     }
 
-    ThreadID thisThread = GetThisThreadId();
+    Owner owner;
+    struct Shard *shard = ErrorMap_LockShard(map, false, &owner);
+    if (owner) {
+        Shard_Clear(map, shard, owner);
+    }
+    ErrorMap_UnlockShard(map, shard);
+}
 
-    LockMutex(&map->mutex);
-    {
-        struct MappedError *begin = RERR_DynArray_Begin(map->mappings);
-        for (struct MappedError *it = begin;
-             it != RERR_DynArray_End(map->mappings);) {
-            if (it->thread == thisThread) {
-                RERR_Error_Destroy(it->error);
-                it = RERR_DynArray_Erase(map->mappings, it);
-            } else {
-                it = RERR_DynArray_Advance(map->mappings, it);
+void RERR_ErrorMap_ReapDeadThreads(RERR_ErrorMapPtr map) {
+    if (!map || map->threadExitPolicy != RERR_ErrorMapThreadExit_Defer) {
+        return;
+    }
+
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        struct Shard *shard = &map->shards[i];
+        LockMutex(&shard->mutex);
+        if (shard->hasExited) {
+            // All owners in this shard are records hashed to it.
+            for (uint32_t j = 0; j < shard->slotCount; ++j) {
+                struct Slot *slot = &shard->slots[j];
+                if (slot->error &&
+                    ((struct ThreadRecord *)slot->owner)->exited) {
+                    RERR_Error_Destroy(slot->error);
+                    Shard_FreeSlot(map, shard, slot);
+                }
+            }
+            struct ThreadRecord **link = &shard->threads;
+            while (*link) {
+                struct ThreadRecord *record = *link;
+                if (record->exited) {
+                    *link = record->next;
+                    MemFree(record);
+                } else {
+                    link = &record->next;
+                }
             }
+            shard->hasExited = false;
         }
+        UnlockMutex(&shard->mutex);
     }
-    UnlockMutex(&map->mutex);
 }
@@ -0,0 +1,25 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+// Internal error construction, for building errors from decoded parts (see
+// Serialize.c) without going through public API that copies or looks up.
+
+#include "RichErrors/RichErrors.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Create an error, taking ownership of info (which may be null). The info is
+// made immutable and attached if non-empty and domain is not null; otherwise
+// it is destroyed. If copyMessage is false, message must outlive the error
+// (and messageLen is ignored).
+RERR_ErrorPtr Error_CreateFromParts(RERR_DomainHandle domain, int32_t code,
+                                    const char *message, size_t messageLen,
+                                    bool copyMessage, RERR_InfoMapPtr info);
+
+// Set the cause, taking ownership of it.
+// Precondition: error is not a sentinel and has no cause
+void Error_SetCause(RERR_ErrorPtr error, RERR_ErrorPtr cause);
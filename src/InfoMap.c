@@ -5,10 +5,14 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "RichErrors/InfoMap.h"
 
-#include "DynArray.h"
+#include "Alloc.h"
+#include "Pool.h"
+#include "Stats.h"
+#include "Threads.h"
 
 #include <assert.h>
 #include <math.h> // for nan()
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef _MSC_VER
@@ -29,18 +33,50 @@
  * the convenience of always having sorted keys when debugging (both of this
  * implementation and of code using this implementation).
  *
- * An alternative possibility would be to use separate arrays for the keys and
- * values (and possibly for the value type and actual value). In this case it
- * would be preferable to allocate a single block containing all of the arrays,
- * to minimize the number of allocations and reallocations. However, in the
- * absence of comparative benchmarking, I am choosing the simpler
- * implementation.
+ * To minimize the number of allocations, the item array and the bytes of all
+ * keys and string values are stored in a single block (the arena): the item
+ * array (with room for itemCapacity items) comes first, followed by the string
+ * area (strCapacity bytes). Strings are appended to the string area and never
+ * moved in place; the bytes of removed or overwritten strings become garbage
+ * until the next relocation. When an item or string does not fit, a new block
+ * is allocated (with geometrically increasing capacity), the items are copied,
+ * and only the live strings are packed into the new string area, fixing up the
+ * pointers in the items. Copying a map is a copy of the block followed by
+ * pointer fixup. Keys set via the StaticKey functions are not copied at all;
+ * such items point to the caller's string and are skipped by the fixup.
+ *
+ * Byte string and array values (blobs) are also stored in the string area,
+ * as a 64-bit byte size followed by the payload, aligned to BLOB_ALIGN (the
+ * string area itself starts at such an alignment, so relative offsets
+ * preserve it). Because the padding depends on position, the accounting in
+ * strLive uses the worst case (BlobBytes()).
+ *
+ * Maps with many items (typically diagnostic dumps with hundreds of keys)
+ * would make insertion quadratic, so once the item capacity reaches
+ * HASH_MIN_ITEM_CAPACITY an open-addressing (linear probing) hash index is
+ * placed in the arena between the item array and the string area. In this
+ * mode, new items are appended and removed items are replaced by the last
+ * item, so the item array may become unsorted (FLAG_UNSORTED). Sorting is
+ * deferred until the items are iterated (or the map is made immutable, so
+ * that shared maps are never modified by readers).
+ *
+ * An overlay map (RERR_InfoMap_CreateOverlay()) holds a reference to an
+ * immutable base map and stores only its own items (the deltas) as above.
+ * Keys removed from the base are recorded as tombstones (items of type
+ * RERR_InfoValueTypeInvalid). Lookups search the layers from the top. For
+ * iteration, a mutable overlay is flattened into an ordinary map in place;
+ * an immutable one (which may be shared) instead builds a flattened copy once
+ * and publishes it atomically. Layers are limited to OVERLAY_MAX_DEPTH, so
+ * that lookups stay cheap; an overlay on a base at the limit is placed on the
+ * base's flattened copy instead.
  */
 
 struct Value {
     RERR_InfoValueType type;
+    bool staticKey; // Item key is not owned (stored here to use padding)
     union {
-        const char *string; // Uniquely owned
+        const char *string; // Points into owning map's string area
+        const uint64_t *blob; // Size, then payload, in owning map's area
         bool boolean;
         int64_t i64;
         uint64_t u64;
@@ -49,7 +85,7 @@ struct Value {
 };
 
 struct RERR_InfoMapItem {
-    const char *key; // Uniquely owned
+    const char *key; // Points into owning map's string area unless static
     struct Value value;
 };
 
@@ -60,14 +96,27 @@ enum {
         4, // only this flag may change once immutable
     FLAG_ERROR_NULL_KEY_GIVEN = 8,
     FLAG_ERROR_NULL_VALUE_GIVEN = 16,
+    FLAG_UNSORTED = 32, // Items not sorted (only when hash-indexed)
 };
 
 struct RERR_InfoMap {
-    uint32_t flags;         // See enum constants above
-    RERR_DynArrayPtr items; // Sorted by key strcmp
-    size_t refCount;        // Always 1 unless frozen
+    uint32_t flags;          // See enum constants above
+    uint32_t depth;          // Number of base layers below this map
+    AtomicRefCount refCount; // Always 1 unless frozen
+    struct RERR_InfoMapItem *items; // Arena; sorted by key strcmp; owned
+    size_t count;
+    size_t itemCapacity;
+    size_t strUsed;     // Bytes used in string area, including garbage
+    size_t strLive;     // Bytes used by current keys and strings
+    size_t strCapacity; // Size of string area
+    RERR_InfoMapPtr base; // Immutable base map of overlay; owned reference
+    size_t size;          // Number of visible items (if base != NULL)
+    AtomicPtr flat;       // Flattened copy of immutable overlay, or null
 };
 
+_Static_assert(sizeof(struct RERR_InfoMap) <= POOL_INFOMAP_BLOCK_SIZE,
+               "Info map does not fit in pool block");
+
 #define INFOMAP_OUT_OF_MEMORY ((RERR_InfoMapPtr)-1)
 
 /*
@@ -78,192 +127,696 @@ struct RERR_InfoMap {
  * ordinary info map, except that it always behaves as if empty upon readout.
  *
  * (2) If allocation failure occurs when adding an item to an existing map, we
- * set FLAG_OUT_OF_MEMORY and deallocate all memory used for item storage. In
+ * set FLAG_OUT_OF_MEMORY and deallocate the arena. In
  * this case, the map again stores nothing and always behaves as if empty upon
  * readout, but the other flags and refCount remain valid.
  */
 
-static inline void FreeConst(const void *m) { free((void *)m); }
+#define MIN_ITEM_CAPACITY 4
+#define MIN_STR_CAPACITY 64
+#define HASH_MIN_ITEM_CAPACITY 32
+#define OVERLAY_MAX_DEPTH 8
 
-// Precondition: it != NULL
-static inline void ClearItem(RERR_InfoMapIterator it) {
-    FreeConst(it->key);
+struct HashEntry {
+    uint32_t hash;
+    uint32_t index; // 1-based index into items; 0 if empty
+};
 
-    switch (it->value.type) {
-    case RERR_InfoValueTypeString:
-        FreeConst(it->value.value.string);
-        break;
-    default:
-        break;
+// Number of hash index entries (a power of 2, at least twice the item
+// capacity), or 0 if the map is not hash-indexed.
+static inline size_t HashCapacity(size_t itemCapacity) {
+    if (itemCapacity < HASH_MIN_ITEM_CAPACITY) {
+        return 0;
+    }
+    size_t ret = 2 * HASH_MIN_ITEM_CAPACITY;
+    while (ret < 2 * itemCapacity) {
+        ret *= 2;
     }
+    return ret;
 }
 
-// Precondition: src != NULL
-// Precondition: dst != NULL
-// Precondition: src != dst
-static bool DeepCopyItem(struct RERR_InfoMapItem *restrict dst,
-                         struct RERR_InfoMapItem *restrict src) {
-    char *keyCopy = NULL;
-    char *strCopy = NULL;
+static inline struct HashEntry *HashIndex(struct RERR_InfoMapItem *items,
+                                          size_t itemCapacity) {
+    return (struct HashEntry *)(items + itemCapacity);
+}
+
+static inline char *StringArea(struct RERR_InfoMapItem *items,
+                               size_t itemCapacity) {
+    return (char *)(HashIndex(items, itemCapacity) +
+                    HashCapacity(itemCapacity));
+}
 
-    size_t keyLen = strlen(src->key);
-    keyCopy = malloc(keyLen + 1);
-    if (!keyCopy) {
-        goto error;
+static inline bool IsHashed(RERR_InfoMapPtr map) {
+    return map->itemCapacity >= HASH_MIN_ITEM_CAPACITY;
+}
+
+// FNV-1a
+static inline uint32_t HashKey(const char *key) {
+    uint32_t h = UINT32_C(2166136261);
+    for (const unsigned char *p = (const unsigned char *)key; *p; ++p) {
+        h ^= *p;
+        h *= UINT32_C(16777619);
     }
-    strncpy(keyCopy, src->key, keyLen + 1);
-    dst->key = keyCopy;
+    return h;
+}
 
-    switch (src->value.type) {
-    case RERR_InfoValueTypeString:
-        dst->value.type = RERR_InfoValueTypeString;
-        size_t len = strlen(src->value.value.string);
-        strCopy = malloc(len + 1);
-        if (!strCopy) {
-            goto error;
+// Return the entry for key, or the empty entry where it would be inserted.
+// Precondition: IsHashed(map)
+static struct HashEntry *FindEntry(RERR_InfoMapPtr map, const char *key,
+                                   uint32_t hash) {
+    struct HashEntry *index = HashIndex(map->items, map->itemCapacity);
+    size_t mask = HashCapacity(map->itemCapacity) - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (index[i].index == 0) {
+            return &index[i];
         }
-        strncpy(strCopy, src->value.value.string, len + 1);
-        dst->value.value.string = strCopy;
-        break;
+        if (index[i].hash == hash) {
+            const char *k = map->items[index[i].index - 1].key;
+            if (k == key || strcmp(k, key) == 0) {
+                return &index[i];
+            }
+        }
+    }
+}
 
-    default:
-        memcpy(&dst->value, &src->value, sizeof(src->value));
-        break;
+// Return the entry pointing to the item at position i.
+// Precondition: IsHashed(map) && i < map->count
+static struct HashEntry *FindEntryForItem(RERR_InfoMapPtr map, size_t i) {
+    struct HashEntry *index = HashIndex(map->items, map->itemCapacity);
+    size_t mask = HashCapacity(map->itemCapacity) - 1;
+    uint32_t hash = HashKey(map->items[i].key);
+    for (size_t j = hash & mask;; j = (j + 1) & mask) {
+        if (index[j].index == i + 1) {
+            return &index[j];
+        }
+    }
+}
+
+// Remove an entry, shifting back any subsequent entries in its probe run.
+// Precondition: IsHashed(map)
+static void RemoveEntry(RERR_InfoMapPtr map, struct HashEntry *entry) {
+    struct HashEntry *index = HashIndex(map->items, map->itemCapacity);
+    size_t mask = HashCapacity(map->itemCapacity) - 1;
+    size_t hole = (size_t)(entry - index);
+    for (size_t j = (hole + 1) & mask; index[j].index; j = (j + 1) & mask) {
+        size_t home = index[j].hash & mask;
+        // Move entry j into the hole unless its home lies cyclically in
+        // (hole, j].
+        bool homeInRange = hole <= j ? (hole < home && home <= j)
+                                     : (hole < home || home <= j);
+        if (!homeInRange) {
+            index[hole] = index[j];
+            hole = j;
+        }
+    }
+    index[hole].index = 0;
+}
+
+// Precondition: IsHashed(map)
+static void BuildIndex(RERR_InfoMapPtr map) {
+    struct HashEntry *index = HashIndex(map->items, map->itemCapacity);
+    memset(index, 0,
+           HashCapacity(map->itemCapacity) * sizeof(struct HashEntry));
+    for (size_t i = 0; i < map->count; ++i) {
+        uint32_t hash = HashKey(map->items[i].key);
+        struct HashEntry *entry = FindEntry(map, map->items[i].key, hash);
+        entry->hash = hash;
+        entry->index = (uint32_t)(i + 1);
+    }
+}
+
+static int CompareItems(const void *lhs, const void *rhs) {
+    return strcmp(((const struct RERR_InfoMapItem *)lhs)->key,
+                  ((const struct RERR_InfoMapItem *)rhs)->key);
+}
+
+static void SortItems(RERR_InfoMapPtr map) {
+    if (!(map->flags & FLAG_UNSORTED)) {
+        return;
+    }
+    qsort(map->items, map->count, sizeof(struct RERR_InfoMapItem),
+          CompareItems);
+    if (IsHashed(map)) {
+        BuildIndex(map);
+    }
+    map->flags &= ~(uint32_t)FLAG_UNSORTED;
+}
+
+#define BLOB_ALIGN sizeof(uint64_t)
+
+static inline bool IsBlobType(RERR_InfoValueType type) {
+    return type == RERR_InfoValueTypeBytes ||
+           type == RERR_InfoValueTypeI64Array ||
+           type == RERR_InfoValueTypeF64Array;
+}
+
+// Upper bound of string area bytes taken by a blob with the given payload
+// size, including alignment padding.
+static inline size_t BlobBytes(size_t size) {
+    return BLOB_ALIGN - 1 + sizeof(uint64_t) + size;
+}
+
+static inline size_t ValueStrBytes(const struct Value *value) {
+    if (value->type == RERR_InfoValueTypeString) {
+        return strlen(value->value.string) + 1;
+    }
+    if (IsBlobType(value->type)) {
+        return BlobBytes((size_t)value->value.blob[0]);
+    }
+    return 0;
+}
+
+// A key removed from the base map of an overlay
+static inline bool IsTombstone(const struct RERR_InfoMapItem *item) {
+    return item->value.type == RERR_InfoValueTypeInvalid;
+}
+
+static inline size_t ItemStrBytes(const struct RERR_InfoMapItem *item) {
+    size_t ret = item->value.staticKey ? 0 : strlen(item->key) + 1;
+    return ret + ValueStrBytes(&item->value);
+}
+
+static inline size_t GrowCapacity(size_t capacity, size_t needed,
+                                  size_t minimum) {
+    size_t ret = capacity > minimum ? capacity : minimum;
+    while (ret < needed) {
+        ret *= 2;
+    }
+    return ret;
+}
+
+// Precondition: the string area has room for len + 1 more bytes
+static const char *AppendString(RERR_InfoMapPtr map, const char *str,
+                                size_t len) {
+    char *ret = StringArea(map->items, map->itemCapacity) + map->strUsed;
+    memcpy(ret, str, len);
+    ret[len] = '\0';
+    map->strUsed += len + 1;
+    map->strLive += len + 1;
+    return ret;
+}
+
+// Precondition: dst has room for src's string
+static const char *PackString(char *dstStrings, size_t *used,
+                              const char *src) {
+    size_t size = strlen(src) + 1;
+    char *ret = dstStrings + *used;
+    memcpy(ret, src, size);
+    *used += size;
+    return ret;
+}
+
+// Write a blob at the next aligned position; return it.
+// Precondition: dst has room for BlobBytes(size)
+static const uint64_t *PutBlob(char *dstStrings, size_t *used,
+                               const void *data, size_t size) {
+    size_t offset = (*used + BLOB_ALIGN - 1) & ~(size_t)(BLOB_ALIGN - 1);
+    uint64_t *ret = (uint64_t *)(void *)(dstStrings + offset);
+    ret[0] = size;
+    if (size > 0) {
+        memcpy(ret + 1, data, size);
+    }
+    *used = offset + sizeof(uint64_t) + size;
+    return ret;
+}
+
+// Precondition: the string area has room for BlobBytes(size)
+static const uint64_t *AppendBlob(RERR_InfoMapPtr map, const void *data,
+                                  size_t size) {
+    const uint64_t *ret = PutBlob(StringArea(map->items, map->itemCapacity),
+                                  &map->strUsed, data, size);
+    map->strLive += BlobBytes(size);
+    return ret;
+}
+
+// Move the items into a new arena with the given capacities, dropping garbage
+// strings. On success, the old arena is returned in oldItems (for the caller
+// to free once it no longer needs any strings in it). Returns false, leaving
+// the map unchanged, on allocation failure.
+// Precondition: map is not out-of-memory
+// Precondition: itemCapacity >= map->count && strCapacity >= map->strLive
+static bool Relocate(RERR_InfoMapPtr map, size_t itemCapacity,
+                     size_t strCapacity, struct RERR_InfoMapItem **oldItems) {
+    *oldItems = NULL;
+    const size_t maxItemBytes =
+        sizeof(struct RERR_InfoMapItem) + 4 * sizeof(struct HashEntry);
+    if (itemCapacity > (SIZE_MAX - strCapacity) / maxItemBytes) {
+        return false;
+    }
+    struct RERR_InfoMapItem *items =
+        MemAlloc(itemCapacity * sizeof(struct RERR_InfoMapItem) +
+                 HashCapacity(itemCapacity) * sizeof(struct HashEntry) +
+                 strCapacity);
+    if (!items) {
+        return false;
+    }
+
+    char *strings = StringArea(items, itemCapacity);
+    size_t used = 0;
+    size_t live = 0;
+    for (size_t i = 0; i < map->count; ++i) {
+        items[i] = map->items[i];
+        if (!items[i].value.staticKey) {
+            items[i].key = PackString(strings, &used, map->items[i].key);
+        }
+        if (items[i].value.type == RERR_InfoValueTypeString) {
+            items[i].value.value.string =
+                PackString(strings, &used, map->items[i].value.value.string);
+        } else if (IsBlobType(items[i].value.type)) {
+            const uint64_t *blob = map->items[i].value.value.blob;
+            items[i].value.value.blob =
+                PutBlob(strings, &used, blob + 1, (size_t)blob[0]);
+        }
+        live += ItemStrBytes(&items[i]);
     }
 
+    *oldItems = map->items;
+    map->items = items;
+    map->itemCapacity = itemCapacity;
+    map->strUsed = used;
+    map->strLive = live; // May exceed used (see BlobBytes())
+    map->strCapacity = strCapacity;
+    if (IsHashed(map)) {
+        BuildIndex(map);
+    } else {
+        SortItems(map);
+    }
     return true;
+}
 
-error:
-    free(strCopy);
-    free(keyCopy);
-    return false;
+// Ensure room for the given number of additional items and string bytes,
+// relocating if necessary (the old arena, if any, is returned in oldItems for
+// the caller to free). Returns false on allocation failure.
+// Precondition: map is not out-of-memory
+static bool EnsureRoom(RERR_InfoMapPtr map, size_t addItems, size_t addBytes,
+                       struct RERR_InfoMapItem **oldItems) {
+    *oldItems = NULL;
+    size_t needItems = map->count + addItems;
+    if (needItems <= map->itemCapacity &&
+        addBytes <= map->strCapacity - map->strUsed) {
+        return true;
+    }
+    size_t itemCapacity =
+        GrowCapacity(map->itemCapacity, needItems, MIN_ITEM_CAPACITY);
+    size_t strCapacity =
+        GrowCapacity(map->strCapacity, map->strLive + addBytes,
+                     MIN_STR_CAPACITY);
+    return Relocate(map, itemCapacity, strCapacity, oldItems);
+}
+
+// Precondition: map != NULL
+static void ReleaseBase(RERR_InfoMapPtr map) {
+    RERR_InfoMap_Destroy(map->base);
+    map->base = NULL;
+    map->depth = 0;
+    map->size = 0;
 }
 
 // Precondition: map != NULL
 static void Clear(RERR_InfoMapPtr map) {
-    RERR_InfoMapIterator begin = RERR_DynArray_Begin(map->items);
-    RERR_InfoMapIterator end = RERR_DynArray_End(map->items);
-    for (RERR_InfoMapIterator it = begin; it != end; ++it) {
-        ClearItem(it);
+    ReleaseBase(map);
+    map->count = 0;
+    map->strUsed = 0;
+    map->strLive = 0;
+    map->flags &= ~(uint32_t)FLAG_UNSORTED;
+    if (IsHashed(map)) {
+        BuildIndex(map);
     }
-    RERR_DynArray_Clear(map->items);
 }
 
 // Precondition: map != NULL
 static RERR_InfoMapPtr MutableCopy(RERR_InfoMapPtr source) {
-    RERR_InfoMapPtr ret = RERR_InfoMap_Create();
-    if (!ret) {
-        goto error;
+    if (source->flags & FLAG_OUT_OF_MEMORY) {
+        return INFOMAP_OUT_OF_MEMORY;
     }
+    RERR_InfoMapPtr ret = RERR_InfoMap_Create();
     if (RERR_InfoMap_IsOutOfMemory(ret)) {
         return ret;
     }
+    if (source->base) { // Share the (immutable) base of an overlay
+        ret->base = RERR_InfoMap_Copy(source->base);
+        ret->depth = source->depth;
+        ret->size = source->size;
+    }
+    if (source->count == 0) {
+        return ret;
+    }
 
-    RERR_InfoMapIterator begin = RERR_DynArray_Begin(source->items);
-    RERR_InfoMapIterator end = RERR_DynArray_End(source->items);
-    for (RERR_InfoMapIterator it = begin; it != end; ++it) {
-        RERR_InfoMapIterator ins =
-            RERR_DynArray_Insert(ret->items, RERR_DynArray_End(ret->items));
-        if (!ins) {
-            goto error;
+    // Copy the items, the hash index (if any; it can be copied as is if the
+    // item capacity is the same) and the string area (including any garbage,
+    // which is cheaper to copy than to skip), and fix up the string pointers.
+    size_t itemCapacity = IsHashed(source) ? source->itemCapacity
+                                           : source->count;
+    size_t itemsSize = source->count * sizeof(struct RERR_InfoMapItem);
+    size_t indexSize = HashCapacity(itemCapacity) * sizeof(struct HashEntry);
+    ret->items = MemAlloc(itemCapacity * sizeof(struct RERR_InfoMapItem) +
+                          indexSize + source->strUsed);
+    if (!ret->items) {
+        RERR_InfoMap_Destroy(ret);
+        return NULL;
+    }
+    ret->flags |= source->flags & FLAG_UNSORTED;
+    ret->count = source->count;
+    ret->itemCapacity = itemCapacity;
+    ret->strUsed = source->strUsed;
+    ret->strLive = source->strLive;
+    ret->strCapacity = source->strUsed;
+
+    const char *srcStrings = StringArea(source->items, source->itemCapacity);
+    char *dstStrings = StringArea(ret->items, ret->itemCapacity);
+    memcpy(ret->items, source->items, itemsSize);
+    memcpy(HashIndex(ret->items, itemCapacity),
+           HashIndex(source->items, itemCapacity), indexSize);
+    memcpy(dstStrings, srcStrings, source->strUsed);
+    for (size_t i = 0; i < ret->count; ++i) {
+        struct RERR_InfoMapItem *item = &ret->items[i];
+        if (!item->value.staticKey) {
+            item->key = dstStrings + (item->key - srcStrings);
         }
-
-        bool ok = DeepCopyItem(ins, it);
-        if (!ok) {
-            goto error;
+        if (item->value.type == RERR_InfoValueTypeString) {
+            item->value.value.string =
+                dstStrings + (item->value.value.string - srcStrings);
+        } else if (IsBlobType(item->value.type)) {
+            const char *blob = (const char *)item->value.value.blob;
+            item->value.value.blob =
+                (const uint64_t *)(void *)(dstStrings + (blob - srcStrings));
         }
     }
 
     return ret;
-
-error:
-    RERR_InfoMap_Destroy(ret);
-    return NULL;
 }
 
-static int ItemKeyCompare(const void *item, const void *key) {
-    const struct RERR_InfoMapItem *i = item;
-    const char *k = key;
-    return strcmp(i->key, k);
+// Return the index of the first item whose key is not less than key.
+static size_t LowerBound(RERR_InfoMapPtr map, const char *key) {
+    size_t lo = 0;
+    size_t hi = map->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (map->items[mid].key == key) {
+            return mid;
+        }
+        if (strcmp(map->items[mid].key, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
 }
 
 static inline RERR_InfoMapIterator Find(RERR_InfoMapPtr map, const char *key) {
-    return RERR_DynArray_BSearch(map->items, key, ItemKeyCompare);
+    if (IsHashed(map)) {
+        struct HashEntry *entry = FindEntry(map, key, HashKey(key));
+        return entry->index ? &map->items[entry->index - 1] : NULL;
+    }
+    size_t i = LowerBound(map, key);
+    if (i < map->count && (map->items[i].key == key ||
+                           strcmp(map->items[i].key, key) == 0)) {
+        return &map->items[i];
+    }
+    return NULL;
+}
+
+// Return the visible item for key in map or its base layers.
+// Precondition: map is not out-of-memory
+static RERR_InfoMapIterator Lookup(RERR_InfoMapPtr map, const char *key) {
+    for (; map; map = map->base) {
+        RERR_InfoMapIterator found = Find(map, key);
+        if (found) {
+            return IsTombstone(found) ? NULL : found;
+        }
+    }
+    return NULL;
 }
 
 static void SwitchToOutOfMemory(RERR_InfoMapPtr map) {
-    Clear(map); // TODO May shrink, which is a wasted step
-    RERR_DynArray_Destroy(map->items);
+    ReleaseBase(map);
+    MemFree(map->items);
     map->items = NULL;
+    map->count = 0;
+    map->itemCapacity = 0;
+    map->strUsed = 0;
+    map->strLive = 0;
+    map->strCapacity = 0;
+    map->flags &= ~(uint32_t)FLAG_UNSORTED;
     map->flags |= FLAG_OUT_OF_MEMORY;
 }
 
-// Ensures capacity and finds insertion point (or NULL on error)
+// Ensures capacity (including valueBytes in the string area) and finds or
+// inserts the item for key (copied into the map unless staticKey is true). The
+// old arena, if relocated, is returned in oldItems and must be freed by the
+// caller once done with the value (which may point into it).
 // Precondition: map != NULL
 // Precondition: key != NULL
-// Postcondition: *it == NULL || (*it)->key contains copy of key
+// Postcondition: *it == NULL || (*it)->key contains copy of (or is) key
 // Postcondition: (*it)->value is invalid
 // Returns true if successful; false on allocation failure
-static bool SetKey(RERR_InfoMapPtr map, const char *key,
-                   RERR_InfoMapIterator *it) {
-    *it = RERR_DynArray_BSearchInsertionPoint(map->items, key, ItemKeyCompare);
-
-    // Found exact, so need to overwrite
-    if (*it != RERR_DynArray_End(map->items) && strcmp((*it)->key, key) == 0) {
-        // Overwriting value in place.
-        // Evacuate key while we clear the item.
-        const char *saveKey = (*it)->key;
-        (*it)->key = NULL;
-        ClearItem(*it);
-        (*it)->key = saveKey;
-        return true;
-    }
-
-    bool ret = true;
+static bool SetKey(RERR_InfoMapPtr map, const char *key, bool staticKey,
+                   size_t valueBytes, RERR_InfoMapIterator *it,
+                   struct RERR_InfoMapItem **oldItems) {
+    size_t i;
+    bool found;
+    if (IsHashed(map)) {
+        RERR_InfoMapIterator item = Find(map, key);
+        found = item != NULL;
+        i = found ? (size_t)(item - map->items) : map->count;
+    } else {
+        i = LowerBound(map, key);
+        found = i < map->count && (map->items[i].key == key ||
+                                   strcmp(map->items[i].key, key) == 0);
+    }
+
+    // In an overlay, a new item either hides a base item or adds to the size
+    bool hides = !found && map->base && Lookup(map->base, key);
 
     size_t keyLen = strlen(key);
-    char *keyCopy = malloc(keyLen + 1);
-    if (!keyCopy) {
+    size_t keyBytes = found || staticKey ? 0 : keyLen + 1;
+    if (!EnsureRoom(map, found ? 0 : 1, valueBytes + keyBytes, oldItems)) {
         SwitchToOutOfMemory(map);
-        ret = false;
-        goto exit;
+        *it = NULL;
+        return false;
     }
-    strncpy(keyCopy, key, keyLen + 1);
 
-    *it = RERR_DynArray_Insert(map->items, *it);
-    if (!*it) {
-        SwitchToOutOfMemory(map);
-        ret = false;
-        goto exit;
+    *it = &map->items[i];
+    if (found) {
+        // Overwriting value in place.
+        if (IsTombstone(*it)) {
+            ++map->size;
+        }
+        map->strLive -= ValueStrBytes(&(*it)->value);
+        return true;
+    }
+    if (map->base && !hides) {
+        ++map->size;
     }
 
-    (*it)->key = keyCopy;
-    keyCopy = NULL;
+    if (IsHashed(map)) {
+        // Append; the index is either unchanged or was rebuilt by EnsureRoom()
+        i = map->count;
+        *it = &map->items[i];
+        if (i > 0 && strcmp(map->items[i - 1].key, key) > 0) {
+            map->flags |= FLAG_UNSORTED;
+        }
+        ++map->count;
+        (*it)->key = staticKey ? key : AppendString(map, key, keyLen);
+        (*it)->value.staticKey = staticKey;
+        uint32_t hash = HashKey(key);
+        struct HashEntry *entry = FindEntry(map, key, hash);
+        entry->hash = hash;
+        entry->index = (uint32_t)(i + 1);
+        return true;
+    }
 
-exit:
-    free(keyCopy);
-    return ret;
+    memmove(*it + 1, *it, (map->count - i) * sizeof(struct RERR_InfoMapItem));
+    ++map->count;
+    (*it)->key = staticKey ? key : AppendString(map, key, keyLen);
+    (*it)->value.staticKey = staticKey;
+    return true;
 }
 
 RERR_InfoMapPtr RERR_InfoMap_Create(void) {
-    RERR_InfoMapPtr ret = calloc(1, sizeof(struct RERR_InfoMap));
+    RERR_InfoMapPtr ret =
+        Pool_Alloc(PoolClass_InfoMap, sizeof(struct RERR_InfoMap));
     if (!ret) {
         return INFOMAP_OUT_OF_MEMORY;
     }
-    ret->refCount = 1;
+    memset(ret, 0, sizeof(struct RERR_InfoMap));
+    AtomicRefCountInit(&ret->refCount, 1);
+    AtomicInitPtr(&ret->flat, NULL);
+    Stats_Created(StatsCounter_InfoMapsLive, StatsCounter_InfoMapsCreated);
+    // The arena is allocated when the first item is added.
+    return ret;
+}
 
-    // TODO In-place version of DynArray create/destroy?
-    ret->items = RERR_DynArray_Create(sizeof(struct RERR_InfoMapItem));
-    if (!ret->items) {
-        free(ret);
-        return INFOMAP_OUT_OF_MEMORY;
+RERR_InfoMapPtr RERR_InfoMap_CreateOutOfMemory(void) {
+    return INFOMAP_OUT_OF_MEMORY;
+}
+
+static inline bool InitItemIsValid(const RERR_InfoMapInitItem *item) {
+    switch (item->type) {
+    case RERR_InfoValueTypeString:
+        return item->key && item->value.string;
+    case RERR_InfoValueTypeBool:
+    case RERR_InfoValueTypeI64:
+    case RERR_InfoValueTypeU64:
+    case RERR_InfoValueTypeF64:
+        return item->key;
+    default:
+        return false;
     }
+}
+
+// Record the programming error if the init item is invalid.
+static bool CheckInitItem(RERR_InfoMapPtr map,
+                          const RERR_InfoMapInitItem *item) {
+    if (InitItemIsValid(item)) {
+        return true;
+    }
+    map->flags |=
+        item->key ? FLAG_ERROR_NULL_VALUE_GIVEN : FLAG_ERROR_NULL_KEY_GIVEN;
+    return false;
+}
 
+// Precondition: InitItemIsValid(item)
+static size_t InitItemStrBytes(const RERR_InfoMapInitItem *item,
+                               bool staticKey) {
+    size_t ret = staticKey ? 0 : strlen(item->key) + 1;
+    if (item->type == RERR_InfoValueTypeString) {
+        ret += strlen(item->value.string) + 1;
+    }
     return ret;
 }
 
-RERR_InfoMapPtr RERR_InfoMap_CreateOutOfMemory(void) {
-    return INFOMAP_OUT_OF_MEMORY;
+// Precondition: the string area has room for the key (unless staticKey)
+static const char *AppendInitKey(RERR_InfoMapPtr map,
+                                 const RERR_InfoMapInitItem *item,
+                                 bool staticKey) {
+    if (staticKey) {
+        return item->key;
+    }
+    return AppendString(map, item->key, strlen(item->key));
+}
+
+// Precondition: the string area has room for the value
+static void SetInitValue(RERR_InfoMapPtr map, struct RERR_InfoMapItem *item,
+                         const RERR_InfoMapInitItem *init, bool staticKey) {
+    item->value.type = init->type;
+    item->value.staticKey = staticKey;
+    switch (init->type) {
+    case RERR_InfoValueTypeString:
+        item->value.value.string =
+            AppendString(map, init->value.string, strlen(init->value.string));
+        break;
+    case RERR_InfoValueTypeBool:
+        item->value.value.boolean = init->value.boolean;
+        break;
+    case RERR_InfoValueTypeI64:
+        item->value.value.i64 = init->value.i64;
+        break;
+    case RERR_InfoValueTypeU64:
+        item->value.value.u64 = init->value.u64;
+        break;
+    case RERR_InfoValueTypeF64:
+        item->value.value.f64 = init->value.f64;
+        break;
+    }
+}
+
+RERR_InfoMapPtr RERR_InfoMap_CreateFromItems(const RERR_InfoMapInitItem *items,
+                                             size_t count, uint32_t flags) {
+    RERR_InfoMapPtr ret = RERR_InfoMap_Create();
+    if (ret == INFOMAP_OUT_OF_MEMORY) {
+        return ret;
+    }
+    bool staticKeys = flags & RERR_InfoMapCreateStaticKeys;
+
+    size_t validCount = 0;
+    size_t strBytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (CheckInitItem(ret, &items[i])) {
+            ++validCount;
+            strBytes += InitItemStrBytes(&items[i], staticKeys);
+        }
+    }
+
+    if (validCount > 0) {
+        struct RERR_InfoMapItem *oldItems;
+        if (!Relocate(ret, validCount, strBytes, &oldItems)) {
+            SwitchToOutOfMemory(ret);
+        } else if (IsHashed(ret)) {
+            // Deduplicate through the index; sorting is deferred as usual.
+            for (size_t i = 0; i < count; ++i) {
+                if (!InitItemIsValid(&items[i])) {
+                    continue;
+                }
+                uint32_t hash = HashKey(items[i].key);
+                struct HashEntry *entry = FindEntry(ret, items[i].key, hash);
+                if (entry->index) {
+                    struct RERR_InfoMapItem *item =
+                        &ret->items[entry->index - 1];
+                    ret->strLive -= ValueStrBytes(&item->value);
+                    SetInitValue(ret, item, &items[i], staticKeys);
+                    continue;
+                }
+                struct RERR_InfoMapItem *item = &ret->items[ret->count];
+                item->key = AppendInitKey(ret, &items[i], staticKeys);
+                SetInitValue(ret, item, &items[i], staticKeys);
+                if (!(flags & RERR_InfoMapCreatePresorted) && ret->count > 0 &&
+                    strcmp(item[-1].key, item->key) > 0) {
+                    ret->flags |= FLAG_UNSORTED;
+                }
+                entry->hash = hash;
+                entry->index = (uint32_t)(++ret->count);
+            }
+        } else {
+            bool sorted = true;
+            for (size_t i = 0; i < count; ++i) {
+                if (!InitItemIsValid(&items[i])) {
+                    continue;
+                }
+                struct RERR_InfoMapItem *item = &ret->items[ret->count];
+                item->key = AppendInitKey(ret, &items[i], staticKeys);
+                SetInitValue(ret, item, &items[i], staticKeys);
+                if (!(flags & RERR_InfoMapCreatePresorted) && ret->count > 0 &&
+                    strcmp(item[-1].key, item->key) >= 0) {
+                    sorted = false;
+                }
+                ++ret->count;
+            }
+
+            if (!sorted) {
+                // Stable insertion sort (fewer than HASH_MIN_ITEM_CAPACITY)
+                for (size_t i = 1; i < ret->count; ++i) {
+                    struct RERR_InfoMapItem item = ret->items[i];
+                    size_t j = i;
+                    while (j > 0 &&
+                           strcmp(ret->items[j - 1].key, item.key) > 0) {
+                        ret->items[j] = ret->items[j - 1];
+                        --j;
+                    }
+                    ret->items[j] = item;
+                }
+                // Remove duplicates, keeping the last of each
+                size_t n = 0;
+                for (size_t i = 0; i < ret->count; ++i) {
+                    if (n > 0 &&
+                        strcmp(ret->items[n - 1].key, ret->items[i].key) ==
+                            0) {
+                        ret->strLive -= ItemStrBytes(&ret->items[n - 1]);
+                        ret->items[n - 1] = ret->items[i];
+                    } else {
+                        ret->items[n++] = ret->items[i];
+                    }
+                }
+                ret->count = n;
+            }
+        }
+    }
+
+    if (flags & RERR_InfoMapCreateImmutable) {
+        RERR_InfoMap_MakeImmutable(ret);
+    }
+    return ret;
 }
 
 void RERR_InfoMap_Destroy(RERR_InfoMapPtr map) {
@@ -274,16 +827,15 @@ void RERR_InfoMap_Destroy(RERR_InfoMapPtr map) {
         return;
     }
 
-    if (--map->refCount > 0) {
+    if (!AtomicRefCountDecrement(&map->refCount)) {
         return;
     }
 
-    if (!(map->flags & FLAG_OUT_OF_MEMORY)) {
-        // TODO Clear() may realloc to shrink, which is a waste
-        Clear(map);
-        RERR_DynArray_Destroy(map->items);
-    }
-    free(map);
+    RERR_InfoMap_Destroy(map->base);
+    RERR_InfoMap_Destroy(AtomicLoadPtrAcquire(&map->flat));
+    MemFree(map->items); // Null if out-of-memory
+    Pool_Free(PoolClass_InfoMap, map, sizeof(struct RERR_InfoMap));
+    Stats_Destroyed(StatsCounter_InfoMapsLive);
 }
 
 RERR_InfoMapPtr RERR_InfoMap_Copy(RERR_InfoMapPtr map) {
@@ -295,7 +847,7 @@ RERR_InfoMapPtr RERR_InfoMap_Copy(RERR_InfoMapPtr map) {
     }
 
     if (map->flags & FLAG_IMMUTABLE) {
-        ++map->refCount;
+        AtomicRefCountIncrement(&map->refCount);
         return map;
     }
 
@@ -326,6 +878,8 @@ void RERR_InfoMap_MakeImmutable(RERR_InfoMapPtr map) {
         return;
     }
 
+    // Sort now, so that iterating a shared map does not modify it.
+    SortItems(map);
     map->flags |= FLAG_IMMUTABLE;
     // TODO Shrink if there is excess capacity
 }
@@ -429,7 +983,7 @@ size_t RERR_InfoMap_GetSize(RERR_InfoMapPtr map) {
         return 0;
     }
 
-    return RERR_DynArray_GetSize(map->items);
+    return map->base ? map->size : map->count;
 }
 
 bool RERR_InfoMap_IsEmpty(RERR_InfoMapPtr map) {
@@ -440,7 +994,7 @@ bool RERR_InfoMap_IsEmpty(RERR_InfoMapPtr map) {
         return true;
     }
 
-    return RERR_DynArray_IsEmpty(map->items);
+    return RERR_InfoMap_GetSize(map) == 0;
 }
 
 void RERR_InfoMap_ReserveCapacity(RERR_InfoMapPtr map, size_t capacity) {
@@ -451,11 +1005,30 @@ void RERR_InfoMap_ReserveCapacity(RERR_InfoMapPtr map, size_t capacity) {
         return;
     }
 
-    RERR_DynArray_ReserveCapacity(map->items, capacity);
+    if (capacity < map->count) {
+        capacity = map->count;
+    }
+    if (capacity == map->itemCapacity) {
+        return;
+    }
+
+    // When shrinking, also release excess string capacity.
+    size_t strCapacity =
+        capacity < map->itemCapacity ? map->strLive : map->strCapacity;
+    struct RERR_InfoMapItem *oldItems;
+    if (capacity == 0 && strCapacity == 0) {
+        oldItems = map->items;
+        map->items = NULL;
+        map->itemCapacity = 0;
+        map->strCapacity = 0;
+    } else if (!Relocate(map, capacity, strCapacity, &oldItems)) {
+        return;
+    }
+    MemFree(oldItems);
 }
 
-void RERR_InfoMap_SetString(RERR_InfoMapPtr map, const char *key,
-                            const char *value) {
+static void SetString(RERR_InfoMapPtr map, const char *key, const char *value,
+                      size_t strLen, bool staticKey) {
     if (!map) {
         return;
     }
@@ -478,29 +1051,36 @@ void RERR_InfoMap_SetString(RERR_InfoMapPtr map, const char *key,
         return;
     }
 
-    size_t strLen = strlen(value);
-    char *strCopy = malloc(strLen + 1);
-    if (!strCopy) {
-        SwitchToOutOfMemory(map);
-        goto exit;
-    }
-    strncpy(strCopy, value, strLen + 1);
-
+    // Key and value may point into the old arena if we relocate
     RERR_InfoMapIterator it;
-    bool ok = SetKey(map, key, &it);
+    struct RERR_InfoMapItem *oldItems;
+    bool ok = SetKey(map, key, staticKey, strLen + 1, &it, &oldItems);
     if (!ok) {
-        goto exit;
+        return;
     }
 
     it->value.type = RERR_InfoValueTypeString;
-    it->value.value.string = strCopy;
-    strCopy = NULL;
+    it->value.value.string = AppendString(map, value, strLen);
+    MemFree(oldItems);
+}
+
+void RERR_InfoMap_SetString(RERR_InfoMapPtr map, const char *key,
+                            const char *value) {
+    SetString(map, key, value, value ? strlen(value) : 0, false);
+}
 
-exit:
-    free(strCopy);
+void RERR_InfoMap_SetStringN(RERR_InfoMapPtr map, const char *key,
+                             const char *value, size_t valueLen) {
+    SetString(map, key, value, valueLen, false);
 }
 
-void RERR_InfoMap_SetBool(RERR_InfoMapPtr map, const char *key, bool value) {
+void RERR_InfoMap_SetStringStaticKey(RERR_InfoMapPtr map, const char *key,
+                                     const char *value) {
+    SetString(map, key, value, value ? strlen(value) : 0, true);
+}
+
+static void SetBool(RERR_InfoMapPtr map, const char *key, bool value,
+                    bool staticKey) {
     if (!map) {
         return;
     }
@@ -520,16 +1100,28 @@ void RERR_InfoMap_SetBool(RERR_InfoMapPtr map, const char *key, bool value) {
     }
 
     RERR_InfoMapIterator it;
-    bool ok = SetKey(map, key, &it);
+    struct RERR_InfoMapItem *oldItems;
+    bool ok = SetKey(map, key, staticKey, 0, &it, &oldItems);
     if (!ok) {
         return;
     }
+    MemFree(oldItems);
 
     it->value.type = RERR_InfoValueTypeBool;
     it->value.value.boolean = value;
 }
 
-void RERR_InfoMap_SetI64(RERR_InfoMapPtr map, const char *key, int64_t value) {
+void RERR_InfoMap_SetBool(RERR_InfoMapPtr map, const char *key, bool value) {
+    SetBool(map, key, value, false);
+}
+
+void RERR_InfoMap_SetBoolStaticKey(RERR_InfoMapPtr map, const char *key,
+                                   bool value) {
+    SetBool(map, key, value, true);
+}
+
+static void SetI64(RERR_InfoMapPtr map, const char *key, int64_t value,
+                   bool staticKey) {
     if (!map) {
         return;
     }
@@ -549,17 +1141,28 @@ void RERR_InfoMap_SetI64(RERR_InfoMapPtr map, const char *key, int64_t value) {
     }
 
     RERR_InfoMapIterator it;
-    bool ok = SetKey(map, key, &it);
+    struct RERR_InfoMapItem *oldItems;
+    bool ok = SetKey(map, key, staticKey, 0, &it, &oldItems);
     if (!ok) {
         return;
     }
+    MemFree(oldItems);
 
     it->value.type = RERR_InfoValueTypeI64;
     it->value.value.i64 = value;
 }
 
-void RERR_InfoMap_SetU64(RERR_InfoMapPtr map, const char *key,
-                         uint64_t value) {
+void RERR_InfoMap_SetI64(RERR_InfoMapPtr map, const char *key, int64_t value) {
+    SetI64(map, key, value, false);
+}
+
+void RERR_InfoMap_SetI64StaticKey(RERR_InfoMapPtr map, const char *key,
+                                  int64_t value) {
+    SetI64(map, key, value, true);
+}
+
+static void SetU64(RERR_InfoMapPtr map, const char *key, uint64_t value,
+                   bool staticKey) {
     if (!map) {
         return;
     }
@@ -579,16 +1182,29 @@ void RERR_InfoMap_SetU64(RERR_InfoMapPtr map, const char *key,
     }
 
     RERR_InfoMapIterator it;
-    bool ok = SetKey(map, key, &it);
+    struct RERR_InfoMapItem *oldItems;
+    bool ok = SetKey(map, key, staticKey, 0, &it, &oldItems);
     if (!ok) {
         return;
     }
+    MemFree(oldItems);
 
     it->value.type = RERR_InfoValueTypeU64;
     it->value.value.u64 = value;
 }
 
-void RERR_InfoMap_SetF64(RERR_InfoMapPtr map, const char *key, double value) {
+void RERR_InfoMap_SetU64(RERR_InfoMapPtr map, const char *key,
+                         uint64_t value) {
+    SetU64(map, key, value, false);
+}
+
+void RERR_InfoMap_SetU64StaticKey(RERR_InfoMapPtr map, const char *key,
+                                  uint64_t value) {
+    SetU64(map, key, value, true);
+}
+
+static void SetF64(RERR_InfoMapPtr map, const char *key, double value,
+                   bool staticKey) {
     if (!map) {
         return;
     }
@@ -608,15 +1224,86 @@ void RERR_InfoMap_SetF64(RERR_InfoMapPtr map, const char *key, double value) {
     }
 
     RERR_InfoMapIterator it;
-    bool ok = SetKey(map, key, &it);
+    struct RERR_InfoMapItem *oldItems;
+    bool ok = SetKey(map, key, staticKey, 0, &it, &oldItems);
     if (!ok) {
         return;
     }
+    MemFree(oldItems);
 
     it->value.type = RERR_InfoValueTypeF64;
     it->value.value.f64 = value;
 }
 
+void RERR_InfoMap_SetF64(RERR_InfoMapPtr map, const char *key, double value) {
+    SetF64(map, key, value, false);
+}
+
+void RERR_InfoMap_SetF64StaticKey(RERR_InfoMapPtr map, const char *key,
+                                  double value) {
+    SetF64(map, key, value, true);
+}
+
+static void SetBlob(RERR_InfoMapPtr map, const char *key,
+                    RERR_InfoValueType type, const void *data, size_t size) {
+    if (!map) {
+        return;
+    }
+    if (map == INFOMAP_OUT_OF_MEMORY) {
+        return;
+    }
+    if (!key) {
+        map->flags |= FLAG_ERROR_NULL_KEY_GIVEN;
+        return;
+    }
+    if (!data && size > 0) {
+        map->flags |= FLAG_ERROR_NULL_VALUE_GIVEN;
+        return;
+    }
+    if (map->flags & FLAG_IMMUTABLE) {
+        map->flags |= FLAG_ERROR_ATTEMPT_TO_MUTATE_IMMUTABLE;
+        return;
+    }
+    if (map->flags & FLAG_OUT_OF_MEMORY) {
+        return;
+    }
+    if (size > SIZE_MAX / 4) {
+        SwitchToOutOfMemory(map);
+        return;
+    }
+
+    // Data may point into the old arena if we relocate
+    RERR_InfoMapIterator it;
+    struct RERR_InfoMapItem *oldItems;
+    bool ok = SetKey(map, key, false, BlobBytes(size), &it, &oldItems);
+    if (!ok) {
+        return;
+    }
+
+    it->value.type = type;
+    it->value.value.blob = AppendBlob(map, data, size);
+    MemFree(oldItems);
+}
+
+void RERR_InfoMap_SetBytes(RERR_InfoMapPtr map, const char *key,
+                           const void *data, size_t size) {
+    SetBlob(map, key, RERR_InfoValueTypeBytes, data, size);
+}
+
+void RERR_InfoMap_SetI64Array(RERR_InfoMapPtr map, const char *key,
+                              const int64_t *values, size_t count) {
+    size_t size = count > SIZE_MAX / sizeof(int64_t) ? SIZE_MAX
+                                                     : count * sizeof(int64_t);
+    SetBlob(map, key, RERR_InfoValueTypeI64Array, values, size);
+}
+
+void RERR_InfoMap_SetF64Array(RERR_InfoMapPtr map, const char *key,
+                              const double *values, size_t count) {
+    size_t size = count > SIZE_MAX / sizeof(double) ? SIZE_MAX
+                                                    : count * sizeof(double);
+    SetBlob(map, key, RERR_InfoValueTypeF64Array, values, size);
+}
+
 void RERR_InfoMap_Remove(RERR_InfoMapPtr map, const char *key) {
     if (!map) {
         return;
@@ -637,12 +1324,48 @@ void RERR_InfoMap_Remove(RERR_InfoMapPtr map, const char *key) {
     }
 
     RERR_InfoMapIterator found = Find(map, key);
+    if (map->base && Lookup(map->base, key)) {
+        // Hide the base item with a tombstone
+        if (found && IsTombstone(found)) {
+            return;
+        }
+        if (found) {
+            map->strLive -= ValueStrBytes(&found->value);
+        } else {
+            struct RERR_InfoMapItem *oldItems;
+            if (!SetKey(map, key, false, 0, &found, &oldItems)) {
+                return;
+            }
+            MemFree(oldItems);
+        }
+        found->value.type = RERR_InfoValueTypeInvalid;
+        --map->size;
+        return;
+    }
     if (!found) {
         return;
     }
+    if (map->base) {
+        --map->size;
+    }
 
-    ClearItem(found);
-    RERR_DynArray_Erase(map->items, found);
+    map->strLive -= ItemStrBytes(found);
+    size_t i = (size_t)(found - map->items);
+    if (IsHashed(map)) {
+        // Move the last item into the vacated position
+        RemoveEntry(map, FindEntryForItem(map, i));
+        size_t last = map->count - 1;
+        if (i != last) {
+            FindEntryForItem(map, last)->index = (uint32_t)(i + 1);
+            *found = map->items[last];
+            map->flags |= FLAG_UNSORTED;
+        }
+        --map->count;
+        return;
+    }
+    memmove(found, found + 1,
+            (map->count - i - 1) * sizeof(struct RERR_InfoMapItem));
+    --map->count;
 }
 
 void RERR_InfoMap_Clear(RERR_InfoMapPtr map) {
@@ -663,13 +1386,166 @@ void RERR_InfoMap_Clear(RERR_InfoMapPtr map) {
     Clear(map);
 }
 
+// Precondition: dst is not an overlay
+static void ApplyItem(RERR_InfoMapPtr dst,
+                      const struct RERR_InfoMapItem *item) {
+    const char *key = item->key;
+    bool staticKey = item->value.staticKey;
+    switch (item->value.type) {
+    case RERR_InfoValueTypeInvalid: // Tombstone
+        RERR_InfoMap_Remove(dst, key);
+        break;
+    case RERR_InfoValueTypeString:
+        SetString(dst, key, item->value.value.string,
+                  strlen(item->value.value.string), staticKey);
+        break;
+    case RERR_InfoValueTypeBool:
+        SetBool(dst, key, item->value.value.boolean, staticKey);
+        break;
+    case RERR_InfoValueTypeI64:
+        SetI64(dst, key, item->value.value.i64, staticKey);
+        break;
+    case RERR_InfoValueTypeU64:
+        SetU64(dst, key, item->value.value.u64, staticKey);
+        break;
+    case RERR_InfoValueTypeF64:
+        SetF64(dst, key, item->value.value.f64, staticKey);
+        break;
+    default: { // Blob
+        const uint64_t *blob = item->value.value.blob;
+        SetBlob(dst, key, item->value.type, blob + 1, (size_t)blob[0]);
+        break;
+    }
+    }
+}
+
+// Return a new mutable map (not an overlay) with the items visible in map.
+// Precondition: map->base != NULL
+static RERR_InfoMapPtr FlatCopy(RERR_InfoMapPtr map) {
+    RERR_InfoMapPtr layers[OVERLAY_MAX_DEPTH];
+    size_t n = 0;
+    RERR_InfoMapPtr bottom = map;
+    for (; bottom->base; bottom = bottom->base) {
+        layers[n++] = bottom;
+    }
+
+    RERR_InfoMapPtr ret = MutableCopy(bottom);
+    RERR_InfoMap_ReserveCapacity(ret, RERR_InfoMap_GetSize(map));
+    while (n > 0) {
+        RERR_InfoMapPtr layer = layers[--n];
+        for (size_t i = 0; i < layer->count; ++i) {
+            ApplyItem(ret, &layer->items[i]);
+        }
+    }
+    return ret;
+}
+
+// Return the flattened copy of an immutable overlay, creating it if
+// necessary; null on allocation failure.
+// Precondition: map->base != NULL && (map->flags & FLAG_IMMUTABLE)
+static RERR_InfoMapPtr GetFlat(RERR_InfoMapPtr map) {
+    RERR_InfoMapPtr flat = AtomicLoadPtrAcquire(&map->flat);
+    if (flat) {
+        return flat;
+    }
+
+    flat = FlatCopy(map);
+    if (!flat || RERR_InfoMap_IsOutOfMemory(flat)) {
+        RERR_InfoMap_Destroy(flat);
+        return NULL;
+    }
+    RERR_InfoMap_MakeImmutable(flat);
+    if (!AtomicSetPtrIfNull(&map->flat, flat)) {
+        // Another thread won the race
+        RERR_InfoMap_Destroy(flat);
+        flat = AtomicLoadPtrAcquire(&map->flat);
+    }
+    return flat;
+}
+
+// Precondition: map->base != NULL && map is mutable and not out-of-memory
+static void FlattenInPlace(RERR_InfoMapPtr map) {
+    RERR_InfoMapPtr flat = FlatCopy(map);
+    if (!flat || RERR_InfoMap_IsOutOfMemory(flat)) {
+        RERR_InfoMap_Destroy(flat);
+        SwitchToOutOfMemory(map);
+        return;
+    }
+
+    ReleaseBase(map);
+    MemFree(map->items);
+    map->items = flat->items;
+    map->count = flat->count;
+    map->itemCapacity = flat->itemCapacity;
+    map->strUsed = flat->strUsed;
+    map->strLive = flat->strLive;
+    map->strCapacity = flat->strCapacity;
+    map->flags = (map->flags & ~(uint32_t)FLAG_UNSORTED) |
+                 (flat->flags & FLAG_UNSORTED);
+    flat->items = NULL;
+    RERR_InfoMap_Destroy(flat);
+}
+
+// Return the map whose items are iterated in place of map, or null on
+// allocation failure.
+// Precondition: map is not out-of-memory
+static RERR_InfoMapPtr IterationMap(RERR_InfoMapPtr map) {
+    if (!map->base) {
+        return map;
+    }
+    if (map->flags & FLAG_IMMUTABLE) {
+        return GetFlat(map);
+    }
+    FlattenInPlace(map);
+    return RERR_InfoMap_IsOutOfMemory(map) ? NULL : map;
+}
+
+RERR_InfoMapPtr RERR_InfoMap_CreateOverlay(RERR_InfoMapPtr base) {
+    if (RERR_InfoMap_IsEmpty(base)) { // Includes null and out-of-memory
+        return RERR_InfoMap_Create();
+    }
+    if (!(base->flags & FLAG_IMMUTABLE)) {
+        return MutableCopy(base);
+    }
+    if (base->depth == OVERLAY_MAX_DEPTH) {
+        base = GetFlat(base);
+        if (!base) {
+            return INFOMAP_OUT_OF_MEMORY;
+        }
+    }
+
+    RERR_InfoMapPtr ret = RERR_InfoMap_Create();
+    if (ret == INFOMAP_OUT_OF_MEMORY) {
+        return ret;
+    }
+    AtomicRefCountIncrement(&base->refCount);
+    ret->base = base;
+    ret->depth = base->depth + 1;
+    ret->size = RERR_InfoMap_GetSize(base);
+    return ret;
+}
+
+void RERR_InfoMap_Flatten(RERR_InfoMapPtr map) {
+    if (!map) {
+        return;
+    }
+    if (map == INFOMAP_OUT_OF_MEMORY) {
+        return;
+    }
+    if (map->flags & (FLAG_IMMUTABLE | FLAG_OUT_OF_MEMORY)) {
+        return;
+    }
+    if (map->base) {
+        FlattenInPlace(map);
+    }
+}
+
 bool RERR_InfoMap_HasKey(RERR_InfoMapPtr map, const char *key) {
     if (!map || !key || RERR_InfoMap_IsOutOfMemory(map)) {
         return false;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
-    return found != NULL;
+    return Lookup(map, key) != NULL;
 }
 
 RERR_InfoValueType RERR_InfoMap_GetType(RERR_InfoMapPtr map, const char *key) {
@@ -677,7 +1553,7 @@ RERR_InfoValueType RERR_InfoMap_GetType(RERR_InfoMapPtr map, const char *key) {
         return RERR_InfoValueTypeInvalid;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
+    RERR_InfoMapIterator found = Lookup(map, key);
     if (!found) {
         return RERR_InfoValueTypeInvalid;
     }
@@ -696,7 +1572,7 @@ bool RERR_InfoMap_GetString(RERR_InfoMapPtr map, const char *key,
         return false;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
+    RERR_InfoMapIterator found = Lookup(map, key);
     if (!found || found->value.type != RERR_InfoValueTypeString) {
         return false;
     }
@@ -715,7 +1591,7 @@ bool RERR_InfoMap_GetBool(RERR_InfoMapPtr map, const char *key, bool *value) {
         return false;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
+    RERR_InfoMapIterator found = Lookup(map, key);
     if (!found || found->value.type != RERR_InfoValueTypeBool) {
         return false;
     }
@@ -735,7 +1611,7 @@ bool RERR_InfoMap_GetI64(RERR_InfoMapPtr map, const char *key,
         return false;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
+    RERR_InfoMapIterator found = Lookup(map, key);
     if (!found || found->value.type != RERR_InfoValueTypeI64) {
         return false;
     }
@@ -755,7 +1631,7 @@ bool RERR_InfoMap_GetU64(RERR_InfoMapPtr map, const char *key,
         return false;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
+    RERR_InfoMapIterator found = Lookup(map, key);
     if (!found || found->value.type != RERR_InfoValueTypeU64) {
         return false;
     }
@@ -774,7 +1650,7 @@ bool RERR_InfoMap_GetF64(RERR_InfoMapPtr map, const char *key, double *value) {
         return false;
     }
 
-    RERR_InfoMapIterator found = Find(map, key);
+    RERR_InfoMapIterator found = Lookup(map, key);
     if (!found || found->value.type != RERR_InfoValueTypeF64) {
         return false;
     }
@@ -783,12 +1659,69 @@ bool RERR_InfoMap_GetF64(RERR_InfoMapPtr map, const char *key, double *value) {
     return true;
 }
 
+static bool GetBlob(RERR_InfoMapPtr map, const char *key,
+                    RERR_InfoValueType type, const void **data,
+                    size_t *size) {
+    if (!data || !size) {
+        return false;
+    }
+    *data = NULL;
+    *size = 0;
+
+    if (!map || !key || RERR_InfoMap_IsOutOfMemory(map)) {
+        return false;
+    }
+
+    RERR_InfoMapIterator found = Lookup(map, key);
+    if (!found || found->value.type != type) {
+        return false;
+    }
+
+    *data = found->value.value.blob + 1;
+    *size = (size_t)found->value.value.blob[0];
+    return true;
+}
+
+bool RERR_InfoMap_GetBytes(RERR_InfoMapPtr map, const char *key,
+                           const void **data, size_t *size) {
+    return GetBlob(map, key, RERR_InfoValueTypeBytes, data, size);
+}
+
+bool RERR_InfoMap_GetI64Array(RERR_InfoMapPtr map, const char *key,
+                              const int64_t **values, size_t *count) {
+    if (!values || !count) {
+        return false;
+    }
+    const void *data;
+    bool ret = GetBlob(map, key, RERR_InfoValueTypeI64Array, &data, count);
+    *values = data;
+    *count /= sizeof(int64_t);
+    return ret;
+}
+
+bool RERR_InfoMap_GetF64Array(RERR_InfoMapPtr map, const char *key,
+                              const double **values, size_t *count) {
+    if (!values || !count) {
+        return false;
+    }
+    const void *data;
+    bool ret = GetBlob(map, key, RERR_InfoValueTypeF64Array, &data, count);
+    *values = data;
+    *count /= sizeof(double);
+    return ret;
+}
+
 RERR_InfoMapIterator RERR_InfoMap_Begin(RERR_InfoMapPtr map) {
     if (!map || RERR_InfoMap_IsOutOfMemory(map)) {
         // begin and end must be equal even if map is "empty"
         return NULL;
     }
-    return RERR_DynArray_Begin(map->items);
+    map = IterationMap(map);
+    if (!map) {
+        return NULL;
+    }
+    SortItems(map); // Never unsorted if immutable
+    return map->items;
 }
 
 RERR_InfoMapIterator RERR_InfoMap_End(RERR_InfoMapPtr map) {
@@ -796,7 +1729,11 @@ RERR_InfoMapIterator RERR_InfoMap_End(RERR_InfoMapPtr map) {
         // begin and end must be equal even if map is "empty"
         return NULL;
     }
-    return RERR_DynArray_End(map->items);
+    map = IterationMap(map);
+    if (!map) {
+        return NULL;
+    }
+    return map->items + map->count;
 }
 
 RERR_InfoMapIterator RERR_InfoMap_Advance(RERR_InfoMapPtr map,
@@ -807,7 +1744,8 @@ RERR_InfoMapIterator RERR_InfoMap_Advance(RERR_InfoMapPtr map,
     // without having a reference to the whole map, but we demand such a
     // reference in case we change the map storage implementation in the
     // future.
-    return RERR_DynArray_Advance(map->items, it);
+    (void)map;
+    return it + 1;
 }
 
 const char *RERR_InfoMapIterator_GetKey(RERR_InfoMapIterator it) {
@@ -865,3 +1803,57 @@ double RERR_InfoMapIterator_GetF64(RERR_InfoMapIterator it) {
     }
     return it->value.value.f64;
 }
+
+// Precondition: it contains a blob
+static const void *IteratorBlob(RERR_InfoMapIterator it, size_t *size) {
+    if (size) {
+        *size = (size_t)it->value.value.blob[0];
+    }
+    return it->value.value.blob + 1;
+}
+
+const void *RERR_InfoMapIterator_GetBytes(RERR_InfoMapIterator it,
+                                          size_t *size) {
+    if (!it || it->value.type != RERR_InfoValueTypeBytes) {
+        assert(false);
+        if (size) {
+            *size = 0;
+        }
+        return NULL;
+    }
+    return IteratorBlob(it, size);
+}
+
+const int64_t *RERR_InfoMapIterator_GetI64Array(RERR_InfoMapIterator it,
+                                                size_t *count) {
+    if (!it || it->value.type != RERR_InfoValueTypeI64Array) {
+        assert(false);
+        if (count) {
+            *count = 0;
+        }
+        return NULL;
+    }
+    size_t size;
+    const int64_t *ret = IteratorBlob(it, &size);
+    if (count) {
+        *count = size / sizeof(int64_t);
+    }
+    return ret;
+}
+
+const double *RERR_InfoMapIterator_GetF64Array(RERR_InfoMapIterator it,
+                                               size_t *count) {
+    if (!it || it->value.type != RERR_InfoValueTypeF64Array) {
+        assert(false);
+        if (count) {
+            *count = 0;
+        }
+        return NULL;
+    }
+    size_t size;
+    const double *ret = IteratorBlob(it, &size);
+    if (count) {
+        *count = size / sizeof(double);
+    }
+    return ret;
+}
@@ -0,0 +1,197 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "Pool.h"
+
+#include "Alloc.h"
+#include "Threads.h"
+
+#include <stdbool.h>
+
+#ifdef RERR_USE_POOL
+
+static const size_t blockSizes[POOL_CLASS_COUNT] = {
+    POOL_ERROR_BLOCK_SIZE,
+    POOL_INFOMAP_BLOCK_SIZE,
+};
+
+#define DEFAULT_LIMIT 32
+
+struct FreeBlock {
+    struct FreeBlock *next;
+};
+
+struct FreeList {
+    struct FreeBlock *head;
+    size_t count;
+    size_t limit;
+};
+
+// Owned by a single thread, so no synchronization is needed. Blocks may be
+// freed on a different thread than the one that allocated them, in which case
+// they simply join the freeing thread's list.
+struct ThreadPool {
+    struct FreeList lists[POOL_CLASS_COUNT];
+};
+
+static ThreadLocalKey poolKey;
+static bool poolKeyCreated;
+static CallOnceFlag poolKeyInit = CALL_ONCE_FLAG_INITIALIZER;
+
+static void FreeList_Trim(struct FreeList *list, size_t count) {
+    while (list->count > count) {
+        struct FreeBlock *block = list->head;
+        list->head = block->next;
+        --list->count;
+        MemFree(block);
+    }
+}
+
+static void THREAD_LOCAL_DESTRUCTOR_CALL ThreadPool_Destroy(void *p) {
+    struct ThreadPool *pool = p;
+    for (int cls = 0; cls < POOL_CLASS_COUNT; ++cls) {
+        FreeList_Trim(&pool->lists[cls], 0);
+    }
+    MemFree(pool);
+}
+
+static void InitPoolKey(void) {
+    poolKeyCreated = CreateThreadLocalKey(&poolKey, ThreadPool_Destroy);
+}
+
+// Return the calling thread's pool, or null if it does not exist and either
+// create is false or creation failed.
+static struct ThreadPool *ThreadPool_Get(bool create) {
+    CallOnce(&poolKeyInit, InitPoolKey);
+    if (!poolKeyCreated) {
+        return NULL;
+    }
+
+    struct ThreadPool *pool = GetThreadLocal(poolKey);
+    if (pool || !create) {
+        return pool;
+    }
+
+    pool = MemCalloc(1, sizeof(struct ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+    for (int cls = 0; cls < POOL_CLASS_COUNT; ++cls) {
+        pool->lists[cls].limit = DEFAULT_LIMIT;
+    }
+    if (!SetThreadLocal(poolKey, pool)) {
+        MemFree(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void *Pool_Alloc(enum PoolClass cls, size_t size) {
+    if (size > blockSizes[cls]) {
+        return MemAlloc(size);
+    }
+    struct ThreadPool *pool = ThreadPool_Get(false);
+    if (pool && pool->lists[cls].head) {
+        struct FreeList *list = &pool->lists[cls];
+        struct FreeBlock *block = list->head;
+        list->head = block->next;
+        --list->count;
+        return block;
+    }
+    return MemAlloc(blockSizes[cls]);
+}
+
+void Pool_Free(enum PoolClass cls, void *block, size_t size) {
+    if (!block) {
+        return;
+    }
+    if (size > blockSizes[cls]) {
+        MemFree(block);
+        return;
+    }
+    struct ThreadPool *pool = ThreadPool_Get(true);
+    if (!pool || pool->lists[cls].count >= pool->lists[cls].limit) {
+        MemFree(block);
+        return;
+    }
+    struct FreeList *list = &pool->lists[cls];
+    struct FreeBlock *b = block;
+    b->next = list->head;
+    list->head = b;
+    ++list->count;
+}
+
+void RERR_Pool_SetLimits(size_t maxErrors, size_t maxInfoMaps) {
+    struct ThreadPool *pool = ThreadPool_Get(true);
+    if (!pool) {
+        return;
+    }
+    pool->lists[PoolClass_Error].limit = maxErrors;
+    pool->lists[PoolClass_InfoMap].limit = maxInfoMaps;
+    for (int cls = 0; cls < POOL_CLASS_COUNT; ++cls) {
+        FreeList_Trim(&pool->lists[cls], pool->lists[cls].limit);
+    }
+}
+
+RERR_ErrorPtr RERR_Pool_Reserve(size_t errors, size_t infoMaps) {
+    struct ThreadPool *pool = ThreadPool_Get(true);
+    if (!pool) {
+        return RERR_Error_CreateOutOfMemory();
+    }
+    const size_t counts[POOL_CLASS_COUNT] = {errors, infoMaps};
+    for (int cls = 0; cls < POOL_CLASS_COUNT; ++cls) {
+        struct FreeList *list = &pool->lists[cls];
+        if (list->limit < counts[cls]) {
+            list->limit = counts[cls];
+        }
+        while (list->count < counts[cls]) {
+            struct FreeBlock *block = MemAlloc(blockSizes[cls]);
+            if (!block) {
+                return RERR_Error_CreateOutOfMemory();
+            }
+            block->next = list->head;
+            list->head = block;
+            ++list->count;
+        }
+    }
+    return RERR_NO_ERROR;
+}
+
+void RERR_Pool_Drain(void) {
+    struct ThreadPool *pool = ThreadPool_Get(false);
+    if (!pool) {
+        return;
+    }
+    for (int cls = 0; cls < POOL_CLASS_COUNT; ++cls) {
+        FreeList_Trim(&pool->lists[cls], 0);
+    }
+}
+
+#else // RERR_USE_POOL
+
+void *Pool_Alloc(enum PoolClass cls, size_t size) {
+    (void)cls;
+    return MemAlloc(size);
+}
+
+void Pool_Free(enum PoolClass cls, void *block, size_t size) {
+    (void)cls;
+    (void)size;
+    MemFree(block);
+}
+
+void RERR_Pool_SetLimits(size_t maxErrors, size_t maxInfoMaps) {
+    (void)maxErrors;
+    (void)maxInfoMaps;
+}
+
+RERR_ErrorPtr RERR_Pool_Reserve(size_t errors, size_t infoMaps) {
+    (void)errors;
+    (void)infoMaps;
+    return RERR_NO_ERROR;
+}
+
+void RERR_Pool_Drain(void) {}
+
+#endif // RERR_USE_POOL
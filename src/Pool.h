@@ -0,0 +1,30 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+// Per-thread freelists of fixed-size blocks for frequently allocated objects.
+// When RERR_USE_POOL is not defined, blocks come directly from the heap.
+
+#include "RichErrors/RichErrors.h"
+
+#include <stddef.h>
+
+enum PoolClass {
+    PoolClass_Error,   // Error header plus short inline message
+    PoolClass_InfoMap, // Info map header
+    POOL_CLASS_COUNT,
+};
+
+#define POOL_ERROR_BLOCK_SIZE 128
+#define POOL_INFOMAP_BLOCK_SIZE 96
+
+// Return a block of at least size bytes, or null if allocation failed. Sizes
+// larger than the class's block size are allocated directly from the heap.
+void *Pool_Alloc(enum PoolClass cls, size_t size);
+
+// Release a block obtained from Pool_Alloc() (on any thread) with the same
+// class and size. A pool-sized block is kept in the calling thread's freelist
+// unless the list is full.
+void Pool_Free(enum PoolClass cls, void *block, size_t size);
@@ -4,55 +4,124 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "RichErrors/RichErrors.h"
+#include "RichErrors/Inline.h"
 
-#include "DynArray.h"
+#include "Alloc.h"
+#include "Error.h"
+#include "Pool.h"
+#include "Stats.h"
 #include "Threads.h"
 
 #include <inttypes.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// How to format codes of a domain, decoded once from its RERR_CodeFormat so
+// that RERR_Error_FormatCode() need not re-examine the flags.
+enum CodeDecimal {
+    CodeDecimal_None,
+    CodeDecimal_I32,
+    CodeDecimal_U32,
+    CodeDecimal_I16,
+    CodeDecimal_U16,
+};
+
+struct CodePlan {
+    uint8_t decimal;   // enum CodeDecimal
+    uint8_t hexDigits; // 0 (no hex), 4, or 8
+    bool hexPad;
+};
+
 struct RERR_Domain {
     const char *name; // Unique key
     RERR_CodeFormat codeFormat;
+    struct CodePlan codePlan;
 };
 typedef struct RERR_Domain *RERR_DomainPtr;
 
 static struct RERR_Domain RichErrorsCriticalDomain = {
     RERR_DOMAIN_CRITICAL,
     RERR_CodeFormat_I32,
+    {CodeDecimal_I32, 0, true},
 };
 
 static struct RERR_Domain RichErrorsDomain = {
     RERR_DOMAIN_RICHERRORS,
     RERR_CodeFormat_I32,
+    {CodeDecimal_I32, 0, true},
+};
+
+// Globally registered domains. Lookups (which occur on every creation of an
+// error with a code) do not take any lock: the registry is an immutable sorted
+// snapshot, published through an atomic pointer. Registration, which is rare,
+// copies the current snapshot with the new domain inserted and publishes the
+// copy. A superseded snapshot may still be in use by a concurrent reader, so
+// it is not freed but kept (linked from its successor) until
+// RERR_Domain_UnregisterAll(), which is only for testing and already requires
+// that nothing else be accessing domains.
+struct DomainTable {
+    struct DomainTable *retired; // Superseded snapshot, owned
+    size_t count;
+    RERR_DomainPtr domains[]; // Sorted by name; domains owned by newest table
 };
 
-// Globally registered domains. We use an array of pointers, so that domain
-// pointers always remain valid.
-static RERR_DynArrayPtr domains; // Elements are RERR_DomainPtr, sorted by key
-static Mutex domainsLock;
-static CallOnceFlag domainsLockInit = CALL_ONCE_FLAG_INITIALIZER;
-static void InitDomainsLock(void) { InitRecursiveMutex(&domainsLock); }
+static AtomicPtr domainTable; // Current struct DomainTable *, or null
+// Serializes registration (not lookup)
+static Mutex domainsLock = MUTEX_INITIALIZER;
 
 #define MAX_DOMAIN_LENGTH 63 // Not including null terminator
 
+// Wrapping a uniquely owned error places the new error in a frame arena, so
+// that a deep chain of causes occupies a few contiguous allocations rather
+// than one per error. The errors in an arena form a segment of a chain: each
+// is the cause of the next one added, and the first one added owns its cause
+// (which is outside the arena). All errors in an arena share the arena's
+// reference count, and are destroyed together.
+struct FrameArena {
+    AtomicRefCount refCount;
+    struct RERR_Error *top; // Most recently added error
+    size_t size;            // Of the whole allocation
+    size_t used;            // Offset of the free space
+};
+
+#define ARENA_INITIAL_SIZE 512
+#define ARENA_MAX_SIZE 4096
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+static inline size_t Arena_AlignUp(size_t offset) {
+    return (offset + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// An error and its message are stored in a single allocation, so that
+// creating (and destroying) an error costs one heap operation.
 struct RERR_Error {
-    const struct RERR_Domain *domain; // Non-owning ref
-    int32_t code;                     // Zero if no domain
-    const char *message;              // String owned by this RERR_Error object
+    // Domain (non-owning ref) and code; read directly by Inline.h
+    struct RERR_ErrorInlinePrefix head; // Must be first
+    // const char *: null, messageStorage, static, or rendered (if deferred).
+    // Only a deferred message is ever set after creation.
+    AtomicPtr message;
     struct RERR_Error *cause; // Original error, owned by this RERR_Error
     RERR_InfoMapPtr info;
-    uint32_t refCount;
+    AtomicRefCount refCount;         // Unused if in an arena
+    struct FrameArena *arena;        // Non-null if allocated in an arena
+    RERR_MessageFormatter formatter; // Non-null iff message is deferred
+    // Null-terminated message (allocated only if copied), or, if deferred,
+    // the size_t size of the formatter arguments and then the arguments.
+    char messageStorage[];
 };
 
+_Static_assert(sizeof(struct RERR_Error) + 64 <= POOL_ERROR_BLOCK_SIZE,
+               "Pool block too small for error with short message");
+_Static_assert(offsetof(struct RERR_Error, head) == 0,
+               "Inline.h requires the prefix at the start of the error");
+
 // Special value we use so that we can return "out of memory" errors without
 // allocating anything. All functions that inspect struct RERR_Error must check
 // for this value first.
-#define RERR_OUT_OF_MEMORY ((RERR_ErrorPtr)-1)
-
-static inline void FreeConst(const void *m) { free((void *)m); }
+#define RERR_OUT_OF_MEMORY RERR_INLINE_OUT_OF_MEMORY
 
 static RERR_ErrorPtr CodeFormat_Check(RERR_CodeFormat format) {
     switch (format & ~RERR_CodeFormat_HexNoPad) {
@@ -74,6 +143,27 @@ static RERR_ErrorPtr CodeFormat_Check(RERR_CodeFormat format) {
                                      "Invalid error code format");
 }
 
+// Precondition: format has passed CodeFormat_Check()
+static struct CodePlan CodePlan_Make(RERR_CodeFormat format) {
+    struct CodePlan plan = {CodeDecimal_None, 0, true};
+    if (format & RERR_CodeFormat_I32) {
+        plan.decimal = CodeDecimal_I32;
+    } else if (format & RERR_CodeFormat_U32) {
+        plan.decimal = CodeDecimal_U32;
+    } else if (format & RERR_CodeFormat_I16) {
+        plan.decimal = CodeDecimal_I16;
+    } else if (format & RERR_CodeFormat_U16) {
+        plan.decimal = CodeDecimal_U16;
+    }
+    if (format & RERR_CodeFormat_Hex32) {
+        plan.hexDigits = 8;
+    } else if (format & RERR_CodeFormat_Hex16) {
+        plan.hexDigits = 4;
+    }
+    plan.hexPad = !(format & RERR_CodeFormat_HexNoPad);
+    return plan;
+}
+
 // Precondition: domainName != NULL
 static RERR_ErrorPtr Domain_Check(const char *domainName) {
     if (domainName[0] == '\0') {
@@ -106,10 +196,20 @@ static RERR_ErrorPtr Domain_Check(const char *domainName) {
     return RERR_NO_ERROR;
 }
 
-static int Domain_Compare(const void *lhs, const void *rhs) {
-    const char *rhs_charp = rhs;
-    RERR_DomainPtr elem = *(const RERR_DomainPtr *)lhs;
-    return strcmp(elem->name, rhs_charp);
+// Returns index of first domain whose name is not less than domainName
+static size_t Domain_LowerBound(const struct DomainTable *table,
+                                const char *domainName) {
+    size_t left = 0;
+    size_t right = table->count;
+    while (left < right) {
+        size_t middle = left + (right - left) / 2;
+        if (strcmp(table->domains[middle]->name, domainName) < 0) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    return left;
 }
 
 // Argument must be pre-checked by caller
@@ -122,18 +222,16 @@ static RERR_DomainPtr Domain_Find(const char *domainName) {
         return &RichErrorsDomain;
     }
 
-    CallOnce(&domainsLockInit, InitDomainsLock);
-    LockMutex(&domainsLock);
-
-    RERR_DomainPtr *found = NULL;
-    if (domains) {
-        found = RERR_DynArray_BSearch(domains, domainName, Domain_Compare);
+    const struct DomainTable *table = AtomicLoadPtrAcquire(&domainTable);
+    if (!table) {
+        return NULL;
     }
-    RERR_DomainPtr ret = found ? *found : NULL;
-
-    UnlockMutex(&domainsLock);
 
-    return ret;
+    size_t i = Domain_LowerBound(table, domainName);
+    if (i < table->count && strcmp(table->domains[i]->name, domainName) == 0) {
+        return table->domains[i];
+    }
+    return NULL;
 }
 
 static RERR_DomainPtr Domain_Create(const char *name,
@@ -141,23 +239,24 @@ static RERR_DomainPtr Domain_Create(const char *name,
     char *nameCopy = NULL;
     RERR_DomainPtr ret = NULL;
 
-    nameCopy = malloc(strlen(name) + 1);
+    nameCopy = MemAlloc(strlen(name) + 1);
     if (!nameCopy) {
         goto error;
     }
     strcpy(nameCopy, name);
 
-    ret = calloc(1, sizeof(struct RERR_Domain));
+    ret = MemCalloc(1, sizeof(struct RERR_Domain));
     if (!ret) {
         goto error;
     }
     ret->name = nameCopy;
     ret->codeFormat = codeFormat;
+    ret->codePlan = CodePlan_Make(codeFormat);
     return ret;
 
 error:
-    free(ret);
-    free(nameCopy);
+    MemFree(ret);
+    MemFree(nameCopy);
     return NULL;
 }
 
@@ -166,48 +265,57 @@ static void Domain_Destroy(RERR_DomainPtr domain) {
         return;
     }
 
-    FreeConst(domain->name);
-    free(domain);
+    MemFreeConst(domain->name);
+    MemFree(domain);
 }
 
 // Mutex must be held by caller; domain != NULL
 static RERR_ErrorPtr Domain_Insert(RERR_DomainPtr domain) {
-    if (!domains) {
-        domains = RERR_DynArray_Create(sizeof(RERR_DomainPtr));
-        if (!domains) {
-            return RERR_OUT_OF_MEMORY;
-        }
-    }
+    struct DomainTable *current = AtomicLoadPtrAcquire(&domainTable);
+    size_t count = current ? current->count : 0;
+    size_t pos = current ? Domain_LowerBound(current, domain->name) : 0;
 
-    RERR_DomainPtr *it = RERR_DynArray_BSearchInsertionPoint(
-        domains, domain->name, Domain_Compare);
-    it = RERR_DynArray_Insert(domains, it);
-    if (!it) {
+    struct DomainTable *table = MemAlloc(sizeof(struct DomainTable) +
+                                       (count + 1) * sizeof(RERR_DomainPtr));
+    if (!table) {
         return RERR_OUT_OF_MEMORY;
     }
-    *it = domain;
+    table->retired = current;
+    table->count = count + 1;
+    if (current) {
+        memcpy(table->domains, current->domains,
+               pos * sizeof(RERR_DomainPtr));
+        memcpy(table->domains + pos + 1, current->domains + pos,
+               (count - pos) * sizeof(RERR_DomainPtr));
+    }
+    table->domains[pos] = domain;
+    Stats_Add(StatsCounter_DomainsRegistered, 1);
+
+    // Readers that see the new table also see its fully initialized contents.
+    AtomicStorePtrRelease(&domainTable, table);
     return RERR_NO_ERROR;
 }
 
 void RERR_Domain_UnregisterAll(void) {
-    CallOnce(&domainsLockInit, InitDomainsLock);
     LockMutex(&domainsLock);
 
-    if (!domains) {
-        return;
-    }
+    struct DomainTable *table = AtomicLoadPtrAcquire(&domainTable);
+    AtomicStorePtrRelease(&domainTable, NULL);
 
-    RERR_DomainPtr *begin = RERR_DynArray_Begin(domains);
-    RERR_DomainPtr *end = RERR_DynArray_End(domains);
-    for (RERR_DomainPtr *it = begin; it != end;
-         it = RERR_DynArray_Advance(domains, it)) {
-        Domain_Destroy(*it);
+    if (table) {
+        for (size_t i = 0; i < table->count; ++i) {
+            Domain_Destroy(table->domains[i]);
+        }
+        Stats_Add(StatsCounter_DomainsRegistered, -(long long)table->count);
     }
 
     // Actually we only need to clear, but we deallocate so that memory leak
-    // detection in unit tests will not see the leftover static array.
-    RERR_DynArray_Destroy(domains);
-    domains = NULL;
+    // detection in unit tests will not see the leftover snapshots.
+    while (table) {
+        struct DomainTable *retired = table->retired;
+        MemFree(table);
+        table = retired;
+    }
 
     UnlockMutex(&domainsLock);
 }
@@ -235,7 +343,6 @@ RERR_ErrorPtr RERR_Domain_Register(const char *domainName,
     }
 
     RERR_ErrorPtr ret = RERR_NO_ERROR;
-    CallOnce(&domainsLockInit, InitDomainsLock);
     LockMutex(&domainsLock);
 
     const struct RERR_Domain *found = Domain_Find(domainName);
@@ -261,41 +368,195 @@ cleanup:
     return ret;
 }
 
-RERR_ErrorPtr RERR_Error_Create(const char *message) {
-    RERR_ErrorPtr ret = calloc(1, sizeof(struct RERR_Error));
-    if (!ret) {
-        return RERR_OUT_OF_MEMORY;
+RERR_ErrorPtr RERR_Domain_Lookup(const char *domainName,
+                                 RERR_DomainHandle *handle) {
+    if (handle) {
+        *handle = NULL;
+    }
+    if (!domainName || !handle) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_NULL_ARGUMENT,
+                                         "Null argument to domain lookup");
+    }
+    RERR_ErrorPtr err = Domain_Check(domainName);
+    if (err) {
+        return err;
+    }
+
+    *handle = Domain_Find(domainName);
+    if (!*handle) {
+        char msg0[] = "Error domain not registered: ";
+        char msg[sizeof(msg0) + MAX_DOMAIN_LENGTH + 32];
+        strcpy(msg, msg0);
+        strcat(msg, domainName);
+        return RERR_Error_CreateWithCode(
+            RERR_DOMAIN_RICHERRORS, RERR_ECODE_DOMAIN_NOT_REGISTERED, msg);
+    }
+    return RERR_NO_ERROR;
+}
+
+#define DEFERRED_ARGS_ALIGN _Alignof(max_align_t)
+
+static inline size_t Deferred_StorageSize(size_t argsSize) {
+    return sizeof(size_t) + DEFERRED_ARGS_ALIGN - 1 + argsSize;
+}
+
+// Precondition: error has a deferred message
+static inline size_t Deferred_ArgsSize(RERR_ErrorPtr error) {
+    size_t argsSize;
+    memcpy(&argsSize, error->messageStorage, sizeof(argsSize));
+    return argsSize;
+}
+
+// Precondition: error has a deferred message
+static inline void *Deferred_Args(RERR_ErrorPtr error) {
+    uintptr_t addr = (uintptr_t)(error->messageStorage + sizeof(size_t));
+    addr = (addr + DEFERRED_ARGS_ALIGN - 1) &
+           ~(uintptr_t)(DEFERRED_ARGS_ALIGN - 1);
+    return (void *)addr;
+}
+
+// Precondition: error is not a sentinel
+static inline size_t Error_AllocSize(RERR_ErrorPtr error) {
+    size_t size = sizeof(struct RERR_Error);
+    if (error->formatter) {
+        size += Deferred_StorageSize(Deferred_ArgsSize(error));
+    } else if (AtomicLoadPtrAcquire(&error->message) ==
+               error->messageStorage) {
+        size += strlen(error->messageStorage) + 1;
     }
+    return size;
+}
+
+static inline size_t MessageLen(const char *message) {
+    return message ? strlen(message) : 0;
+}
 
-    if (message) {
-        size_t len = strlen(message);
-        // We allocate the message even if empty, so that we retain the
-        // information that an empty message was used (to help debugging).
-        char *msgCopy = malloc(len + 1);
-        if (!msgCopy) {
-            free(ret);
-            return RERR_OUT_OF_MEMORY;
+static inline AtomicRefCount *Error_RefCount(RERR_ErrorPtr error) {
+    return error->arena ? &error->arena->refCount : &error->refCount;
+}
+
+// Allocate size bytes for an error that will wrap the uniquely owned cause,
+// in the cause's arena if it is the arena's top and there is room, otherwise
+// in a new arena. Return null if a separate allocation should be used.
+static RERR_ErrorPtr Arena_AllocFrame(RERR_ErrorPtr cause, size_t size,
+                                      struct FrameArena **arena) {
+    struct FrameArena *a = cause->arena;
+    size_t arenaSize = ARENA_INITIAL_SIZE;
+    if (a) {
+        if (a->top == cause && Arena_AlignUp(a->used) + size <= a->size) {
+            RERR_ErrorPtr ret =
+                (RERR_ErrorPtr)((char *)a + Arena_AlignUp(a->used));
+            a->used = Arena_AlignUp(a->used) + size;
+            a->top = ret;
+            *arena = a;
+            return ret;
         }
-        strcpy(msgCopy, message);
-        ret->message = msgCopy;
+        arenaSize = a->size < ARENA_MAX_SIZE ? 2 * a->size : ARENA_MAX_SIZE;
+    } else if (!cause->cause) {
+        // Most chains are shallow; do not start an arena for the first wrap.
+        return NULL;
+    }
+
+    size_t offset = Arena_AlignUp(sizeof(struct FrameArena));
+    if (size > arenaSize - offset) {
+        return NULL;
+    }
+    a = MemAlloc(arenaSize);
+    if (!a) {
+        return NULL;
     }
+    AtomicRefCountInit(&a->refCount, 1);
+    a->top = (RERR_ErrorPtr)((char *)a + offset);
+    a->size = arenaSize;
+    a->used = offset + size;
+    *arena = a;
+    return a->top;
+}
 
-    ++ret->refCount;
+// Return a new error with refCount 1 and no message, or null. If wrapping is
+// not null, it is the cause to be attached to the new error.
+static RERR_ErrorPtr Error_Alloc(RERR_ErrorPtr wrapping, size_t storageSize) {
+    size_t size = sizeof(struct RERR_Error) + storageSize;
+    RERR_ErrorPtr ret = NULL;
+    struct FrameArena *arena = NULL;
+    if (wrapping && wrapping != RERR_OUT_OF_MEMORY &&
+        AtomicRefCountIsOne(Error_RefCount(wrapping))) {
+        ret = Arena_AllocFrame(wrapping, size, &arena);
+    }
+    if (!ret) {
+        ret = Pool_Alloc(PoolClass_Error, size);
+    }
+    if (!ret) {
+        return NULL;
+    }
+    memset(ret, 0, sizeof(struct RERR_Error));
+    ret->arena = arena;
+    AtomicInitPtr(&ret->message, NULL);
+    AtomicRefCountInit(&ret->refCount, 1);
+    Stats_Created(StatsCounter_ErrorsLive, StatsCounter_ErrorsCreated);
     return ret;
 }
 
-RERR_ErrorPtr RERR_Error_CreateWithCode(const char *domainName, int32_t code,
-                                        const char *message) {
-    // Allow NULL (but not empty string) for domain, as long as code is zero.
-    if (!domainName) {
+// If copyMessage is false, message must be null or have static lifetime and
+// messageLen is ignored; otherwise messageLen characters are copied.
+static RERR_ErrorPtr Error_Create(RERR_ErrorPtr wrapping,
+                                  const char *message, size_t messageLen,
+                                  bool copyMessage) {
+    // We store the message even if empty, so that we retain the information
+    // that an empty message was used (to help debugging).
+    size_t msgSize = message && copyMessage ? messageLen + 1 : 0;
+
+    RERR_ErrorPtr ret = Error_Alloc(wrapping, msgSize);
+    if (!ret) {
+        return RERR_OUT_OF_MEMORY;
+    }
+
+    if (message && copyMessage) {
+        memcpy(ret->messageStorage, message, messageLen);
+        ret->messageStorage[messageLen] = '\0';
+        AtomicInitPtr(&ret->message, ret->messageStorage);
+    } else {
+        AtomicInitPtr(&ret->message, (void *)message);
+    }
+    return ret;
+}
+
+static RERR_ErrorPtr Error_CreateWithDomainHandle(RERR_ErrorPtr wrapping,
+                                                  RERR_DomainHandle domain,
+                                                  int32_t code,
+                                                  const char *message,
+                                                  size_t messageLen,
+                                                  bool copyMessage) {
+    if (!domain) {
         if (code == 0) {
-            return RERR_Error_Create(message);
+            return Error_Create(wrapping, message, messageLen, copyMessage);
         }
         return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
                                          RERR_ECODE_NULL_ARGUMENT,
                                          "Null error domain");
     }
 
+    RERR_ErrorPtr ret =
+        Error_Create(wrapping, message, messageLen, copyMessage);
+    if (ret != RERR_OUT_OF_MEMORY) {
+        ret->head.domain = domain;
+        ret->head.code = code;
+    }
+    return ret;
+}
+
+static RERR_ErrorPtr Error_CreateWithCode(RERR_ErrorPtr wrapping,
+                                          const char *domainName, int32_t code,
+                                          const char *message,
+                                          size_t messageLen,
+                                          bool copyMessage) {
+    // Allow NULL (but not empty string) for domain, as long as code is zero.
+    if (!domainName) {
+        return Error_CreateWithDomainHandle(wrapping, NULL, code, message,
+                                            messageLen, copyMessage);
+    }
+
     RERR_ErrorPtr err = Domain_Check(domainName);
     if (err) {
         return err;
@@ -311,18 +572,115 @@ RERR_ErrorPtr RERR_Error_CreateWithCode(const char *domainName, int32_t code,
             RERR_DOMAIN_RICHERRORS, RERR_ECODE_DOMAIN_NOT_REGISTERED, msg);
     }
 
-    RERR_ErrorPtr ret = RERR_Error_Create(message);
-    if (ret != RERR_OUT_OF_MEMORY) {
-        ret->domain = d;
-        ret->code = code;
+    return Error_CreateWithDomainHandle(wrapping, d, code, message,
+                                        messageLen, copyMessage);
+}
+
+static RERR_ErrorPtr Error_CreateDeferred(RERR_ErrorPtr wrapping,
+                                          RERR_DomainHandle domain,
+                                          int32_t code,
+                                          RERR_MessageFormatter formatter,
+                                          const void *args, size_t argsSize) {
+    if (!formatter || (!args && argsSize > 0)) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_NULL_ARGUMENT,
+                                         "Null message formatter or args");
+    }
+    if (!domain && code != 0) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_NULL_ARGUMENT,
+                                         "Null error domain");
+    }
+    if (argsSize > SIZE_MAX - sizeof(struct RERR_Error) -
+                       Deferred_StorageSize(0)) {
+        return RERR_OUT_OF_MEMORY;
+    }
+
+    RERR_ErrorPtr ret = Error_Alloc(wrapping, Deferred_StorageSize(argsSize));
+    if (!ret) {
+        return RERR_OUT_OF_MEMORY;
+    }
+    ret->head.domain = domain;
+    ret->head.code = code;
+    ret->formatter = formatter;
+    memcpy(ret->messageStorage, &argsSize, sizeof(argsSize));
+    if (argsSize > 0) {
+        memcpy(Deferred_Args(ret), args, argsSize);
     }
     return ret;
 }
 
-RERR_ErrorPtr RERR_Error_CreateWithInfo(const char *domainName, int32_t code,
-                                        RERR_InfoMapPtr info,
+// Takes ownership of cause, which is destroyed if error is out-of-memory
+static RERR_ErrorPtr Error_AttachCause(RERR_ErrorPtr error,
+                                       RERR_ErrorPtr cause) {
+    if (error == RERR_OUT_OF_MEMORY) {
+        RERR_Error_Destroy(cause);
+        return error;
+    }
+    error->cause = cause;
+    return error;
+}
+
+RERR_ErrorPtr RERR_Error_Create(const char *message) {
+    return Error_Create(NULL, message, MessageLen(message), true);
+}
+
+RERR_ErrorPtr RERR_Error_CreateN(const char *message, size_t messageLen) {
+    return Error_Create(NULL, message, messageLen, true);
+}
+
+RERR_ErrorPtr RERR_Error_CreateStatic(const char *message) {
+    return Error_Create(NULL, message, 0, false);
+}
+
+RERR_ErrorPtr RERR_Error_CreateWithCode(const char *domainName, int32_t code,
+                                        const char *message) {
+    return Error_CreateWithCode(NULL, domainName, code, message,
+                                MessageLen(message), true);
+}
+
+RERR_ErrorPtr RERR_Error_CreateWithCodeN(const char *domainName, int32_t code,
+                                         const char *message,
+                                         size_t messageLen) {
+    return Error_CreateWithCode(NULL, domainName, code, message, messageLen,
+                                true);
+}
+
+RERR_ErrorPtr RERR_Error_CreateWithCodeStatic(const char *domainName,
+                                              int32_t code,
+                                              const char *message) {
+    return Error_CreateWithCode(NULL, domainName, code, message, 0, false);
+}
+
+RERR_ErrorPtr RERR_Error_CreateWithDomainHandle(RERR_DomainHandle domain,
+                                                int32_t code,
+                                                const char *message) {
+    return Error_CreateWithDomainHandle(NULL, domain, code, message,
+                                        MessageLen(message), true);
+}
+
+RERR_ErrorPtr RERR_Error_CreateWithDomainHandleN(RERR_DomainHandle domain,
+                                                 int32_t code,
+                                                 const char *message,
+                                                 size_t messageLen) {
+    return Error_CreateWithDomainHandle(NULL, domain, code, message,
+                                        messageLen, true);
+}
+
+RERR_ErrorPtr
+RERR_Error_CreateWithDomainHandleStatic(RERR_DomainHandle domain, int32_t code,
                                         const char *message) {
-    RERR_ErrorPtr ret = RERR_Error_CreateWithCode(domainName, code, message);
+    return Error_CreateWithDomainHandle(NULL, domain, code, message, 0,
+                                        false);
+}
+
+static RERR_ErrorPtr Error_CreateWithInfo(RERR_ErrorPtr wrapping,
+                                          const char *domainName, int32_t code,
+                                          RERR_InfoMapPtr info,
+                                          const char *message,
+                                          size_t messageLen) {
+    RERR_ErrorPtr ret = Error_CreateWithCode(wrapping, domainName, code,
+                                             message, messageLen, true);
 
     // We treat empty info map the same as no info map.
     if (RERR_InfoMap_IsEmpty(info)) { // Includes info == NULL
@@ -337,8 +695,9 @@ RERR_ErrorPtr RERR_Error_CreateWithInfo(const char *domainName, int32_t code,
     // If there was an error while creating the error, the info no longer
     // pertains to the error to be returned. Since we have ownership anyway,
     // destroy it.
-    if (ret == RERR_OUT_OF_MEMORY || !ret->domain ||
-        strcmp(ret->domain->name, domainName) != 0 || ret->code != code) {
+    if (ret == RERR_OUT_OF_MEMORY || !ret->head.domain ||
+        strcmp(ret->head.domain->name, domainName) != 0 ||
+        ret->head.code != code) {
         goto exit;
     }
 
@@ -349,14 +708,83 @@ exit:
     return ret;
 }
 
-void RERR_Error_Destroy(RERR_ErrorPtr error) {
-    if (!error || error == RERR_OUT_OF_MEMORY)
-        return;
+RERR_ErrorPtr RERR_Error_CreateWithInfo(const char *domainName, int32_t code,
+                                        RERR_InfoMapPtr info,
+                                        const char *message) {
+    return Error_CreateWithInfo(NULL, domainName, code, info, message,
+                                MessageLen(message));
+}
+
+RERR_ErrorPtr RERR_Error_CreateWithInfoN(const char *domainName, int32_t code,
+                                         RERR_InfoMapPtr info,
+                                         const char *message,
+                                         size_t messageLen) {
+    return Error_CreateWithInfo(NULL, domainName, code, info, message,
+                                messageLen);
+}
+
+RERR_ErrorPtr Error_CreateFromParts(RERR_DomainHandle domain, int32_t code,
+                                    const char *message, size_t messageLen,
+                                    bool copyMessage, RERR_InfoMapPtr info) {
+    RERR_ErrorPtr ret = Error_CreateWithDomainHandle(
+        NULL, domain, code, message, messageLen, copyMessage);
+    if (ret == RERR_OUT_OF_MEMORY || !domain ||
+        RERR_InfoMap_IsEmpty(info)) {
+        RERR_InfoMap_Destroy(info);
+        return ret;
+    }
+    RERR_InfoMap_MakeImmutable(info);
+    ret->info = info;
+    return ret;
+}
+
+void Error_SetCause(RERR_ErrorPtr error, RERR_ErrorPtr cause) {
+    error->cause = cause;
+}
+
+// Release what error owns, other than its cause and its own memory.
+static void Error_Finalize(RERR_ErrorPtr error) {
+    RERR_InfoMap_Destroy(error->info);
+    if (error->formatter) {
+        MemFree(AtomicLoadPtrAcquire(&error->message));
+    }
+    Stats_Destroyed(StatsCounter_ErrorsLive);
+}
 
-    if (--error->refCount == 0) {
-        free((char *)error->message);
-        RERR_Error_Destroy(error->cause);
-        free(error);
+// Destroy all errors in the arena; return the cause of the first one added.
+static RERR_ErrorPtr Arena_Destroy(struct FrameArena *arena) {
+    RERR_ErrorPtr error = arena->top;
+    for (;;) {
+        RERR_ErrorPtr cause = error->cause;
+        Error_Finalize(error);
+        if (!cause || cause == RERR_OUT_OF_MEMORY || cause->arena != arena) {
+            MemFree(arena);
+            return cause;
+        }
+        error = cause;
+    }
+}
+
+void RERR_Error_Destroy(RERR_ErrorPtr error) {
+    // Iterate rather than recurse, so that deep chains cannot overflow the
+    // stack.
+    while (error && error != RERR_OUT_OF_MEMORY) {
+        RERR_ErrorPtr cause;
+        if (error->arena) {
+            if (!AtomicRefCountDecrement(&error->arena->refCount)) {
+                return;
+            }
+            cause = Arena_Destroy(error->arena);
+        } else {
+            if (!AtomicRefCountDecrement(&error->refCount)) {
+                return;
+            }
+            cause = error->cause;
+            size_t size = Error_AllocSize(error); // Includes message storage
+            Error_Finalize(error);
+            Pool_Free(PoolClass_Error, error, size);
+        }
+        error = cause;
     }
 }
 
@@ -367,48 +795,126 @@ void RERR_Error_Copy(RERR_ErrorPtr source, RERR_ErrorPtr *destination) {
         return;
     }
 
-    ++source->refCount;
+    AtomicRefCountIncrement(Error_RefCount(source));
     return;
 }
 
 RERR_ErrorPtr RERR_Error_CreateOutOfMemory(void) { return RERR_OUT_OF_MEMORY; }
 
 RERR_ErrorPtr RERR_Error_Wrap(RERR_ErrorPtr cause, const char *message) {
-    RERR_ErrorPtr ret = RERR_Error_Create(message);
-    if (ret == RERR_OUT_OF_MEMORY) {
-        RERR_Error_Destroy(cause);
-        return ret;
-    }
-    ret->cause = cause;
-    return ret;
+    return Error_AttachCause(
+        Error_Create(cause, message, MessageLen(message), true), cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapN(RERR_ErrorPtr cause, const char *message,
+                               size_t messageLen) {
+    return Error_AttachCause(Error_Create(cause, message, messageLen, true),
+                             cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapStatic(RERR_ErrorPtr cause,
+                                    const char *message) {
+    return Error_AttachCause(Error_Create(cause, message, 0, false), cause);
 }
 
 RERR_ErrorPtr RERR_Error_WrapWithCode(RERR_ErrorPtr cause,
                                       const char *domainName, int32_t code,
                                       const char *message) {
-    RERR_ErrorPtr ret = RERR_Error_CreateWithCode(domainName, code, message);
-    if (ret == RERR_OUT_OF_MEMORY) {
-        RERR_Error_Destroy(cause);
-        return ret;
-    }
-    ret->cause = cause;
-    return ret;
+    return Error_AttachCause(Error_CreateWithCode(cause, domainName, code,
+                                                  message, MessageLen(message),
+                                                  true),
+                             cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapWithCodeN(RERR_ErrorPtr cause,
+                                       const char *domainName, int32_t code,
+                                       const char *message,
+                                       size_t messageLen) {
+    return Error_AttachCause(
+        Error_CreateWithCode(cause, domainName, code, message, messageLen,
+                             true),
+        cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapWithCodeStatic(RERR_ErrorPtr cause,
+                                            const char *domainName,
+                                            int32_t code,
+                                            const char *message) {
+    return Error_AttachCause(
+        Error_CreateWithCode(cause, domainName, code, message, 0, false),
+        cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapWithDomainHandle(RERR_ErrorPtr cause,
+                                              RERR_DomainHandle domain,
+                                              int32_t code,
+                                              const char *message) {
+    return Error_AttachCause(
+        Error_CreateWithDomainHandle(cause, domain, code, message,
+                                     MessageLen(message), true),
+        cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapWithDomainHandleN(RERR_ErrorPtr cause,
+                                               RERR_DomainHandle domain,
+                                               int32_t code,
+                                               const char *message,
+                                               size_t messageLen) {
+    return Error_AttachCause(
+        Error_CreateWithDomainHandle(cause, domain, code, message, messageLen,
+                                     true),
+        cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapWithDomainHandleStatic(RERR_ErrorPtr cause,
+                                                    RERR_DomainHandle domain,
+                                                    int32_t code,
+                                                    const char *message) {
+    return Error_AttachCause(
+        Error_CreateWithDomainHandle(cause, domain, code, message, 0, false),
+        cause);
 }
 
 RERR_ErrorPtr RERR_Error_WrapWithInfo(RERR_ErrorPtr cause,
                                       const char *domainName, int32_t code,
                                       RERR_InfoMapPtr info,
                                       const char *message) {
-    RERR_ErrorPtr ret =
-        RERR_Error_CreateWithInfo(domainName, code, info, message);
-    if (ret == RERR_OUT_OF_MEMORY) {
-        RERR_Error_Destroy(cause);
-        return ret;
-    }
-    ret->cause = cause;
-    return ret;
+    return Error_AttachCause(Error_CreateWithInfo(cause, domainName, code,
+                                                  info, message,
+                                                  MessageLen(message)),
+                             cause);
+}
+
+RERR_ErrorPtr RERR_Error_WrapWithInfoN(RERR_ErrorPtr cause,
+                                       const char *domainName, int32_t code,
+                                       RERR_InfoMapPtr info,
+                                       const char *message,
+                                       size_t messageLen) {
+    return Error_AttachCause(
+        Error_CreateWithInfo(cause, domainName, code, info, message,
+                             messageLen),
+        cause);
+}
+
+RERR_ErrorPtr RERR_Error_CreateDeferred(RERR_DomainHandle domain,
+                                        int32_t code,
+                                        RERR_MessageFormatter formatter,
+                                        const void *args, size_t argsSize) {
+    return Error_CreateDeferred(NULL, domain, code, formatter, args,
+                                argsSize);
+}
+
+RERR_ErrorPtr RERR_Error_WrapDeferred(RERR_ErrorPtr cause,
+                                      RERR_DomainHandle domain, int32_t code,
+                                      RERR_MessageFormatter formatter,
+                                      const void *args, size_t argsSize) {
+    return Error_AttachCause(
+        Error_CreateDeferred(cause, domain, code, formatter, args, argsSize),
+        cause);
 }
 
+int RERR_Inline_GetABIVersion(void) { return RERR_INLINE_ABI_VERSION; }
+
 bool RERR_Error_HasCode(RERR_ErrorPtr error) {
     if (!error) {
         return false;
@@ -416,7 +922,7 @@ bool RERR_Error_HasCode(RERR_ErrorPtr error) {
     if (error == RERR_OUT_OF_MEMORY) {
         return true;
     }
-    return error->domain != NULL;
+    return error->head.domain != NULL;
 }
 
 const char *RERR_Error_GetDomain(RERR_ErrorPtr error) {
@@ -426,10 +932,10 @@ const char *RERR_Error_GetDomain(RERR_ErrorPtr error) {
     if (error == RERR_OUT_OF_MEMORY) {
         return RERR_DOMAIN_CRITICAL;
     }
-    if (!error->domain) {
+    if (!error->head.domain) {
         return "";
     }
-    return error->domain->name;
+    return error->head.domain->name;
 }
 
 int32_t RERR_Error_GetCode(RERR_ErrorPtr error) {
@@ -439,111 +945,170 @@ int32_t RERR_Error_GetCode(RERR_ErrorPtr error) {
     if (error == RERR_OUT_OF_MEMORY) {
         return RERR_ECODE_OUT_OF_MEMORY;
     }
-    return error->code;
+    return error->head.code;
 }
 
-void RERR_Error_FormatCode(RERR_ErrorPtr error, char *dest, size_t destSize) {
-    if (!dest || destSize == 0) {
-        return;
+static const char DigitPairs[] = "00010203040506070809"
+                                "10111213141516171819"
+                                "20212223242526272829"
+                                "30313233343536373839"
+                                "40414243444546474849"
+                                "50515253545556575859"
+                                "60616263646566676869"
+                                "70717273747576777879"
+                                "80818283848586878889"
+                                "90919293949596979899";
+
+// Write the decimal digits of value ending just before end; return the start.
+static char *FormatDecimal(uint32_t value, char *end) {
+    char *p = end;
+    while (value >= 100) {
+        unsigned pair = (value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, DigitPairs + pair, 2);
     }
-
-    if (error == RERR_NO_ERROR) {
-        strncpy(dest, "(no code)", destSize);
-        dest[destSize - 1] = '\0';
-        return;
-    }
-
-    const struct RERR_Domain *domain;
-    int32_t code;
-    if (error == RERR_OUT_OF_MEMORY) {
-        domain = &RichErrorsCriticalDomain;
-        code = RERR_ECODE_OUT_OF_MEMORY;
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, DigitPairs + value * 2, 2);
     } else {
-        domain = error->domain;
-        code = error->code;
-    }
-
-    if (domain == NULL) {
-        strncpy(dest, "(no code)", destSize);
-        dest[destSize - 1] = '\0';
-        return;
+        *--p = (char)('0' + value);
     }
+    return p;
+}
 
-    RERR_CodeFormat format = domain->codeFormat;
+// Format code into buf (which must hold at least
+// #RERR_FORMATTED_CODE_MAX_SIZE bytes), without null terminator. Return the
+// total length and set *primaryLen to the length of the part before the
+// parenthesized secondary (if any).
+static size_t FormatCodeWithPlan(struct CodePlan plan, int32_t code,
+                                 char *buf, size_t *primaryLen) {
+    static const char hexDigits[] = "0123456789abcdef";
+
+    char *p = buf;
+    if (plan.decimal != CodeDecimal_None) {
+        uint32_t magnitude;
+        bool negative = false;
+        switch (plan.decimal) {
+        case CodeDecimal_I32:
+            negative = code < 0;
+            magnitude = negative ? 0U - (uint32_t)code : (uint32_t)code;
+            break;
+        case CodeDecimal_U32:
+            magnitude = (uint32_t)code;
+            break;
+        case CodeDecimal_I16: {
+            int16_t c16 = (int16_t)code;
+            negative = c16 < 0;
+            magnitude = (uint32_t)(negative ? -(int32_t)c16 : c16);
+            break;
+        }
+        default: // CodeDecimal_U16
+            magnitude = (uint16_t)code;
+            break;
+        }
 
-    // The format has been checked upon domain registration, so we assume it
-    // has a valid combination of flags. See CodeFormat_Check().
+        char digits[10]; // Max: strlen("4294967295")
+        char *end = digits + sizeof(digits);
+        char *start = FormatDecimal(magnitude, end);
+        if (negative) {
+            *p++ = '-';
+        }
+        memcpy(p, start, (size_t)(end - start));
+        p += end - start;
+    }
 
-    char dec[16]; // Max: strlen("-2147483648") == 11
-    char hex[16]; // Max: strlen("0xffffffff") == 10
-    dec[0] = '\0';
-    hex[0] = '\0';
+    *primaryLen = (size_t)(p - buf);
+    if (plan.hexDigits == 0) {
+        return *primaryLen;
+    }
 
-    if (format & RERR_CodeFormat_I32) {
-        snprintf(dec, sizeof(dec), "%" PRId32, code);
+    bool secondary = p != buf;
+    if (secondary) {
+        *p++ = ' ';
+        *p++ = '(';
     }
-    if (format & RERR_CodeFormat_U32) {
-        snprintf(dec, sizeof(dec), "%" PRIu32, code);
+    *p++ = '0';
+    *p++ = 'x';
+
+    uint32_t value = (uint32_t)code;
+    if (plan.hexDigits == 4) {
+        value &= 0xffff;
     }
-    if (format & RERR_CodeFormat_Hex32) {
-        const char *const fmt =
-            format & RERR_CodeFormat_HexNoPad ? "0x%" PRIx32 : "0x%08" PRIx32;
-        snprintf(hex, sizeof(hex), fmt, code);
+    unsigned nDigits = plan.hexDigits;
+    if (!plan.hexPad) {
+        nDigits = 1;
+        while (nDigits < plan.hexDigits && (value >> (nDigits * 4)) != 0) {
+            ++nDigits;
+        }
     }
-    if (format & RERR_CodeFormat_I16) {
-        snprintf(dec, sizeof(dec), "%" PRId16, (int16_t)code);
+    for (unsigned i = nDigits; i > 0; --i) {
+        *p++ = hexDigits[(value >> ((i - 1) * 4)) & 0xf];
     }
-    if (format & RERR_CodeFormat_U16) {
-        snprintf(dec, sizeof(dec), "%" PRIu16, (uint16_t)code);
+
+    if (secondary) {
+        *p++ = ')';
+    } else {
+        *primaryLen = (size_t)(p - buf);
     }
-    if (format & RERR_CodeFormat_Hex16) {
-        const char *const fmt =
-            format & RERR_CodeFormat_HexNoPad ? "0x%" PRIx16 : "0x%04" PRIx16;
-        snprintf(hex, sizeof(hex), fmt, (uint16_t)code);
+    return (size_t)(p - buf);
+}
+
+// Copy src to dest, truncating if necessary, and return the copied length.
+// Precondition: destSize > 0
+static size_t CopyTruncated(const char *src, size_t len, char *dest,
+                            size_t destSize) {
+    if (len > destSize - 1) {
+        len = destSize - 1;
     }
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+    return len;
+}
 
-    size_t decLen = strlen(dec);
-    size_t hexLen = strlen(hex);
-    const char *primary;
-    const char *secondary = NULL;
-    size_t primaryLen;
-    size_t secondaryLen = 0;
-    if (decLen > 0) {
-        primary = dec;
-        primaryLen = decLen;
-        if (hexLen > 0) {
-            secondary = hex;
-            secondaryLen = hexLen;
-        }
+size_t RERR_Error_FormatCodeLen(RERR_ErrorPtr error, char *dest,
+                                size_t destSize) {
+    const struct RERR_Domain *domain;
+    int32_t code;
+    if (error == RERR_NO_ERROR) {
+        domain = NULL;
+        code = 0;
+    } else if (error == RERR_OUT_OF_MEMORY) {
+        domain = &RichErrorsCriticalDomain;
+        code = RERR_ECODE_OUT_OF_MEMORY;
     } else {
-        primary = hex;
-        primaryLen = hexLen;
+        domain = error->head.domain;
+        code = error->head.code;
     }
 
-    // Ensure we never end up with a truncated code; prefer "???" over that.
-    if (destSize < primaryLen + 1) { // Cannot fit code
-        strncpy(dest, "???", destSize);
-        dest[destSize - 1] = '\0';
-        return;
+    if (domain == NULL) {
+        static const char noCode[] = "(no code)";
+        if (!dest || destSize == 0) {
+            return sizeof(noCode) - 1;
+        }
+        return CopyTruncated(noCode, sizeof(noCode) - 1, dest, destSize);
     }
 
-    strcpy(dest, primary);
-
-    if (!secondary) {
-        return;
+    // The plan was made from a format checked upon domain registration.
+    char buf[RERR_FORMATTED_CODE_MAX_SIZE];
+    size_t primaryLen;
+    size_t len = FormatCodeWithPlan(domain->codePlan, code, buf, &primaryLen);
+    if (!dest || destSize == 0) {
+        return len;
     }
 
-    const char lparen[] = " (";
-    const char rparen[] = ")";
-    if (destSize <
-        primaryLen + strlen(lparen) + secondaryLen + strlen(rparen) + 1) {
-        // Cannot fit secondary, leave it out entirely
-        return;
+    // Ensure we never end up with a truncated code; prefer "???" over that.
+    if (destSize < primaryLen + 1) { // Cannot fit code
+        return CopyTruncated("???", 3, dest, destSize);
     }
+    if (destSize < len + 1) { // Cannot fit secondary, leave it out entirely
+        len = primaryLen;
+    }
+    return CopyTruncated(buf, len, dest, destSize);
+}
 
-    strcat(dest, lparen);
-    strcat(dest, secondary);
-    strcat(dest, rparen);
+void RERR_Error_FormatCode(RERR_ErrorPtr error, char *dest, size_t destSize) {
+    (void)RERR_Error_FormatCodeLen(error, dest, destSize);
 }
 
 bool RERR_Error_HasInfo(RERR_ErrorPtr error) {
@@ -562,6 +1127,40 @@ RERR_InfoMapPtr RERR_Error_GetInfo(RERR_ErrorPtr error) {
     return RERR_InfoMap_ImmutableCopy(error->info);
 }
 
+RERR_InfoMapPtr RERR_Error_BorrowInfo(RERR_ErrorPtr error) {
+    if (!error || error == RERR_OUT_OF_MEMORY) {
+        return NULL;
+    }
+    return error->info;
+}
+
+// Format a deferred message and publish it; return null on failure. If
+// another thread publishes first, its copy is returned (they are identical).
+static const char *Error_RenderMessage(RERR_ErrorPtr error) {
+    const void *args = Deferred_Args(error);
+    char buf[128];
+    size_t len = error->formatter(buf, sizeof(buf), args);
+    if (len == RERR_MESSAGE_FORMAT_FAILED) {
+        return NULL;
+    }
+    char *message = MemAlloc(len + 1);
+    if (!message) {
+        return NULL;
+    }
+    if (len < sizeof(buf)) {
+        memcpy(message, buf, len + 1);
+    } else if (error->formatter(message, len + 1, args) != len) {
+        MemFree(message);
+        return NULL;
+    }
+
+    if (!AtomicSetPtrIfNull(&error->message, message)) {
+        MemFree(message);
+        return AtomicLoadPtrAcquire(&error->message);
+    }
+    return message;
+}
+
 const char *RERR_Error_GetMessage(RERR_ErrorPtr error) {
     if (!error) {
         return "(no error)";
@@ -569,13 +1168,17 @@ const char *RERR_Error_GetMessage(RERR_ErrorPtr error) {
     if (error == RERR_OUT_OF_MEMORY) {
         return "Out of memory";
     }
-    if (!error->message) {
+    const char *message = AtomicLoadPtrAcquire(&error->message);
+    if (!message && error->formatter) {
+        message = Error_RenderMessage(error);
+    }
+    if (!message) {
         return "(error message unavailable)";
     }
-    if (error->message[0] == '\0') {
+    if (message[0] == '\0') {
         return "(empty error message)";
     }
-    return error->message;
+    return message;
 }
 
 bool RERR_Error_HasCause(RERR_ErrorPtr error) {
@@ -595,3 +1198,279 @@ RERR_ErrorPtr RERR_Error_GetCause(RERR_ErrorPtr error) {
 bool RERR_Error_IsOutOfMemory(RERR_ErrorPtr error) {
     return error == RERR_OUT_OF_MEMORY;
 }
+
+// Sink for RERR_Error_Format(). Once a write fails, nothing more is written.
+struct FormatSink {
+    RERR_ErrorFormatSink write;
+    void *context;
+    bool failed;
+};
+
+static void Sink_Write(struct FormatSink *sink, const char *data,
+                       size_t size) {
+    if (sink->failed || size == 0) {
+        return;
+    }
+    if (!sink->write(sink->context, data, size)) {
+        sink->failed = true;
+    }
+}
+
+static void Sink_WriteStr(struct FormatSink *sink, const char *str) {
+    Sink_Write(sink, str, strlen(str));
+}
+
+// Write str as a JSON string literal, including the quotes.
+static void Sink_WriteJSONString(struct FormatSink *sink, const char *str) {
+    static const char hexDigits[] = "0123456789abcdef";
+
+    Sink_Write(sink, "\"", 1);
+    const char *run = str;
+    for (const char *p = str; *p != '\0'; ++p) {
+        unsigned char ch = (unsigned char)*p;
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        Sink_Write(sink, run, (size_t)(p - run));
+        run = p + 1;
+
+        char esc[6] = {'\\', 0};
+        size_t escLen = 2;
+        switch (ch) {
+        case '"':
+        case '\\':
+            esc[1] = (char)ch;
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            memcpy(esc + 1, "u00", 3);
+            esc[4] = hexDigits[ch >> 4];
+            esc[5] = hexDigits[ch & 0xf];
+            escLen = 6;
+            break;
+        }
+        Sink_Write(sink, esc, escLen);
+    }
+    Sink_WriteStr(sink, run);
+    Sink_Write(sink, "\"", 1);
+}
+
+static void Sink_WriteString(struct FormatSink *sink, const char *str,
+                             bool json) {
+    if (json) {
+        Sink_WriteJSONString(sink, str);
+    } else {
+        Sink_Write(sink, "\"", 1);
+        Sink_WriteStr(sink, str);
+        Sink_Write(sink, "\"", 1);
+    }
+}
+
+// Write bytes as hexadecimal: 0x... (text) or a string (JSON).
+static void Sink_WriteBytes(struct FormatSink *sink, const void *data,
+                            size_t size, bool json) {
+    static const char hexDigits[] = "0123456789abcdef";
+
+    Sink_WriteStr(sink, json ? "\"" : "0x");
+    const unsigned char *bytes = data;
+    char buf[64];
+    size_t n = 0;
+    for (size_t i = 0; i < size; ++i) {
+        buf[n++] = hexDigits[bytes[i] >> 4];
+        buf[n++] = hexDigits[bytes[i] & 0xf];
+        if (n == sizeof(buf)) {
+            Sink_Write(sink, buf, n);
+            n = 0;
+        }
+    }
+    Sink_Write(sink, buf, n);
+    if (json) {
+        Sink_Write(sink, "\"", 1);
+    }
+}
+
+// Write an array of I64 (if f64s is null) or F64 values as [v, ...].
+static void Sink_WriteArray(struct FormatSink *sink, const int64_t *i64s,
+                            const double *f64s, size_t count, bool json) {
+    char buf[32];
+    Sink_Write(sink, "[", 1);
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            Sink_Write(sink, ", ", 2);
+        }
+        if (!f64s) {
+            snprintf(buf, sizeof(buf), "%" PRId64, i64s[i]);
+        } else if (json && !isfinite(f64s[i])) { // Not representable in JSON
+            strcpy(buf, "null");
+        } else {
+            snprintf(buf, sizeof(buf), "%.17g", f64s[i]);
+        }
+        Sink_WriteStr(sink, buf);
+    }
+    Sink_Write(sink, "]", 1);
+}
+
+static void Sink_WriteInfoValue(struct FormatSink *sink,
+                                RERR_InfoMapIterator it, bool json) {
+    char buf[32];
+    size_t count;
+    switch (RERR_InfoMapIterator_GetType(it)) {
+    case RERR_InfoValueTypeString:
+        Sink_WriteString(sink, RERR_InfoMapIterator_GetString(it), json);
+        return;
+    case RERR_InfoValueTypeBool:
+        Sink_WriteStr(sink, RERR_InfoMapIterator_GetBool(it) ? "true"
+                                                              : "false");
+        return;
+    case RERR_InfoValueTypeI64:
+        snprintf(buf, sizeof(buf), "%" PRId64,
+                 RERR_InfoMapIterator_GetI64(it));
+        break;
+    case RERR_InfoValueTypeU64:
+        snprintf(buf, sizeof(buf), "%" PRIu64,
+                 RERR_InfoMapIterator_GetU64(it));
+        break;
+    case RERR_InfoValueTypeF64: {
+        double value = RERR_InfoMapIterator_GetF64(it);
+        if (json && !isfinite(value)) { // Not representable in JSON
+            strcpy(buf, "null");
+        } else {
+            snprintf(buf, sizeof(buf), "%.17g", value);
+        }
+        break;
+    }
+    case RERR_InfoValueTypeBytes: {
+        const void *data = RERR_InfoMapIterator_GetBytes(it, &count);
+        Sink_WriteBytes(sink, data, count, json);
+        return;
+    }
+    case RERR_InfoValueTypeI64Array: {
+        const int64_t *values = RERR_InfoMapIterator_GetI64Array(it, &count);
+        Sink_WriteArray(sink, values, NULL, count, json);
+        return;
+    }
+    case RERR_InfoValueTypeF64Array: {
+        const double *values = RERR_InfoMapIterator_GetF64Array(it, &count);
+        Sink_WriteArray(sink, NULL, values, count, json);
+        return;
+    }
+    default:
+        strcpy(buf, json ? "null" : "(invalid)");
+        break;
+    }
+    Sink_WriteStr(sink, buf);
+}
+
+static void Sink_WriteInfo(struct FormatSink *sink, RERR_InfoMapPtr info,
+                           bool json) {
+    // Error info maps are immutable, hence sorted; iterating does not modify
+    // or copy them.
+    RERR_InfoMapIterator end = RERR_InfoMap_End(info);
+    bool first = true;
+    Sink_Write(sink, "{", 1);
+    for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(info); it != end;
+         it = RERR_InfoMap_Advance(info, it)) {
+        if (!first) {
+            Sink_Write(sink, ", ", 2);
+        }
+        first = false;
+        const char *key = RERR_InfoMapIterator_GetKey(it);
+        if (json) {
+            Sink_WriteJSONString(sink, key);
+            Sink_Write(sink, ": ", 2);
+        } else {
+            Sink_WriteStr(sink, key);
+            Sink_Write(sink, "=", 1);
+        }
+        Sink_WriteInfoValue(sink, it, json);
+    }
+    Sink_Write(sink, "}", 1);
+}
+
+// Write one error of the chain (not its cause).
+static void Sink_WriteError(struct FormatSink *sink, RERR_ErrorPtr error,
+                            uint32_t options) {
+    bool json = options & RERR_ErrorFormatJSON;
+    RERR_InfoMapPtr info = RERR_Error_BorrowInfo(error);
+    bool withInfo =
+        !(options & RERR_ErrorFormatNoInfo) && !RERR_InfoMap_IsEmpty(info);
+
+    char code[RERR_FORMATTED_CODE_MAX_SIZE];
+    size_t codeLen = 0;
+    if (RERR_Error_HasCode(error)) {
+        codeLen = RERR_Error_FormatCodeLen(error, code, sizeof(code));
+    }
+
+    if (json) {
+        Sink_WriteStr(sink, "{\"message\": ");
+        Sink_WriteJSONString(sink, RERR_Error_GetMessage(error));
+        if (codeLen > 0) {
+            char num[16];
+            snprintf(num, sizeof(num), "%" PRId32, RERR_Error_GetCode(error));
+            Sink_WriteStr(sink, ", \"domain\": ");
+            Sink_WriteJSONString(sink, RERR_Error_GetDomain(error));
+            Sink_WriteStr(sink, ", \"code\": ");
+            Sink_WriteStr(sink, num);
+            Sink_WriteStr(sink, ", \"formattedCode\": ");
+            Sink_WriteJSONString(sink, code);
+        }
+        if (withInfo) {
+            Sink_WriteStr(sink, ", \"info\": ");
+            Sink_WriteInfo(sink, info, true);
+        }
+        Sink_Write(sink, "}", 1);
+        return;
+    }
+
+    Sink_WriteStr(sink, RERR_Error_GetMessage(error));
+    if (codeLen > 0) {
+        Sink_Write(sink, " [", 2);
+        Sink_WriteStr(sink, RERR_Error_GetDomain(error));
+        Sink_Write(sink, " ", 1);
+        Sink_Write(sink, code, codeLen);
+        Sink_Write(sink, "]", 1);
+    }
+    if (withInfo) {
+        Sink_Write(sink, " ", 1);
+        Sink_WriteInfo(sink, info, false);
+    }
+}
+
+bool RERR_Error_Format(RERR_ErrorPtr error, RERR_ErrorFormatSink sink,
+                       void *context, uint32_t options) {
+    if (!sink) {
+        return false;
+    }
+    struct FormatSink s = {sink, context, false};
+    bool json = options & RERR_ErrorFormatJSON;
+
+    if (!error) {
+        Sink_WriteStr(&s, json ? "[]" : RERR_Error_GetMessage(error));
+        return !s.failed;
+    }
+
+    if (json) {
+        Sink_Write(&s, "[", 1);
+    }
+    for (RERR_ErrorPtr e = error; e && !s.failed; e = RERR_Error_GetCause(e)) {
+        if (e != error) {
+            Sink_WriteStr(&s, json ? ", " : "\nCaused by: ");
+        }
+        Sink_WriteError(&s, e, options);
+        if (options & RERR_ErrorFormatNoCauses) {
+            break;
+        }
+    }
+    if (json) {
+        Sink_Write(&s, "]", 1);
+    }
+    return !s.failed;
+}
@@ -0,0 +1,481 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "RichErrors/RichErrors.h"
+
+#include "Alloc.h"
+#include "Error.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Binary format (all integers little-endian):
+//
+//   header:  "RERR", u8 version, 3 reserved zero bytes, u32 chain length
+//   error:   u8 kind (RECORD_*); for RECORD_ERROR: string domain (empty if no
+//            code), i32 code (only if domain), string message, u32 item count,
+//            items
+//   item:    string key, u8 RERR_InfoValueType, value
+//   value:   string; u8 (bool); u64 (i64, u64, or bits of f64); or u32 byte
+//            length and bytes (bytes), or u64 elements (arrays)
+//   string:  u32 length, bytes, null terminator
+//
+// Errors appear outermost first. The null terminators allow decoded errors to
+// borrow strings from the buffer.
+
+static const unsigned char Magic[4] = {'R', 'E', 'R', 'R'};
+
+enum {
+    RECORD_ERROR = 0,
+    RECORD_OUT_OF_MEMORY = 1,
+};
+
+#define MIN_ITEM_SIZE 7 // Empty key, type, bool
+
+// Writes to p if not null; always counts the size.
+struct Writer {
+    unsigned char *p;
+    size_t size;
+};
+
+static void Put(struct Writer *w, const void *data, size_t n) {
+    if (w->p) {
+        memcpy(w->p + w->size, data, n);
+    }
+    w->size += n;
+}
+
+static void PutU8(struct Writer *w, uint8_t v) { Put(w, &v, 1); }
+
+static void PutU32(struct Writer *w, uint32_t v) {
+    unsigned char b[4];
+    for (int i = 0; i < 4; ++i) {
+        b[i] = (unsigned char)(v >> (8 * i));
+    }
+    Put(w, b, 4);
+}
+
+static void PutU64(struct Writer *w, uint64_t v) {
+    unsigned char b[8];
+    for (int i = 0; i < 8; ++i) {
+        b[i] = (unsigned char)(v >> (8 * i));
+    }
+    Put(w, b, 8);
+}
+
+static void PutString(struct Writer *w, const char *s) {
+    size_t len = strlen(s);
+    PutU32(w, (uint32_t)len);
+    Put(w, s, len + 1);
+}
+
+static void PutInfo(struct Writer *w, RERR_InfoMapPtr info) {
+    PutU32(w, (uint32_t)RERR_InfoMap_GetSize(info));
+    RERR_InfoMapIterator end = RERR_InfoMap_End(info);
+    for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(info); it != end;
+         it = RERR_InfoMap_Advance(info, it)) {
+        RERR_InfoValueType type = RERR_InfoMapIterator_GetType(it);
+        PutString(w, RERR_InfoMapIterator_GetKey(it));
+        PutU8(w, (uint8_t)type);
+        switch (type) {
+        case RERR_InfoValueTypeString:
+            PutString(w, RERR_InfoMapIterator_GetString(it));
+            break;
+        case RERR_InfoValueTypeBool:
+            PutU8(w, RERR_InfoMapIterator_GetBool(it));
+            break;
+        case RERR_InfoValueTypeI64:
+            PutU64(w, (uint64_t)RERR_InfoMapIterator_GetI64(it));
+            break;
+        case RERR_InfoValueTypeU64:
+            PutU64(w, RERR_InfoMapIterator_GetU64(it));
+            break;
+        case RERR_InfoValueTypeF64: {
+            double f = RERR_InfoMapIterator_GetF64(it);
+            uint64_t bits;
+            memcpy(&bits, &f, sizeof(bits));
+            PutU64(w, bits);
+            break;
+        }
+        case RERR_InfoValueTypeBytes: {
+            size_t size;
+            const void *data = RERR_InfoMapIterator_GetBytes(it, &size);
+            PutU32(w, (uint32_t)size);
+            Put(w, data, size);
+            break;
+        }
+        case RERR_InfoValueTypeI64Array:
+        case RERR_InfoValueTypeF64Array: {
+            // Both are arrays of 64-bit values
+            size_t count;
+            const int64_t *values =
+                type == RERR_InfoValueTypeI64Array
+                    ? RERR_InfoMapIterator_GetI64Array(it, &count)
+                    : (const int64_t *)(const void *)
+                          RERR_InfoMapIterator_GetF64Array(it, &count);
+            PutU32(w, (uint32_t)(count * sizeof(uint64_t)));
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t bits;
+                memcpy(&bits, &values[i], sizeof(bits));
+                PutU64(w, bits);
+            }
+            break;
+        }
+        }
+    }
+}
+
+static void PutChain(struct Writer *w, RERR_ErrorPtr error) {
+    uint32_t count = 0;
+    for (RERR_ErrorPtr e = error; e; e = RERR_Error_GetCause(e)) {
+        ++count;
+    }
+
+    Put(w, Magic, sizeof(Magic));
+    PutU8(w, RERR_SERIAL_VERSION);
+    Put(w, "\0\0\0", 3);
+    PutU32(w, count);
+
+    for (RERR_ErrorPtr e = error; e; e = RERR_Error_GetCause(e)) {
+        if (RERR_Error_IsOutOfMemory(e)) {
+            PutU8(w, RECORD_OUT_OF_MEMORY);
+            continue;
+        }
+        PutU8(w, RECORD_ERROR);
+        bool hasCode = RERR_Error_HasCode(e);
+        PutString(w, hasCode ? RERR_Error_GetDomain(e) : "");
+        if (hasCode) {
+            PutU32(w, (uint32_t)RERR_Error_GetCode(e));
+        }
+        PutString(w, RERR_Error_GetMessage(e));
+        PutInfo(w, RERR_Error_BorrowInfo(e));
+    }
+}
+
+size_t RERR_Error_Serialize(RERR_ErrorPtr error, void *dest,
+                            size_t destSize) {
+    struct Writer w = {NULL, 0};
+    PutChain(&w, error);
+    if (dest && destSize >= w.size) {
+        struct Writer out = {dest, 0};
+        PutChain(&out, error);
+    }
+    return w.size;
+}
+
+// Reads are bounds-checked; once one fails, all subsequent reads fail.
+struct Reader {
+    const unsigned char *p;
+    const unsigned char *end;
+    bool bad;
+};
+
+static const unsigned char *Get(struct Reader *r, size_t n) {
+    if (r->bad || (size_t)(r->end - r->p) < n) {
+        r->bad = true;
+        return NULL;
+    }
+    const unsigned char *ret = r->p;
+    r->p += n;
+    return ret;
+}
+
+static uint8_t GetU8(struct Reader *r) {
+    const unsigned char *b = Get(r, 1);
+    return b ? b[0] : 0;
+}
+
+static uint32_t GetU32(struct Reader *r) {
+    const unsigned char *b = Get(r, 4);
+    uint32_t v = 0;
+    for (int i = 0; b && i < 4; ++i) {
+        v |= (uint32_t)b[i] << (8 * i);
+    }
+    return v;
+}
+
+static uint64_t GetU64(struct Reader *r) {
+    const unsigned char *b = Get(r, 8);
+    uint64_t v = 0;
+    for (int i = 0; b && i < 8; ++i) {
+        v |= (uint64_t)b[i] << (8 * i);
+    }
+    return v;
+}
+
+// Return the string in place, or null if out of bounds or not terminated.
+static const char *GetString(struct Reader *r, size_t *len) {
+    uint32_t n = GetU32(r);
+    const unsigned char *s = Get(r, (size_t)n + 1);
+    if (!s || s[n] != '\0') {
+        r->bad = true;
+        return NULL;
+    }
+    *len = n;
+    return (const char *)s;
+}
+
+static RERR_ErrorPtr Malformed(void) {
+    return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                     RERR_ECODE_SERIAL_MALFORMED,
+                                     "Malformed serialized error");
+}
+
+static void SetInfoItem(RERR_InfoMapPtr info,
+                        const RERR_InfoMapInitItem *item, bool borrow) {
+    const char *key = item->key;
+    switch (item->type) {
+    case RERR_InfoValueTypeString:
+        if (borrow) {
+            RERR_InfoMap_SetStringStaticKey(info, key, item->value.string);
+        } else {
+            RERR_InfoMap_SetString(info, key, item->value.string);
+        }
+        break;
+    case RERR_InfoValueTypeBool:
+        if (borrow) {
+            RERR_InfoMap_SetBoolStaticKey(info, key, item->value.boolean);
+        } else {
+            RERR_InfoMap_SetBool(info, key, item->value.boolean);
+        }
+        break;
+    case RERR_InfoValueTypeI64:
+        if (borrow) {
+            RERR_InfoMap_SetI64StaticKey(info, key, item->value.i64);
+        } else {
+            RERR_InfoMap_SetI64(info, key, item->value.i64);
+        }
+        break;
+    case RERR_InfoValueTypeU64:
+        if (borrow) {
+            RERR_InfoMap_SetU64StaticKey(info, key, item->value.u64);
+        } else {
+            RERR_InfoMap_SetU64(info, key, item->value.u64);
+        }
+        break;
+    case RERR_InfoValueTypeF64:
+        if (borrow) {
+            RERR_InfoMap_SetF64StaticKey(info, key, item->value.f64);
+        } else {
+            RERR_InfoMap_SetF64(info, key, item->value.f64);
+        }
+        break;
+    }
+}
+
+// Read a byte string or array value and set it; return false if malformed.
+static bool GetBlobItem(struct Reader *r, RERR_InfoMapPtr info,
+                        const char *key, RERR_InfoValueType type) {
+    uint32_t size = GetU32(r);
+    const unsigned char *data = Get(r, size);
+    if (!data) {
+        return false;
+    }
+    if (type == RERR_InfoValueTypeBytes) {
+        RERR_InfoMap_SetBytes(info, key, data, size);
+        return true;
+    }
+
+    if (size % sizeof(uint64_t) != 0) {
+        return false;
+    }
+    size_t count = size / sizeof(uint64_t);
+    uint64_t *values = MemAlloc(size > 0 ? size : 1);
+    if (!values) {
+        RERR_InfoMap_MakeOutOfMemory(info);
+        return true;
+    }
+    struct Reader elements = {data, data + size, false};
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = GetU64(&elements);
+    }
+    if (type == RERR_InfoValueTypeI64Array) {
+        RERR_InfoMap_SetI64Array(info, key, (const int64_t *)values, count);
+    } else {
+        RERR_InfoMap_SetF64Array(info, key, (const double *)(void *)values,
+                                 count);
+    }
+    MemFree(values);
+    return true;
+}
+
+// Read one item and set it; return false if malformed.
+static bool GetInfoItem(struct Reader *r, RERR_InfoMapPtr info, bool borrow) {
+    RERR_InfoMapInitItem storage;
+    RERR_InfoMapInitItem *item = &storage;
+    size_t len;
+    item->key = GetString(r, &len);
+    item->type = GetU8(r);
+    if (r->bad) {
+        return false;
+    }
+    switch (item->type) {
+    case RERR_InfoValueTypeString:
+        item->value.string = GetString(r, &len);
+        break;
+    case RERR_InfoValueTypeBool: {
+        uint8_t b = GetU8(r);
+        if (b > 1) {
+            return false;
+        }
+        item->value.boolean = b;
+        break;
+    }
+    case RERR_InfoValueTypeI64:
+        item->value.i64 = (int64_t)GetU64(r);
+        break;
+    case RERR_InfoValueTypeU64:
+        item->value.u64 = GetU64(r);
+        break;
+    case RERR_InfoValueTypeF64: {
+        uint64_t bits = GetU64(r);
+        memcpy(&item->value.f64, &bits, sizeof(bits));
+        break;
+    }
+    case RERR_InfoValueTypeBytes:
+    case RERR_InfoValueTypeI64Array:
+    case RERR_InfoValueTypeF64Array:
+        return GetBlobItem(r, info, item->key, item->type);
+    default:
+        return false;
+    }
+    if (r->bad) {
+        return false;
+    }
+    SetInfoItem(info, item, borrow);
+    return true;
+}
+
+// Read items into a new info map (null if there are no items); return false
+// if malformed.
+static bool GetInfo(struct Reader *r, bool borrow, RERR_InfoMapPtr *info) {
+    *info = NULL;
+    uint32_t count = GetU32(r);
+    if (r->bad || count > (size_t)(r->end - r->p) / MIN_ITEM_SIZE) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    *info = RERR_InfoMap_Create();
+    RERR_InfoMap_ReserveCapacity(*info, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!GetInfoItem(r, *info, borrow)) {
+            RERR_InfoMap_Destroy(*info);
+            *info = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read one RECORD_ERROR record (after the kind byte) and create the error.
+// On failure, return null and set *err.
+static RERR_ErrorPtr GetError(struct Reader *r, bool borrow,
+                              RERR_ErrorPtr *err) {
+    size_t domainLen = 0;
+    const char *domainName = GetString(r, &domainLen);
+    int32_t code = domainLen > 0 ? (int32_t)GetU32(r) : 0;
+    size_t messageLen = 0;
+    const char *message = GetString(r, &messageLen);
+    if (r->bad) {
+        *err = Malformed();
+        return NULL;
+    }
+
+    RERR_DomainHandle domain = NULL;
+    if (domainLen > 0) {
+        *err = RERR_Domain_Lookup(domainName, &domain);
+        if (*err) {
+            return NULL;
+        }
+    }
+
+    RERR_InfoMapPtr info;
+    if (!GetInfo(r, borrow, &info)) {
+        *err = Malformed();
+        return NULL;
+    }
+    if (RERR_InfoMap_IsOutOfMemory(info)) {
+        RERR_InfoMap_Destroy(info);
+        *err = RERR_Error_CreateOutOfMemory();
+        return NULL;
+    }
+
+    RERR_ErrorPtr ret = Error_CreateFromParts(domain, code, message,
+                                              messageLen, !borrow, info);
+    if (RERR_Error_IsOutOfMemory(ret)) {
+        *err = ret;
+        return NULL;
+    }
+    return ret;
+}
+
+RERR_ErrorPtr RERR_Error_Deserialize(const void *data, size_t size,
+                                     uint32_t flags, RERR_ErrorPtr *result) {
+    if (!result) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_NULL_ARGUMENT,
+                                         "Null result pointer");
+    }
+    *result = RERR_NO_ERROR;
+    if (!data && size > 0) {
+        return RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                         RERR_ECODE_NULL_ARGUMENT,
+                                         "Null serialized data");
+    }
+
+    const bool borrow = flags & RERR_DeserializeBorrowStrings;
+    struct Reader r = {data, data ? (const unsigned char *)data + size : NULL,
+                       false};
+    const unsigned char *magic = Get(&r, sizeof(Magic));
+    if (!magic || memcmp(magic, Magic, sizeof(Magic)) != 0) {
+        return Malformed();
+    }
+    uint8_t version = GetU8(&r);
+    Get(&r, 3); // Reserved
+    uint32_t count = GetU32(&r);
+    if (r.bad) {
+        return Malformed();
+    }
+    if (version != RERR_SERIAL_VERSION) {
+        return RERR_Error_CreateWithCode(
+            RERR_DOMAIN_RICHERRORS, RERR_ECODE_SERIAL_VERSION,
+            "Unsupported serialized error version");
+    }
+
+    RERR_ErrorPtr head = RERR_NO_ERROR;
+    RERR_ErrorPtr tail = RERR_NO_ERROR; // Outermost error lacking its cause
+    RERR_ErrorPtr err = RERR_NO_ERROR;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t kind = GetU8(&r);
+        RERR_ErrorPtr e;
+        if (kind == RECORD_OUT_OF_MEMORY && i + 1 == count && !r.bad) {
+            e = RERR_Error_CreateOutOfMemory(); // Cannot have a cause
+        } else if (kind == RECORD_ERROR && !r.bad) {
+            e = GetError(&r, borrow, &err);
+            if (!e) {
+                break;
+            }
+        } else {
+            err = Malformed();
+            break;
+        }
+
+        if (tail) {
+            Error_SetCause(tail, e);
+        } else {
+            head = e;
+        }
+        tail = e;
+    }
+
+    if (err) {
+        RERR_Error_Destroy(head);
+        return err;
+    }
+    *result = head;
+    return RERR_NO_ERROR;
+}
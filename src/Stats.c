@@ -0,0 +1,45 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include "Stats.h"
+
+#include "RichErrors/RichErrors.h"
+
+#include <string.h>
+
+#ifdef RERR_USE_STATS
+
+AtomicCounter RERR_Internal_Stats[STATS_COUNTER_COUNT];
+
+static inline uint64_t Load(enum StatsCounter counter) {
+    return (uint64_t)AtomicCounterLoad(&RERR_Internal_Stats[counter]);
+}
+
+bool RERR_Stats_Get(RERR_Stats *stats) {
+    if (!stats) {
+        return true;
+    }
+    stats->errorsLive = Load(StatsCounter_ErrorsLive);
+    stats->errorsCreated = Load(StatsCounter_ErrorsCreated);
+    stats->infoMapsLive = Load(StatsCounter_InfoMapsLive);
+    stats->infoMapsCreated = Load(StatsCounter_InfoMapsCreated);
+    stats->domainsRegistered = Load(StatsCounter_DomainsRegistered);
+    stats->errorMapEntriesLive = Load(StatsCounter_ErrorMapEntriesLive);
+    stats->errorMapEntriesCreated = Load(StatsCounter_ErrorMapEntriesCreated);
+    stats->allocationsLive = Load(StatsCounter_AllocationsLive);
+    stats->allocations = Load(StatsCounter_Allocations);
+    stats->bytesAllocated = Load(StatsCounter_BytesAllocated);
+    return true;
+}
+
+#else // RERR_USE_STATS
+
+bool RERR_Stats_Get(RERR_Stats *stats) {
+    if (stats) {
+        memset(stats, 0, sizeof(RERR_Stats));
+    }
+    return false;
+}
+
+#endif // RERR_USE_STATS
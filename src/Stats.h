@@ -0,0 +1,48 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+// Instrumentation counters reported by RERR_Stats_Get(). When RERR_USE_STATS
+// is not defined, updating the counters compiles to nothing.
+
+#include "Threads.h"
+
+enum StatsCounter {
+    StatsCounter_ErrorsLive,
+    StatsCounter_ErrorsCreated,
+    StatsCounter_InfoMapsLive,
+    StatsCounter_InfoMapsCreated,
+    StatsCounter_DomainsRegistered,
+    StatsCounter_ErrorMapEntriesLive,
+    StatsCounter_ErrorMapEntriesCreated,
+    StatsCounter_AllocationsLive,
+    StatsCounter_Allocations,
+    StatsCounter_BytesAllocated,
+    STATS_COUNTER_COUNT,
+};
+
+#ifdef RERR_USE_STATS
+extern AtomicCounter RERR_Internal_Stats[STATS_COUNTER_COUNT];
+#endif
+
+static inline void Stats_Add(enum StatsCounter counter, long long delta) {
+#ifdef RERR_USE_STATS
+    AtomicCounterAdd(&RERR_Internal_Stats[counter], delta);
+#else
+    (void)counter;
+    (void)delta;
+#endif
+}
+
+// Record creation of an object counted by a live and a created counter.
+static inline void Stats_Created(enum StatsCounter live,
+                                 enum StatsCounter created) {
+    Stats_Add(live, 1);
+    Stats_Add(created, 1);
+}
+
+static inline void Stats_Destroyed(enum StatsCounter live) {
+    Stats_Add(live, -1);
+}
@@ -6,13 +6,52 @@
 
 #include "Threads.h"
 
-void InitRecursiveMutex(Mutex *mutex) {
+void InitMutex(Mutex *mutex) {
 #if USE_WIN32THREADS
-    InitializeCriticalSection(mutex);
+    InitializeSRWLock(mutex);
 #else
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-    pthread_mutex_init(mutex, &attr);
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void DestroyMutex(Mutex *mutex) {
+#if USE_WIN32THREADS
+    (void)mutex; // SRW locks need no cleanup
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void InitRWLock(RWLock *lock) {
+#if USE_WIN32THREADS
+    InitializeSRWLock(lock);
+#else
+    pthread_rwlock_init(lock, NULL);
+#endif
+}
+
+void DestroyRWLock(RWLock *lock) {
+#if USE_WIN32THREADS
+    (void)lock;
+#else
+    pthread_rwlock_destroy(lock);
+#endif
+}
+
+bool CreateThreadLocalKey(ThreadLocalKey *key,
+                          ThreadLocalDestructor destructor) {
+#if USE_WIN32THREADS
+    *key = FlsAlloc(destructor);
+    return *key != FLS_OUT_OF_INDEXES;
+#else
+    return pthread_key_create(key, destructor) == 0;
+#endif
+}
+
+void DeleteThreadLocalKey(ThreadLocalKey key) {
+#if USE_WIN32THREADS
+    FlsFree(key);
+#else
+    pthread_key_delete(key);
 #endif
 }
@@ -17,15 +17,29 @@
 #include <Windows.h>
 #else
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #endif
 
+#include <stdbool.h>
+
 //
 // Types and values
 //
 
 #if USE_WIN32THREADS
 
-typedef CRITICAL_SECTION Mutex;
+typedef SRWLOCK Mutex; // Used in exclusive mode only
+
+#define MUTEX_INITIALIZER SRWLOCK_INIT
+
+typedef SRWLOCK RWLock;
+
+#define RWLOCK_INITIALIZER SRWLOCK_INIT
+
+typedef LONG volatile SpinLock;
+
+#define SPIN_LOCK_INITIALIZER 0
 
 typedef INIT_ONCE CallOnceFlag;
 
@@ -33,10 +47,30 @@ typedef INIT_ONCE CallOnceFlag;
 
 typedef DWORD ThreadID;
 
+typedef PVOID volatile AtomicPtr;
+
+typedef LONG volatile AtomicRefCount;
+
+typedef LONGLONG volatile AtomicCounter;
+
+typedef DWORD ThreadLocalKey;
+
+#define THREAD_LOCAL_DESTRUCTOR_CALL NTAPI
+
 #else // pthreads
 
 typedef pthread_mutex_t Mutex;
 
+#define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+
+typedef pthread_rwlock_t RWLock;
+
+#define RWLOCK_INITIALIZER PTHREAD_RWLOCK_INITIALIZER
+
+typedef atomic_flag SpinLock;
+
+#define SPIN_LOCK_INITIALIZER ATOMIC_FLAG_INIT
+
 typedef pthread_once_t CallOnceFlag;
 
 #define CALL_ONCE_FLAG_INITIALIZER PTHREAD_ONCE_INIT
@@ -44,13 +78,47 @@ typedef pthread_once_t CallOnceFlag;
 // Since we're not displaying, pthread_t is ok.
 typedef pthread_t ThreadID;
 
+typedef _Atomic(void *) AtomicPtr;
+
+typedef atomic_long AtomicRefCount;
+
+typedef atomic_llong AtomicCounter;
+
+typedef pthread_key_t ThreadLocalKey;
+
+#define THREAD_LOCAL_DESTRUCTOR_CALL
+
 #endif
 
 //
-// Mutex initialization
+// Lock initialization and destruction
 //
 
-void InitRecursiveMutex(Mutex *mutex);
+// Locks are not recursive. Statically allocated locks should use the
+// initializer macros instead of the Init functions.
+
+void InitMutex(Mutex *mutex);
+
+void DestroyMutex(Mutex *mutex);
+
+void InitRWLock(RWLock *lock);
+
+void DestroyRWLock(RWLock *lock);
+
+//
+// Thread-local storage initialization
+//
+
+typedef void(THREAD_LOCAL_DESTRUCTOR_CALL *ThreadLocalDestructor)(void *);
+
+// The destructor is called on thread exit for each thread whose value is
+// non-null. Returns false on failure.
+bool CreateThreadLocalKey(ThreadLocalKey *key,
+                          ThreadLocalDestructor destructor);
+
+// With pthreads, the destructor is not called for the remaining values; on
+// Windows, the callback may be called for them before this returns.
+void DeleteThreadLocalKey(ThreadLocalKey key);
 
 //
 // Call-once support
@@ -84,7 +152,7 @@ static inline void CallOnce(CallOnceFlag *flag, void (*func)(void)) {
 
 static inline void LockMutex(Mutex *mutex) {
 #if USE_WIN32THREADS
-    EnterCriticalSection(mutex);
+    AcquireSRWLockExclusive(mutex);
 #else
     pthread_mutex_lock(mutex);
 #endif
@@ -92,12 +160,80 @@ static inline void LockMutex(Mutex *mutex) {
 
 static inline void UnlockMutex(Mutex *mutex) {
 #if USE_WIN32THREADS
-    LeaveCriticalSection(mutex);
+    ReleaseSRWLockExclusive(mutex);
 #else
     pthread_mutex_unlock(mutex);
 #endif
 }
 
+//
+// Reader-writer lock
+//
+
+static inline void LockShared(RWLock *lock) {
+#if USE_WIN32THREADS
+    AcquireSRWLockShared(lock);
+#else
+    pthread_rwlock_rdlock(lock);
+#endif
+}
+
+static inline void UnlockShared(RWLock *lock) {
+#if USE_WIN32THREADS
+    ReleaseSRWLockShared(lock);
+#else
+    pthread_rwlock_unlock(lock);
+#endif
+}
+
+static inline void LockExclusive(RWLock *lock) {
+#if USE_WIN32THREADS
+    AcquireSRWLockExclusive(lock);
+#else
+    pthread_rwlock_wrlock(lock);
+#endif
+}
+
+static inline void UnlockExclusive(RWLock *lock) {
+#if USE_WIN32THREADS
+    ReleaseSRWLockExclusive(lock);
+#else
+    pthread_rwlock_unlock(lock);
+#endif
+}
+
+//
+// Spin lock (for critical sections of a few instructions that never block)
+//
+
+// Returns true if the lock was acquired.
+static inline bool TryLockSpin(SpinLock *lock) {
+#if USE_WIN32THREADS
+    return InterlockedExchangeAcquire(lock, 1) == 0;
+#else
+    return !atomic_flag_test_and_set_explicit(lock, memory_order_acquire);
+#endif
+}
+
+static inline void LockSpin(SpinLock *lock) {
+    while (!TryLockSpin(lock)) {
+        // Let the holder run if it was preempted
+#if USE_WIN32THREADS
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
+static inline void UnlockSpin(SpinLock *lock) {
+#if USE_WIN32THREADS
+    InterlockedExchange(lock, 0);
+#else
+    atomic_flag_clear_explicit(lock, memory_order_release);
+#endif
+}
+
 //
 // Thread id
 //
@@ -109,3 +245,141 @@ static inline ThreadID GetThisThreadId(void) {
     return pthread_self();
 #endif
 }
+
+//
+// Thread-local storage
+//
+
+static inline void *GetThreadLocal(ThreadLocalKey key) {
+#if USE_WIN32THREADS
+    return FlsGetValue(key);
+#else
+    return pthread_getspecific(key);
+#endif
+}
+
+// Returns false on failure.
+static inline bool SetThreadLocal(ThreadLocalKey key, void *value) {
+#if USE_WIN32THREADS
+    return FlsSetValue(key, value);
+#else
+    return pthread_setspecific(key, value) == 0;
+#endif
+}
+
+//
+// Atomic pointers
+//
+
+// Statically allocated AtomicPtr objects are zero-initialized (null).
+
+static inline void *AtomicLoadPtrAcquire(AtomicPtr *ptr) {
+#if USE_WIN32THREADS
+    return InterlockedCompareExchangePointerAcquire(ptr, NULL, NULL);
+#else
+    return atomic_load_explicit(ptr, memory_order_acquire);
+#endif
+}
+
+// For objects not yet visible to other threads.
+static inline void AtomicInitPtr(AtomicPtr *ptr, void *value) {
+#if USE_WIN32THREADS
+    *ptr = value;
+#else
+    atomic_init(ptr, value);
+#endif
+}
+
+static inline void AtomicStorePtrRelease(AtomicPtr *ptr, void *value) {
+#if USE_WIN32THREADS
+    InterlockedExchangePointer(ptr, value);
+#else
+    atomic_store_explicit(ptr, value, memory_order_release);
+#endif
+}
+
+// Store desired if *ptr is null; return true on success. On failure, the
+// value already stored is visible as if by AtomicLoadPtrAcquire().
+static inline bool AtomicSetPtrIfNull(AtomicPtr *ptr, void *desired) {
+#if USE_WIN32THREADS
+    return InterlockedCompareExchangePointer(ptr, desired, NULL) == NULL;
+#else
+    void *expected = NULL;
+    return atomic_compare_exchange_strong_explicit(
+        ptr, &expected, desired, memory_order_acq_rel, memory_order_acquire);
+#endif
+}
+
+//
+// Atomic reference counts
+//
+
+static inline void AtomicRefCountInit(AtomicRefCount *count, long value) {
+#if USE_WIN32THREADS
+    *count = value;
+#else
+    atomic_init(count, value);
+#endif
+}
+
+// A new reference can only be made from an existing one, so no ordering is
+// required.
+static inline void AtomicRefCountIncrement(AtomicRefCount *count) {
+#if USE_WIN32THREADS
+    InterlockedIncrementNoFence(count);
+#else
+    atomic_fetch_add_explicit(count, 1, memory_order_relaxed);
+#endif
+}
+
+// Return true if the caller holds the only reference, in which case all
+// accesses made via other (now released) references happen before the return.
+static inline bool AtomicRefCountIsOne(AtomicRefCount *count) {
+#if USE_WIN32THREADS
+    return InterlockedCompareExchange(count, 1, 1) == 1; // Full barrier
+#else
+    return atomic_load_explicit(count, memory_order_acquire) == 1;
+#endif
+}
+
+// Return true if the count reached zero, in which case all accesses made via
+// other (now released) references happen before the return.
+static inline bool AtomicRefCountDecrement(AtomicRefCount *count) {
+#if USE_WIN32THREADS
+    return InterlockedDecrement(count) == 0; // Full barrier
+#else
+    return atomic_fetch_sub_explicit(count, 1, memory_order_acq_rel) == 1;
+#endif
+}
+
+//
+// Atomic counters (for statistics and limits; no ordering)
+//
+
+// Statically allocated AtomicCounter objects are zero-initialized.
+
+static inline void AtomicCounterAdd(AtomicCounter *counter, long long delta) {
+#if USE_WIN32THREADS
+    InterlockedExchangeAddNoFence64(counter, delta);
+#else
+    atomic_fetch_add_explicit(counter, delta, memory_order_relaxed);
+#endif
+}
+
+// Returns the value before the addition.
+static inline long long AtomicCounterFetchAdd(AtomicCounter *counter,
+                                              long long delta) {
+#if USE_WIN32THREADS
+    return InterlockedExchangeAddNoFence64(counter, delta);
+#else
+    return atomic_fetch_add_explicit(counter, delta, memory_order_relaxed);
+#endif
+}
+
+static inline long long AtomicCounterLoad(AtomicCounter *counter) {
+#if USE_WIN32THREADS
+    return InterlockedCompareExchangeNoFence64(counter, 0, 0);
+#else
+    return atomic_load_explicit(counter, memory_order_relaxed);
+#endif
+}
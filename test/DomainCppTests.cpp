@@ -0,0 +1,115 @@
+// This file is part of RichErrors.
+// Copyright 2019-2022 Board of Regents of the University of Wisconsin System
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <catch2/catch.hpp>
+
+#include "RichErrors/Domain.hpp"
+
+#include <string>
+#include <utility>
+
+namespace {
+
+enum class CameraCode : int32_t { Timeout = 1, NoDevice = 2, Other = 255 };
+
+struct CameraTraits {
+    using CodeType = CameraCode;
+    static constexpr const char *Name() { return "Camera"; }
+    static constexpr RERR_CodeFormat CodeFormat() {
+        return RERR_CodeFormat_Hex32;
+    }
+    static constexpr const char *Message(CameraCode code) {
+        switch (code) {
+        case CameraCode::Timeout:
+            return "Camera timed out";
+        case CameraCode::NoDevice:
+            return "No camera found";
+        default:
+            return nullptr;
+        }
+    }
+};
+
+enum PlainCode { PlainFailure = -3 };
+
+struct PlainTraits {
+    using CodeType = PlainCode;
+    static constexpr const char *Name() { return "Plain"; }
+    static constexpr RERR_CodeFormat CodeFormat() {
+        return RERR_CodeFormat_I32;
+    }
+};
+
+using CameraDomain = RERR::Domain<CameraTraits>;
+using PlainDomain = RERR::Domain<PlainTraits>;
+
+static_assert(CameraDomain::HasMessageCatalog(), "");
+static_assert(!PlainDomain::HasMessageCatalog(), "");
+static_assert(CameraDomain::Message(CameraCode::Timeout)[0] == 'C',
+              "catalog is usable at compile time");
+static_assert(RERR::internal::IsValidDomainName("a b"), "");
+static_assert(!RERR::internal::IsValidDomainName(""), "");
+static_assert(!RERR::internal::IsValidDomainName("tab\t"), "");
+static_assert(!RERR::internal::IsValidCodeFormat(RERR_CodeFormat_I32 |
+                                                 RERR_CodeFormat_U32),
+              "");
+
+} // namespace
+
+TEST_CASE("C++ static domain") {
+    RERR::UnregisterAllDomains();
+    REQUIRE(CameraDomain::Register().IsSuccess());
+    REQUIRE(CameraDomain::Handle() != nullptr);
+    REQUIRE(CameraDomain::Register().GetCode() ==
+            RERR_ECODE_DOMAIN_ALREADY_EXISTS);
+
+    auto err = CameraDomain::Create(CameraCode::Timeout);
+    REQUIRE(err.GetDomain() == "Camera");
+    REQUIRE(err.GetCode() == 1);
+    REQUIRE(err.FormatCode() == "0x00000001");
+    // The catalog message is not copied
+    REQUIRE(err.GetMessageCStr() ==
+            CameraDomain::Message(CameraCode::Timeout));
+    REQUIRE(CameraDomain::Is(err.View()));
+    REQUIRE(CameraDomain::Is(err.View(), CameraCode::Timeout));
+    REQUIRE_FALSE(CameraDomain::Is(err.View(), CameraCode::NoDevice));
+    REQUIRE_FALSE(PlainDomain::Is(err.View()));
+
+    REQUIRE(CameraDomain::Create(CameraCode::Other).GetMessage() ==
+            "Unknown error code");
+    std::string text = "dynamic";
+    REQUIRE(CameraDomain::Create(CameraCode::Other, text).GetMessage() ==
+            text);
+
+    auto wrapped = CameraDomain::Wrap(std::move(err), CameraCode::NoDevice);
+    REQUIRE(wrapped.GetMessage() == "No camera found");
+    REQUIRE(CameraDomain::Is(wrapped.View(), CameraCode::NoDevice));
+    REQUIRE(CameraDomain::Is(wrapped.GetCause().View(),
+                             CameraCode::Timeout));
+
+    // Not registered
+    REQUIRE(PlainDomain::Handle() == nullptr);
+    REQUIRE(PlainDomain::Create(PlainFailure, "failed").GetCode() ==
+            RERR_ECODE_NULL_ARGUMENT);
+
+    // Registered by name elsewhere
+    REQUIRE(RERR::RegisterDomain("Plain", RERR_CodeFormat_I32).IsSuccess());
+    auto plain = PlainDomain::Create(PlainFailure, "failed");
+    REQUIRE(PlainDomain::Is(plain.View(), PlainFailure));
+    REQUIRE(plain.FormatCode() == "-3");
+    auto outer = PlainDomain::Wrap(std::move(plain), PlainFailure, text);
+    REQUIRE(outer.GetMessage() == text);
+    REQUIRE(outer.GetCause().GetMessage() == "failed");
+
+    static const char literal[] = "static";
+    REQUIRE(PlainDomain::Create(PlainFailure, RERR::StaticMessage(literal))
+                .GetMessageCStr() == literal);
+
+    // Handles must be refreshed after unregistering
+    RERR::UnregisterAllDomains();
+    REQUIRE(CameraDomain::Register().IsSuccess());
+    REQUIRE(CameraDomain::Create(CameraCode::Timeout).GetDomain() ==
+            "Camera");
+    RERR::UnregisterAllDomains();
+}
@@ -8,6 +8,33 @@
 
 #include "TestDefs.h"
 
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Output iterator that throws once it has accepted a given number of errors
+struct ThrowingOutput {
+    std::vector<RERR::Error> *out;
+    int remaining;
+
+    ThrowingOutput &operator*() { return *this; }
+    ThrowingOutput &operator++() { return *this; }
+    ThrowingOutput &operator++(int) { return *this; }
+    ThrowingOutput &operator=(RERR::Error &&error) {
+        if (remaining-- == 0) {
+            throw std::runtime_error("output full");
+        }
+        out->push_back(std::move(error));
+        return *this;
+    }
+};
+
+} // namespace
+
 TEST_CASE("Err2Code C++ Example") {
     RERR::ErrorMap map(RERR::ErrorMap::Config()
                            .SetNoErrorCode(0)
@@ -44,3 +71,114 @@ TEST_CASE("Err2Code C++ Example") {
     REQUIRE(err.GetDomain() == RERR::RichErrorsDomain());
     REQUIRE(err.GetCode() == RERR_ECODE_MAP_INVALID_CODE);
 }
+
+TEST_CASE("Err2Code C++ batch") {
+    RERR::ErrorMap map(RERR::ErrorMap::Config()
+                           .SetNoErrorCode(0)
+                           .SetOutOfMemoryCode(-1)
+                           .SetMapFailureCode(-2)
+                           .SetMappedRange(1, 32767));
+
+    const char *msg = TESTSTR("msg");
+    std::vector<RERR::Error> errors;
+    errors.emplace_back(RERR::Error(msg));
+    errors.emplace_back();
+    errors.emplace_back(RERR::Error::OutOfMemory());
+
+    std::vector<int32_t> codes;
+    map.RegisterThreadLocal(errors.begin(), errors.end(),
+                            std::back_inserter(codes));
+    REQUIRE(codes.size() == 3);
+    REQUIRE(codes[0] == 1);
+    REQUIRE(codes[1] == 0);
+    REQUIRE(codes[2] == -1);
+    REQUIRE(errors[0].IsSuccess());
+
+    std::vector<RERR::Error> retrieved(3);
+    auto end = map.RetrieveThreadLocal(codes.begin(), codes.end(),
+                                       retrieved.begin());
+    REQUIRE(end == retrieved.end());
+    REQUIRE(retrieved[0].GetMessage() == msg);
+    REQUIRE(retrieved[1].IsSuccess());
+    REQUIRE(retrieved[2].IsOutOfMemory());
+
+    // Errors not yet written when the output throws are not leaked
+    errors.clear();
+    for (int i = 0; i < 3; ++i) {
+        errors.emplace_back(RERR::Error(msg));
+    }
+    codes.clear();
+    map.RegisterThreadLocal(errors.begin(), errors.end(),
+                            std::back_inserter(codes));
+    retrieved.clear();
+    REQUIRE_THROWS_AS(map.RetrieveThreadLocal(codes.begin(), codes.end(),
+                                              ThrowingOutput{&retrieved, 1}),
+                      std::runtime_error);
+    REQUIRE(retrieved.size() == 1);
+    REQUIRE(retrieved[0].GetMessage() == msg);
+    REQUIRE_FALSE(map.IsRegisteredThreadLocal(codes[2]));
+
+    // More errors than are passed to the C functions at a time
+    errors.clear();
+    for (int i = 0; i < 200; ++i) {
+        errors.emplace_back(RERR::Error(std::to_string(i)));
+    }
+    codes.clear();
+    map.RegisterThreadLocal(errors.begin(), errors.end(),
+                            std::back_inserter(codes));
+    REQUIRE(codes.size() == 200);
+    retrieved.clear();
+    map.RetrieveThreadLocal(codes.begin(), codes.end(),
+                            std::back_inserter(retrieved));
+    REQUIRE(retrieved.size() == 200);
+    for (int i = 0; i < 200; ++i) {
+        REQUIRE(retrieved[i].GetMessage() == std::to_string(i));
+    }
+}
+
+TEST_CASE("Err2Code C++ thread exit and limit") {
+    RERR::ErrorMap map(
+        RERR::ErrorMap::Config()
+            .SetNoErrorCode(0)
+            .SetOutOfMemoryCode(-1)
+            .SetMapFailureCode(-2)
+            .SetMappedRange(1, 32767)
+            .SetThreadExitPolicy(RERR_ErrorMapThreadExit_Defer)
+            .SetMaxEntries(2, RERR_ErrorMapEviction_Oldest));
+
+    std::thread([&map] {
+        map.RegisterThreadLocal(RERR::Error("msg"));
+    }).join();
+    map.ReapDeadThreads();
+
+    int32_t first = map.RegisterThreadLocal(RERR::Error("first"));
+    int32_t second = map.RegisterThreadLocal(RERR::Error("second"));
+    int32_t third = map.RegisterThreadLocal(RERR::Error("third"));
+    REQUIRE(third > 0);
+    REQUIRE_FALSE(map.IsRegisteredThreadLocal(first));
+    REQUIRE(map.RetrieveThreadLocal(second).GetMessage() == "second");
+
+    REQUIRE_THROWS_AS(
+        RERR::ErrorMap(RERR::ErrorMap::Config()
+                           .SetNoErrorCode(0)
+                           .SetOutOfMemoryCode(-1)
+                           .SetMapFailureCode(-2)
+                           .SetMappedRange(1, 32767)
+                           .SetThreadExitPolicy(-1)),
+        RERR::Exception);
+}
+
+TEST_CASE("Err2Code C++ single-threaded") {
+    RERR::ErrorMap map(RERR::ErrorMap::Config()
+                           .SetNoErrorCode(0)
+                           .SetOutOfMemoryCode(-1)
+                           .SetMapFailureCode(-2)
+                           .SetMappedRange(1, 32767)
+                           .SetSingleThreaded());
+
+    int32_t code = map.RegisterThreadLocal(RERR::Error("msg"));
+    REQUIRE(code == 1);
+    REQUIRE(map.RetrieveThreadLocal(code).GetMessage() == "msg");
+    REQUIRE(map.RetrieveThreadLocal(code).GetCode() ==
+            RERR_ECODE_MAP_INVALID_CODE);
+}
@@ -9,6 +9,8 @@
 #include "TestDefs.h"
 
 #include <cstring>
+#include <thread>
+#include <vector>
 
 TEST_CASE("Map creation parameters") {
     RERR_ErrorMapConfig config;
@@ -134,6 +136,45 @@ TEST_CASE("Code exhaustion") {
 
     RERR_ErrorMap_Destroy(map);
 
+    // Every code of a range whose size is not a power of 2
+    config.minMappedCode = 1;
+    config.maxMappedCode = 10;
+    err = RERR_ErrorMap_Create(&map, &config);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    std::vector<bool> seen(11);
+    for (int i = 0; i < 10; ++i) {
+        testErr = RERR_Error_Create(TESTSTR("msg"));
+        code = RERR_ErrorMap_RegisterThreadLocal(map, testErr);
+        REQUIRE(code >= 1);
+        REQUIRE(code <= 10);
+        REQUIRE_FALSE(seen[code]);
+        seen[code] = true;
+    }
+
+    testErr = RERR_Error_Create(TESTSTR("msg"));
+    code = RERR_ErrorMap_RegisterThreadLocal(map, testErr);
+    REQUIRE(code == config.mapFailureCode);
+
+    RERR_ErrorMap_Destroy(map);
+
+    // More outstanding codes than 2^16
+    config.minMappedCode = 1;
+    config.maxMappedCode = 70000;
+    err = RERR_ErrorMap_Create(&map, &config);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    int failures = 0;
+    for (int i = 0; i < 70000; ++i) {
+        testErr = RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS, i, "msg");
+        if (RERR_ErrorMap_RegisterThreadLocal(map, testErr) < 1) {
+            ++failures;
+        }
+    }
+    REQUIRE(failures == 0);
+
+    RERR_ErrorMap_Destroy(map);
+
     // Wrap around
     config.minMappedCode = INT32_MAX;
     config.maxMappedCode = INT32_MIN;
@@ -155,6 +196,154 @@ TEST_CASE("Code exhaustion") {
     RERR_ErrorMap_Destroy(map);
 }
 
+TEST_CASE("Many outstanding codes and reuse") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err = RERR_ErrorMap_Create(&map, &config);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    const int n = 1000;
+    std::vector<int32_t> codes;
+    for (int i = 0; i < n; ++i) {
+        codes.push_back(RERR_ErrorMap_RegisterThreadLocal(
+            map, RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS, i, "msg")));
+        REQUIRE(codes.back() >= config.minMappedCode);
+        REQUIRE(codes.back() <= config.maxMappedCode);
+    }
+    for (int i = 0; i < n; ++i) {
+        REQUIRE(RERR_ErrorMap_IsRegisteredThreadLocal(map, codes[i]));
+    }
+
+    // Retrieve in a different order from registration
+    for (int i = n - 1; i >= 0; i -= 2) {
+        err = RERR_ErrorMap_RetrieveThreadLocal(map, codes[i]);
+        REQUIRE(RERR_Error_GetCode(err) == i);
+        RERR_Error_Destroy(err);
+    }
+
+    // Freed codes are not immediately reissued
+    int32_t code = RERR_ErrorMap_RegisterThreadLocal(
+        map, RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS, n, "msg"));
+    REQUIRE(code != codes[n - 1]);
+    REQUIRE(!RERR_ErrorMap_IsRegisteredThreadLocal(map, codes[n - 1]));
+    err = RERR_ErrorMap_RetrieveThreadLocal(map, code);
+    REQUIRE(RERR_Error_GetCode(err) == n);
+    RERR_Error_Destroy(err);
+
+    // Many cycles of register/retrieve with some codes still outstanding
+    for (int i = 0; i < 100000; ++i) {
+        code = RERR_ErrorMap_RegisterThreadLocal(
+            map, RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS, i, "msg"));
+        REQUIRE(code >= config.minMappedCode);
+        REQUIRE(code <= config.maxMappedCode);
+        err = RERR_ErrorMap_RetrieveThreadLocal(map, code);
+        REQUIRE(RERR_Error_GetCode(err) == i);
+        RERR_Error_Destroy(err);
+    }
+    for (int i = 0; i < n; i += 2) {
+        err = RERR_ErrorMap_RetrieveThreadLocal(map, codes[i]);
+        REQUIRE(RERR_Error_GetCode(err) == i);
+        RERR_Error_Destroy(err);
+    }
+
+    RERR_ErrorMap_Destroy(map);
+}
+
+TEST_CASE("Retrieved codes are not soon reassigned") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err = RERR_ErrorMap_Create(&map, &config);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    int32_t stale = RERR_ErrorMap_RegisterThreadLocal(
+        map, RERR_Error_Create(TESTSTR("msg")));
+    RERR_Error_Destroy(RERR_ErrorMap_RetrieveThreadLocal(map, stale));
+
+    for (int i = 0; i < 10000; ++i) {
+        int32_t code = RERR_ErrorMap_RegisterThreadLocal(
+            map, RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS, i, "msg"));
+        REQUIRE(code != stale);
+        REQUIRE(!RERR_ErrorMap_IsRegisteredThreadLocal(map, stale));
+        err = RERR_ErrorMap_RetrieveThreadLocal(map, code);
+        REQUIRE(RERR_Error_GetCode(err) == i);
+        RERR_Error_Destroy(err);
+    }
+
+    err = RERR_ErrorMap_RetrieveThreadLocal(map, stale);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_MAP_INVALID_CODE);
+    RERR_Error_Destroy(err);
+
+    RERR_ErrorMap_Destroy(map);
+}
+
+TEST_CASE("Batch register and retrieve") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err = RERR_ErrorMap_Create(&map, &config);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    // Empty batch
+    RERR_ErrorMap_RegisterThreadLocalBatch(map, NULL, 0, NULL);
+    RERR_ErrorMap_RetrieveThreadLocalBatch(map, NULL, 0, NULL);
+
+    const size_t n = 256;
+    std::vector<RERR_ErrorPtr> errors(n);
+    errors[1] = RERR_NO_ERROR;
+    errors[2] = RERR_Error_CreateOutOfMemory();
+    for (size_t i = 0; i < n; ++i) {
+        if (i != 1 && i != 2) {
+            errors[i] = RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                                  (int32_t)i, "msg");
+        }
+    }
+
+    std::vector<int32_t> codes(n);
+    RERR_ErrorMap_RegisterThreadLocalBatch(map, errors.data(), n,
+                                           codes.data());
+    for (size_t i = 0; i < n; ++i) {
+        REQUIRE(errors[i] == RERR_NO_ERROR);
+    }
+    REQUIRE(codes[1] == config.noErrorCode);
+    REQUIRE(codes[2] == config.outOfMemoryCode);
+
+    RERR_ErrorMap_RetrieveThreadLocalBatch(map, codes.data(), n,
+                                           errors.data());
+    REQUIRE(errors[1] == RERR_NO_ERROR);
+    REQUIRE(RERR_Error_IsOutOfMemory(errors[2]));
+    for (size_t i = 0; i < n; ++i) {
+        if (i != 1 && i != 2) {
+            REQUIRE(RERR_Error_GetCode(errors[i]) == (int32_t)i);
+        }
+        RERR_Error_Destroy(errors[i]);
+    }
+
+    // Codes are no longer registered
+    RERR_ErrorMap_RetrieveThreadLocalBatch(map, codes.data(), 1,
+                                           errors.data());
+    REQUIRE(RERR_Error_GetCode(errors[0]) == RERR_ECODE_MAP_INVALID_CODE);
+    RERR_Error_Destroy(errors[0]);
+
+    RERR_ErrorMap_Destroy(map);
+}
+
 TEST_CASE("Clear") {
     RERR_ErrorMap_ClearThreadLocal(NULL); // Must not crash
 
@@ -185,3 +374,231 @@ TEST_CASE("Clear") {
 
     RERR_ErrorMap_Destroy(map);
 }
+
+TEST_CASE("Concurrent use from multiple threads") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err = RERR_ErrorMap_Create(&map, &config);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    const int nThreads = 8;
+    const int nErrors = 100;
+    std::vector<int> failures(nThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([map, t, &failures] {
+            std::vector<int32_t> codes;
+            for (int i = 0; i < nErrors; ++i) {
+                codes.push_back(RERR_ErrorMap_RegisterThreadLocal(
+                    map, RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                                   t * nErrors + i, "msg")));
+            }
+            // Leave some registered for Destroy() to clean up
+            for (int i = 0; i < nErrors / 2; ++i) {
+                RERR_ErrorPtr e =
+                    RERR_ErrorMap_RetrieveThreadLocal(map, codes[i]);
+                if (RERR_Error_GetCode(e) != t * nErrors + i) {
+                    ++failures[t];
+                }
+                RERR_Error_Destroy(e);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < nThreads; ++t) {
+        REQUIRE(failures[t] == 0);
+    }
+
+    RERR_ErrorMap_Destroy(map);
+}
+
+TEST_CASE("Entry limit and eviction") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    RERR_ErrorMapOptions options;
+    memset(&options, 0, sizeof(options));
+    options.maxEntries = 3;
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err;
+
+    options.evictionPolicy = 42;
+    err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_MAP_INVALID_CONFIG);
+    RERR_Error_Destroy(err);
+
+    SECTION("No eviction") {
+        options.evictionPolicy = RERR_ErrorMapEviction_None;
+        err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+        REQUIRE(err == RERR_NO_ERROR);
+        int32_t codes[4];
+        for (int i = 0; i < 4; ++i) {
+            codes[i] = RERR_ErrorMap_RegisterThreadLocal(
+                map, RERR_Error_Create(TESTSTR("msg")));
+        }
+        REQUIRE(codes[2] > 0);
+        REQUIRE(codes[3] == config.mapFailureCode);
+
+        // Retrieval makes room
+        RERR_Error_Destroy(RERR_ErrorMap_RetrieveThreadLocal(map, codes[0]));
+        REQUIRE(RERR_ErrorMap_RegisterThreadLocal(
+                    map, RERR_Error_Create(TESTSTR("msg"))) > 0);
+    }
+
+    SECTION("Evict oldest") {
+        options.evictionPolicy = RERR_ErrorMapEviction_Oldest;
+        err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+        REQUIRE(err == RERR_NO_ERROR);
+        int32_t codes[5];
+        for (int i = 0; i < 5; ++i) {
+            codes[i] = RERR_ErrorMap_RegisterThreadLocal(
+                map, RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS,
+                                               100 + i, "msg"));
+            REQUIRE(codes[i] > 0);
+            if (i == 1) {
+                // Retrieving out of order must keep the order of the rest
+                RERR_Error_Destroy(
+                    RERR_ErrorMap_RetrieveThreadLocal(map, codes[0]));
+            }
+        }
+        // codes[1] was evicted
+        REQUIRE_FALSE(RERR_ErrorMap_IsRegisteredThreadLocal(map, codes[1]));
+        for (int i = 2; i < 5; ++i) {
+            err = RERR_ErrorMap_RetrieveThreadLocal(map, codes[i]);
+            REQUIRE(RERR_Error_GetCode(err) == 100 + i);
+            RERR_Error_Destroy(err);
+        }
+    }
+
+    RERR_ErrorMap_Destroy(map);
+}
+
+TEST_CASE("Thread exit cleanup") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    // With a limit and no eviction, registration only succeeds once the
+    // exited threads' entries are released.
+    const int nErrors = 10;
+    RERR_ErrorMapOptions options;
+    memset(&options, 0, sizeof(options));
+    options.maxEntries = nErrors;
+
+    auto registerAll = [&](RERR_ErrorMapPtr map) {
+        int succeeded = 0;
+        for (int i = 0; i < nErrors; ++i) {
+            int32_t code = RERR_ErrorMap_RegisterThreadLocal(
+                map, RERR_Error_Create(TESTSTR("msg")));
+            if (code > 0) {
+                ++succeeded;
+            }
+        }
+        return succeeded;
+    };
+    auto registerOnThread = [&](RERR_ErrorMapPtr map) {
+        int succeeded = 0;
+        std::thread([&] { succeeded = registerAll(map); }).join();
+        return succeeded;
+    };
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err;
+
+    SECTION("Keep") {
+        options.threadExitPolicy = RERR_ErrorMapThreadExit_Keep;
+        err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+        REQUIRE(err == RERR_NO_ERROR);
+        REQUIRE(registerOnThread(map) == nErrors);
+        RERR_ErrorMap_ReapDeadThreads(map); // No effect
+        REQUIRE(registerAll(map) == 0);
+    }
+
+    SECTION("Release") {
+        options.threadExitPolicy = RERR_ErrorMapThreadExit_Release;
+        err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+        REQUIRE(err == RERR_NO_ERROR);
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(registerOnThread(map) == nErrors);
+        }
+        REQUIRE(registerAll(map) == nErrors);
+        // The main thread's entries are released by Destroy()
+    }
+
+    SECTION("Defer") {
+        options.threadExitPolicy = RERR_ErrorMapThreadExit_Defer;
+        err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+        REQUIRE(err == RERR_NO_ERROR);
+        REQUIRE(registerOnThread(map) == nErrors);
+        REQUIRE(registerAll(map) == 0);
+        RERR_ErrorMap_ReapDeadThreads(map);
+        REQUIRE(registerOnThread(map) == nErrors);
+        RERR_ErrorMap_ReapDeadThreads(map);
+        REQUIRE(registerAll(map) == nErrors);
+    }
+
+    RERR_ErrorMap_Destroy(map);
+}
+
+TEST_CASE("Single-threaded map") {
+    RERR_ErrorMapConfig config;
+    config.minMappedCode = 1;
+    config.maxMappedCode = 32767;
+    config.noErrorCode = 0;
+    config.outOfMemoryCode = -1;
+    config.mapFailureCode = -2;
+
+    RERR_ErrorMapOptions options;
+    memset(&options, 0, sizeof(options));
+    options.flags = RERR_ErrorMapFlag_SingleThreaded;
+
+    RERR_ErrorMapPtr map;
+    RERR_ErrorPtr err;
+
+    options.threadExitPolicy = RERR_ErrorMapThreadExit_Release;
+    err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_MAP_INVALID_CONFIG);
+    RERR_Error_Destroy(err);
+    options.threadExitPolicy = RERR_ErrorMapThreadExit_Keep;
+
+    options.maxEntries = 100;
+    options.evictionPolicy = RERR_ErrorMapEviction_Oldest;
+    err = RERR_ErrorMap_CreateWithOptions(&map, &config, &options);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    std::vector<int32_t> codes;
+    for (int i = 0; i < 200; ++i) {
+        codes.push_back(RERR_ErrorMap_RegisterThreadLocal(
+            map,
+            RERR_Error_CreateWithCode(RERR_DOMAIN_RICHERRORS, i, "msg")));
+    }
+    REQUIRE_FALSE(RERR_ErrorMap_IsRegisteredThreadLocal(map, codes[99]));
+    std::vector<RERR_ErrorPtr> errors(50);
+    RERR_ErrorMap_RetrieveThreadLocalBatch(map, codes.data() + 100, 50,
+                                           errors.data());
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(RERR_Error_GetCode(errors[i]) == 100 + i);
+        RERR_Error_Destroy(errors[i]);
+    }
+    REQUIRE(RERR_ErrorMap_IsRegisteredThreadLocal(map, codes[150]));
+    RERR_ErrorMap_ClearThreadLocal(map);
+    REQUIRE_FALSE(RERR_ErrorMap_IsRegisteredThreadLocal(map, codes[150]));
+
+    RERR_ErrorMap_Destroy(map);
+}
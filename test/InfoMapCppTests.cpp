@@ -47,3 +47,85 @@ TEST_CASE("C++ Iteration", "[RERR::InfoMap]") {
         }
     }
 }
+
+TEST_CASE("C++ initializer list", "[RERR::InfoMap]") {
+    using Item = RERR::InfoMap::InitItem;
+    RERR::InfoMap m{
+        Item::String("k0", "value"), Item::Bool("k1", true),
+        Item::I64("k2", -42),        Item::U64("k3", 42),
+        Item::F64("k4", 42.5),
+    };
+
+    REQUIRE(m.GetSize() == 5);
+    std::string s;
+    REQUIRE(m.GetString("k0", s));
+    REQUIRE(s == "value");
+    int64_t i64;
+    REQUIRE(m.GetI64("k2", i64));
+    REQUIRE(i64 == -42);
+    double f64;
+    REQUIRE(m.GetF64("k4", f64));
+    REQUIRE(f64 == 42.5);
+}
+
+TEST_CASE("C++ bytes and arrays", "[RERR::InfoMap]") {
+    RERR::InfoMap m;
+    std::vector<unsigned char> bytes{1, 2, 3};
+    const double doubles[] = {0.5, 1.5};
+    m.SetBytes("b", bytes);
+    m.SetI64Array("i", {-1, 0, 1});
+    m.SetF64Array("f", doubles);
+
+    RERR::Span<unsigned char> b;
+    REQUIRE(m.GetBytes("b", b));
+    REQUIRE(std::vector<unsigned char>(b.begin(), b.end()) == bytes);
+    RERR::Span<int64_t> i;
+    REQUIRE(m.GetI64Array("i", i));
+    REQUIRE(i.Size() == 3);
+    REQUIRE(i[0] == -1);
+    RERR::Span<double> f;
+    REQUIRE_FALSE(m.GetF64Array("i", f));
+    REQUIRE(f.IsEmpty());
+
+    m.MakeImmutable();
+    RERR::InfoMapView view(m.GetCPtr());
+    REQUIRE(view.GetF64Array("f", f));
+    REQUIRE(f.Size() == 2);
+    REQUIRE(f[1] == 1.5);
+
+    std::size_t n = 0;
+    for (auto const &item : m) {
+        switch (item.GetType()) {
+        case RERR_InfoValueTypeBytes:
+            REQUIRE(item.GetBytes().Size() == 3);
+            break;
+        case RERR_InfoValueTypeF64Array:
+            REQUIRE(item.GetF64Array()[0] == 0.5);
+            break;
+        case RERR_InfoValueTypeI64Array:
+            REQUIRE(item.GetI64Array()[2] == 1);
+            break;
+        default:
+            REQUIRE(false);
+        }
+        ++n;
+    }
+    REQUIRE(n == 3);
+}
+
+TEST_CASE("C++ overlay", "[RERR::InfoMap]") {
+    RERR::InfoMap base;
+    base.SetString("device", "camera0");
+    base.MakeImmutable();
+
+    RERR::InfoMap m = RERR::InfoMap::Overlay(base);
+    m.SetI64("channel", 3);
+    REQUIRE(m.GetSize() == 2);
+    std::string s;
+    REQUIRE(m.GetString("device", s));
+    REQUIRE(s == "camera0");
+
+    m.Flatten();
+    base = RERR::InfoMap();
+    REQUIRE(m.Keys() == std::vector<std::string>{"channel", "device"});
+}
@@ -10,6 +10,12 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST_CASE("Null behavior", "[RERR_InfoMap]") {
     RERR_InfoMap_Destroy(nullptr);
 
@@ -107,6 +113,330 @@ TEST_CASE("Strings", "[RERR_InfoMap]") {
     RERR_InfoMap_Destroy(m);
 }
 
+TEST_CASE("String validity", "[RERR_InfoMap]") {
+    RERR_InfoMapPtr m = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(m, "a", "alpha");
+
+    // Valid across reads
+    const char *s;
+    REQUIRE(RERR_InfoMap_GetString(m, "a", &s));
+    REQUIRE(RERR_InfoMap_HasKey(m, "a"));
+    REQUIRE(RERR_InfoMap_GetSize(m) == 1);
+    REQUIRE(strcmp(s, "alpha") == 0);
+
+    // A retrieved string may be stored into the same map, even though the
+    // storage it points to moves
+    for (int i = 0; i < 100; ++i) {
+        std::string key = "k" + std::to_string(i);
+        REQUIRE(RERR_InfoMap_GetString(m, "a", &s));
+        RERR_InfoMap_SetString(m, key.c_str(), s);
+    }
+
+    // Any modification invalidates strings, so they must be retrieved again
+    RERR_InfoMap_SetI64(m, "n", 42);
+    REQUIRE(RERR_InfoMap_GetString(m, "k99", &s));
+    REQUIRE(strcmp(s, "alpha") == 0);
+
+    // Strings of an immutable map are valid until it is destroyed
+    RERR_InfoMap_MakeImmutable(m);
+    REQUIRE(RERR_InfoMap_GetString(m, "k0", &s));
+    RERR_InfoMapPtr copy = RERR_InfoMap_Copy(m);
+    RERR_InfoMap_Destroy(m);
+    REQUIRE(strcmp(s, "alpha") == 0);
+    RERR_InfoMap_Destroy(copy);
+}
+
+TEST_CASE("Concurrent sharing of immutable copies", "[RERR_InfoMap]") {
+    RERR_InfoMapPtr map = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(map, "key", "value");
+    RERR_InfoMap_MakeImmutable(map);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        std::vector<RERR_InfoMapPtr> copies(1000);
+        for (auto &copy : copies) {
+            copy = RERR_InfoMap_Copy(map);
+        }
+        threads.emplace_back([copies] {
+            for (auto copy : copies) {
+                const char *value;
+                (void)RERR_InfoMap_GetString(copy, "key", &value);
+                RERR_InfoMap_Destroy(copy);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(RERR_InfoMap_GetSize(map) == 1);
+    RERR_InfoMap_Destroy(map);
+}
+
+TEST_CASE("Growth, overwrite, and removal", "[RERR_InfoMap]") {
+    RERR_InfoMapPtr m = RERR_InfoMap_Create();
+    for (int i = 0; i < 50; ++i) {
+        std::string key = "key" + std::to_string(i);
+        std::string value(i, 'v');
+        RERR_InfoMap_SetString(m, key.c_str(), value.c_str());
+        RERR_InfoMap_SetI64(m, ("i" + key).c_str(), i);
+    }
+    REQUIRE(RERR_InfoMap_GetSize(m) == 100);
+
+    // Repeated overwriting must not grow without bound or corrupt others
+    for (int i = 0; i < 1000; ++i) {
+        RERR_InfoMap_SetString(m, "key7", std::string(100, 'x').c_str());
+    }
+    for (int i = 0; i < 50; i += 2) {
+        RERR_InfoMap_Remove(m, ("key" + std::to_string(i)).c_str());
+    }
+    REQUIRE(RERR_InfoMap_GetSize(m) == 75);
+
+    // Value may alias a string in the same map
+    const char *alias;
+    REQUIRE(RERR_InfoMap_GetString(m, "key49", &alias));
+    RERR_InfoMap_SetString(m, "new", alias);
+
+    RERR_InfoMap_ReserveCapacity(m, 0); // Compact
+
+    RERR_InfoMapPtr c = RERR_InfoMap_MutableCopy(m);
+    RERR_InfoMap_Destroy(m);
+    const char *value;
+    REQUIRE(RERR_InfoMap_GetString(c, "key7", &value));
+    REQUIRE(value == std::string(100, 'x'));
+    REQUIRE(RERR_InfoMap_GetString(c, "new", &value));
+    REQUIRE(value == std::string(49, 'v'));
+    REQUIRE(!RERR_InfoMap_HasKey(c, "key8"));
+    for (int i = 1; i < 50; i += 2) {
+        std::string key = "key" + std::to_string(i);
+        REQUIRE(RERR_InfoMap_GetString(c, key.c_str(), &value));
+        if (i != 7) {
+            REQUIRE(value == std::string(i, 'v'));
+        }
+        int64_t i64;
+        REQUIRE(RERR_InfoMap_GetI64(c, ("i" + key).c_str(), &i64));
+        REQUIRE(i64 == i);
+    }
+    RERR_InfoMap_SetString(c, "key7", "short");
+    REQUIRE(RERR_InfoMap_GetString(c, "key7", &value));
+    REQUIRE(strcmp(value, "short") == 0);
+    RERR_InfoMap_Destroy(c);
+}
+
+TEST_CASE("Large maps iterate in key order", "[RERR_InfoMap]") {
+    // Insert in scrambled order (37 is coprime to 300)
+    const int n = 300;
+    RERR_InfoMapPtr m = RERR_InfoMap_Create();
+    for (int i = 0; i < n; ++i) {
+        int k = (i * 37) % n;
+        char key[16];
+        snprintf(key, sizeof(key), "reg%03d", k);
+        RERR_InfoMap_SetI64(m, key, k);
+    }
+    for (int k = 0; k < n; k += 3) {
+        char key[16];
+        snprintf(key, sizeof(key), "reg%03d", k);
+        RERR_InfoMap_Remove(m, key);
+    }
+    REQUIRE(RERR_InfoMap_GetSize(m) == 200);
+    for (int k = 0; k < n; ++k) {
+        char key[16];
+        snprintf(key, sizeof(key), "reg%03d", k);
+        int64_t value;
+        REQUIRE(RERR_InfoMap_GetI64(m, key, &value) == (k % 3 != 0));
+        if (k % 3 != 0) {
+            REQUIRE(value == k);
+        }
+    }
+
+    auto checkSorted = [](RERR_InfoMapPtr map, size_t expectedCount) {
+        size_t count = 0;
+        std::string prev;
+        for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(map),
+                                  end = RERR_InfoMap_End(map);
+             it != end; it = RERR_InfoMap_Advance(map, it)) {
+            std::string key = RERR_InfoMapIterator_GetKey(it);
+            REQUIRE(prev < key);
+            prev = key;
+            ++count;
+        }
+        REQUIRE(count == expectedCount);
+    };
+
+    RERR_InfoMapPtr c = RERR_InfoMap_MutableCopy(m);
+    RERR_InfoMapPtr f = RERR_InfoMap_ImmutableCopy(m);
+    checkSorted(m, 200);
+    checkSorted(f, 200);
+    RERR_InfoMap_Destroy(f);
+
+    // Shrink below the hash-indexed size
+    for (int k = 0; k < n; ++k) {
+        if (k % 30 != 1) {
+            char key[16];
+            snprintf(key, sizeof(key), "reg%03d", k);
+            RERR_InfoMap_Remove(c, key);
+        }
+    }
+    RERR_InfoMap_ReserveCapacity(c, 0);
+    checkSorted(c, 10);
+    REQUIRE(RERR_InfoMap_HasKey(c, "reg031"));
+    RERR_InfoMap_SetBool(c, "reg000", true);
+    checkSorted(c, 11);
+
+    RERR_InfoMap_Clear(m);
+    REQUIRE(!RERR_InfoMap_HasKey(m, "reg001"));
+    RERR_InfoMap_SetBool(m, "b", true);
+    RERR_InfoMap_SetBool(m, "a", true);
+    checkSorted(m, 2);
+
+    RERR_InfoMap_Destroy(c);
+    RERR_InfoMap_Destroy(m);
+}
+
+TEST_CASE("Create from items", "[RERR_InfoMap]") {
+    RERR_InfoMapPtr m = RERR_InfoMap_CreateFromItems(NULL, 0, 0);
+    REQUIRE(RERR_InfoMap_IsEmpty(m));
+    REQUIRE(RERR_InfoMap_IsMutable(m));
+    RERR_InfoMap_Destroy(m);
+
+    RERR_InfoMapInitItem items[6];
+    items[0].key = "s";
+    items[0].type = RERR_InfoValueTypeString;
+    items[0].value.string = "value";
+    items[1].key = "b";
+    items[1].type = RERR_InfoValueTypeBool;
+    items[1].value.boolean = true;
+    items[2].key = "i";
+    items[2].type = RERR_InfoValueTypeI64;
+    items[2].value.i64 = -42;
+    items[3].key = NULL; // Skipped
+    items[3].type = RERR_InfoValueTypeI64;
+    items[3].value.i64 = 0;
+    items[4].key = "i"; // Duplicate; last wins
+    items[4].type = RERR_InfoValueTypeU64;
+    items[4].value.u64 = 42;
+    items[5].key = "f";
+    items[5].type = RERR_InfoValueTypeF64;
+    items[5].value.f64 = 42.5;
+
+    m = RERR_InfoMap_CreateFromItems(items, 6, RERR_InfoMapCreateImmutable);
+    REQUIRE(!RERR_InfoMap_IsMutable(m));
+    REQUIRE(RERR_InfoMap_HasProgrammingErrors(m));
+    REQUIRE(RERR_InfoMap_GetSize(m) == 4);
+    const char *s;
+    REQUIRE(RERR_InfoMap_GetString(m, "s", &s));
+    REQUIRE(strcmp(s, "value") == 0);
+    bool b;
+    REQUIRE(RERR_InfoMap_GetBool(m, "b", &b));
+    REQUIRE(b);
+    uint64_t u;
+    REQUIRE(RERR_InfoMap_GetU64(m, "i", &u));
+    REQUIRE(u == 42);
+    double f;
+    REQUIRE(RERR_InfoMap_GetF64(m, "f", &f));
+    REQUIRE(f == 42.5);
+    std::string keys;
+    for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(m),
+                              end = RERR_InfoMap_End(m);
+         it != end; it = RERR_InfoMap_Advance(m, it)) {
+        keys += RERR_InfoMapIterator_GetKey(it);
+    }
+    REQUIRE(keys == "bfis");
+    RERR_InfoMap_Destroy(m);
+
+    // Large, presorted
+    std::vector<std::string> keyStrings;
+    for (int i = 0; i < 100; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%03d", i);
+        keyStrings.push_back(key);
+    }
+    std::vector<RERR_InfoMapInitItem> many(keyStrings.size());
+    for (size_t i = 0; i < many.size(); ++i) {
+        many[i].key = keyStrings[i].c_str();
+        many[i].type = RERR_InfoValueTypeI64;
+        many[i].value.i64 = (int64_t)i;
+    }
+    m = RERR_InfoMap_CreateFromItems(many.data(), many.size(),
+                                     RERR_InfoMapCreatePresorted);
+    REQUIRE(RERR_InfoMap_GetSize(m) == 100);
+    int64_t i64;
+    REQUIRE(RERR_InfoMap_GetI64(m, "key057", &i64));
+    REQUIRE(i64 == 57);
+    RERR_InfoMap_SetI64(m, "key100", 100);
+    REQUIRE(RERR_InfoMap_GetSize(m) == 101);
+    RERR_InfoMap_Destroy(m);
+
+    // Large, reversed, with a duplicate
+    std::reverse(many.begin(), many.end());
+    many.back().key = "key050";
+    m = RERR_InfoMap_CreateFromItems(many.data(), many.size(), 0);
+    REQUIRE(RERR_InfoMap_GetSize(m) == 99);
+    REQUIRE(RERR_InfoMap_GetI64(m, "key050", &i64));
+    REQUIRE(i64 == 0);
+    REQUIRE(!RERR_InfoMap_HasKey(m, "key000"));
+    std::string prev;
+    for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(m),
+                              end = RERR_InfoMap_End(m);
+         it != end; it = RERR_InfoMap_Advance(m, it)) {
+        REQUIRE(prev < RERR_InfoMapIterator_GetKey(it));
+        prev = RERR_InfoMapIterator_GetKey(it);
+    }
+    RERR_InfoMap_Destroy(m);
+}
+
+TEST_CASE("Static keys", "[RERR_InfoMap]") {
+    static const char *const keys[] = {"path", "errno", "channel", "mode"};
+    RERR_InfoMapPtr m = RERR_InfoMap_Create();
+    RERR_InfoMap_SetStringStaticKey(m, keys[0], "/dev/null");
+    RERR_InfoMap_SetI64StaticKey(m, keys[1], 2);
+    RERR_InfoMap_SetU64StaticKey(m, keys[2], 3);
+    RERR_InfoMap_SetBoolStaticKey(m, keys[3], true);
+    RERR_InfoMap_SetF64StaticKey(m, "gain", 1.5);
+    RERR_InfoMap_SetString(m, "path", "/dev/zero"); // Keeps existing key
+
+    // Keys are not copied
+    RERR_InfoMapIterator it = RERR_InfoMap_Begin(m);
+    REQUIRE(RERR_InfoMapIterator_GetKey(it) == keys[2]);
+
+    // Lookup by content (not only by pointer)
+    const char *s;
+    REQUIRE(RERR_InfoMap_GetString(m, std::string("path").c_str(), &s));
+    REQUIRE(strcmp(s, "/dev/zero") == 0);
+
+    // Mix with copied keys, causing relocation of the arena
+    for (int i = 0; i < 40; ++i) {
+        RERR_InfoMap_SetI64(m, ("k" + std::to_string(i)).c_str(), i);
+    }
+    RERR_InfoMapPtr c = RERR_InfoMap_MutableCopy(m);
+    RERR_InfoMap_Destroy(m);
+    RERR_InfoMap_Remove(c, keys[1]);
+    RERR_InfoMap_ReserveCapacity(c, 0);
+    REQUIRE(RERR_InfoMap_GetSize(c) == 44);
+    int64_t i64;
+    REQUIRE(RERR_InfoMap_GetI64(c, "k39", &i64));
+    REQUIRE(i64 == 39);
+    uint64_t u64;
+    REQUIRE(RERR_InfoMap_GetU64(c, "channel", &u64));
+    REQUIRE(u64 == 3);
+    REQUIRE(!RERR_InfoMap_HasKey(c, "errno"));
+    RERR_InfoMap_Destroy(c);
+
+    RERR_InfoMapInitItem items[2];
+    items[0].key = keys[0];
+    items[0].type = RERR_InfoValueTypeString;
+    items[0].value.string = "/tmp";
+    items[1].key = keys[1];
+    items[1].type = RERR_InfoValueTypeI64;
+    items[1].value.i64 = 5;
+    m = RERR_InfoMap_CreateFromItems(items, 2, RERR_InfoMapCreateStaticKeys);
+    it = RERR_InfoMap_Begin(m);
+    REQUIRE(RERR_InfoMapIterator_GetKey(it) == keys[1]);
+    REQUIRE(RERR_InfoMap_GetString(m, "path", &s));
+    REQUIRE(strcmp(s, "/tmp") == 0);
+    RERR_InfoMap_Destroy(m);
+}
+
 TEST_CASE("Numeic", "[RERR_InfoMap]") {
     RERR_InfoMapPtr m = RERR_InfoMap_Create();
     REQUIRE(m != nullptr);
@@ -140,6 +470,283 @@ TEST_CASE("Numeic", "[RERR_InfoMap]") {
     RERR_InfoMap_Destroy(m);
 }
 
+TEST_CASE("Bytes and arrays", "[RERR_InfoMap]") {
+    RERR_InfoMapPtr m = RERR_InfoMap_Create();
+    REQUIRE(m != nullptr);
+
+    const unsigned char bytes[] = {0xde, 0xad, 0x00, 0xef};
+    const int64_t ints[] = {-1, 0, INT64_MAX};
+    const double doubles[] = {0.5, -2.25};
+    RERR_InfoMap_SetBytes(m, "bytes", bytes, sizeof(bytes));
+    RERR_InfoMap_SetI64Array(m, "ints", ints, 3);
+    RERR_InfoMap_SetF64Array(m, "doubles", doubles, 2);
+    RERR_InfoMap_SetBytes(m, "empty", nullptr, 0);
+
+    REQUIRE(RERR_InfoMap_GetType(m, "bytes") == RERR_InfoValueTypeBytes);
+    REQUIRE(RERR_InfoMap_GetType(m, "ints") == RERR_InfoValueTypeI64Array);
+    REQUIRE(RERR_InfoMap_GetType(m, "doubles") ==
+            RERR_InfoValueTypeF64Array);
+
+    const void *data;
+    size_t size;
+    REQUIRE(RERR_InfoMap_GetBytes(m, "bytes", &data, &size));
+    REQUIRE(size == sizeof(bytes));
+    REQUIRE(memcmp(data, bytes, size) == 0);
+    REQUIRE((uintptr_t)data % 8 == 0);
+    REQUIRE(RERR_InfoMap_GetBytes(m, "empty", &data, &size));
+    REQUIRE(size == 0);
+    REQUIRE_FALSE(RERR_InfoMap_GetBytes(m, "ints", &data, &size));
+    REQUIRE(data == nullptr);
+    REQUIRE(size == 0);
+
+    const int64_t *i64s;
+    size_t count;
+    REQUIRE(RERR_InfoMap_GetI64Array(m, "ints", &i64s, &count));
+    REQUIRE(count == 3);
+    REQUIRE(i64s[0] == -1);
+    REQUIRE(i64s[2] == INT64_MAX);
+    REQUIRE_FALSE(RERR_InfoMap_GetI64Array(m, "doubles", &i64s, &count));
+
+    const double *f64s;
+    REQUIRE(RERR_InfoMap_GetF64Array(m, "doubles", &f64s, &count));
+    REQUIRE(count == 2);
+    REQUIRE(f64s[1] == -2.25);
+
+    SECTION("Overwrite and remove") {
+        RERR_InfoMap_SetI64Array(m, "ints", ints, 1);
+        REQUIRE(RERR_InfoMap_GetI64Array(m, "ints", &i64s, &count));
+        REQUIRE(count == 1);
+        RERR_InfoMap_SetString(m, "bytes", "now a string");
+        REQUIRE(RERR_InfoMap_GetType(m, "bytes") == RERR_InfoValueTypeString);
+        RERR_InfoMap_Remove(m, "doubles");
+        REQUIRE_FALSE(RERR_InfoMap_HasKey(m, "doubles"));
+        // Force relocation of the remaining values
+        char key[16];
+        for (int i = 0; i < 100; ++i) {
+            snprintf(key, sizeof(key), "key%d", i);
+            RERR_InfoMap_SetBytes(m, key, bytes, sizeof(bytes));
+        }
+        REQUIRE(RERR_InfoMap_GetI64Array(m, "ints", &i64s, &count));
+        REQUIRE(count == 1);
+        REQUIRE(i64s[0] == -1);
+        REQUIRE(RERR_InfoMap_GetBytes(m, "key99", &data, &size));
+        REQUIRE(memcmp(data, bytes, size) == 0);
+        REQUIRE((uintptr_t)data % 8 == 0);
+    }
+
+    SECTION("Copies") {
+        RERR_InfoMap_GetBytes(m, "bytes", &data, &size);
+        RERR_InfoMap_MakeImmutable(m);
+        RERR_InfoMapPtr c = RERR_InfoMap_ImmutableCopy(m);
+        const void *copied;
+        REQUIRE(RERR_InfoMap_GetBytes(c, "bytes", &copied, &size));
+        REQUIRE(copied == data);
+        RERR_InfoMap_Destroy(c);
+
+        c = RERR_InfoMap_MutableCopy(m);
+        REQUIRE(RERR_InfoMap_GetBytes(c, "bytes", &copied, &size));
+        REQUIRE(copied != data);
+        REQUIRE(memcmp(copied, bytes, size) == 0);
+        RERR_InfoMap_SetBool(c, "more", true);
+        REQUIRE(RERR_InfoMap_GetF64Array(c, "doubles", &f64s, &count));
+        REQUIRE(f64s[0] == 0.5);
+        RERR_InfoMap_Destroy(c);
+    }
+
+    SECTION("Iteration") {
+        RERR_InfoMapIterator it = RERR_InfoMap_Begin(m);
+        REQUIRE(strcmp(RERR_InfoMapIterator_GetKey(it), "bytes") == 0);
+        REQUIRE(RERR_InfoMapIterator_GetBytes(it, &size) != nullptr);
+        REQUIRE(size == sizeof(bytes));
+        it = RERR_InfoMap_Advance(m, it);
+        REQUIRE(strcmp(RERR_InfoMapIterator_GetKey(it), "doubles") == 0);
+        f64s = RERR_InfoMapIterator_GetF64Array(it, &count);
+        REQUIRE(count == 2);
+        REQUIRE(f64s[0] == 0.5);
+        it = RERR_InfoMap_Advance(m, it);
+        it = RERR_InfoMap_Advance(m, it);
+        REQUIRE(strcmp(RERR_InfoMapIterator_GetKey(it), "ints") == 0);
+        i64s = RERR_InfoMapIterator_GetI64Array(it, &count);
+        REQUIRE(count == 3);
+        REQUIRE(i64s[1] == 0);
+    }
+
+    SECTION("Null data") {
+        RERR_InfoMap_SetBytes(m, "bad", nullptr, 1);
+        REQUIRE(RERR_InfoMap_HasProgrammingErrors(m));
+        REQUIRE_FALSE(RERR_InfoMap_HasKey(m, "bad"));
+    }
+
+    RERR_InfoMap_Destroy(m);
+}
+
+// Return the keys in iteration order, checking against the size.
+static std::vector<std::string> IteratedKeys(RERR_InfoMapPtr m) {
+    std::vector<std::string> ret;
+    RERR_InfoMapIterator end = RERR_InfoMap_End(m);
+    for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(m); it != end;
+         it = RERR_InfoMap_Advance(m, it)) {
+        ret.emplace_back(RERR_InfoMapIterator_GetKey(it));
+    }
+    REQUIRE(ret.size() == RERR_InfoMap_GetSize(m));
+    REQUIRE(std::is_sorted(ret.begin(), ret.end()));
+    return ret;
+}
+
+TEST_CASE("Overlay", "[RERR_InfoMap]") {
+    RERR_InfoMapPtr base = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(base, "a", "base");
+    RERR_InfoMap_SetI64(base, "b", 1);
+    const int64_t ints[] = {1, 2};
+    RERR_InfoMap_SetI64Array(base, "c", ints, 2);
+    RERR_InfoMap_MakeImmutable(base);
+
+    RERR_InfoMapPtr m = RERR_InfoMap_CreateOverlay(base);
+    REQUIRE(RERR_InfoMap_IsMutable(m));
+    REQUIRE(RERR_InfoMap_GetSize(m) == 3);
+    const char *baseStr;
+    const char *s;
+    RERR_InfoMap_GetString(base, "a", &baseStr);
+    REQUIRE(RERR_InfoMap_GetString(m, "a", &s));
+    REQUIRE(s == baseStr); // Not copied
+
+    RERR_InfoMap_SetString(m, "a", "overlay");
+    RERR_InfoMap_SetBool(m, "d", true);
+    RERR_InfoMap_Remove(m, "b");
+    RERR_InfoMap_Remove(m, "b");
+    RERR_InfoMap_Remove(m, "nonexistent");
+    REQUIRE(RERR_InfoMap_GetSize(m) == 3);
+    REQUIRE(RERR_InfoMap_GetString(m, "a", &s));
+    REQUIRE(strcmp(s, "overlay") == 0);
+    REQUIRE_FALSE(RERR_InfoMap_HasKey(m, "b"));
+    REQUIRE(RERR_InfoMap_GetType(m, "b") == RERR_InfoValueTypeInvalid);
+    int64_t i64;
+    REQUIRE_FALSE(RERR_InfoMap_GetI64(m, "b", &i64));
+    const int64_t *values;
+    size_t count;
+    REQUIRE(RERR_InfoMap_GetI64Array(m, "c", &values, &count));
+    REQUIRE(count == 2);
+
+    // Base is unaffected
+    REQUIRE(RERR_InfoMap_GetSize(base) == 3);
+    REQUIRE(RERR_InfoMap_GetI64(base, "b", &i64));
+    REQUIRE(RERR_InfoMap_GetString(base, "a", &s));
+    REQUIRE(s == baseStr);
+
+    RERR_InfoMap_SetU64(m, "b", 2); // Replaces tombstone
+    REQUIRE(RERR_InfoMap_GetSize(m) == 4);
+    RERR_InfoMap_Remove(m, "d"); // Only in overlay
+    REQUIRE(RERR_InfoMap_GetSize(m) == 3);
+    RERR_InfoMap_Remove(m, "c");
+    REQUIRE(RERR_InfoMap_GetSize(m) == 2);
+
+    const std::vector<std::string> expected{"a", "b"};
+
+    SECTION("Immutable") {
+        RERR_InfoMapPtr frozen = RERR_InfoMap_ImmutableCopy(m);
+        RERR_InfoMap_Destroy(m);
+        m = RERR_InfoMap_Copy(frozen);
+        REQUIRE(m == frozen);
+        RERR_InfoMap_Destroy(frozen);
+        REQUIRE(IteratedKeys(m) == expected);
+        REQUIRE(IteratedKeys(m) == expected);
+        uint64_t u64;
+        REQUIRE(RERR_InfoMap_GetU64(m, "b", &u64));
+        REQUIRE(u64 == 2);
+    }
+
+    SECTION("Mutable iteration") {
+        REQUIRE(IteratedKeys(m) == expected);
+        RERR_InfoMap_Remove(m, "a");
+        REQUIRE(RERR_InfoMap_GetSize(m) == 1);
+    }
+
+    SECTION("Flatten") {
+        RERR_InfoMap_Flatten(m);
+        RERR_InfoMap_Destroy(base);
+        base = nullptr;
+        REQUIRE(RERR_InfoMap_GetString(m, "a", &s));
+        REQUIRE(strcmp(s, "overlay") == 0);
+        REQUIRE(IteratedKeys(m) == expected);
+    }
+
+    SECTION("Clear") {
+        RERR_InfoMap_Clear(m);
+        REQUIRE(RERR_InfoMap_IsEmpty(m));
+        REQUIRE_FALSE(RERR_InfoMap_HasKey(m, "c"));
+    }
+
+    SECTION("Mutable base") {
+        RERR_InfoMapPtr copy = RERR_InfoMap_CreateOverlay(m);
+        RERR_InfoMap_SetI64(copy, "e", 5);
+        REQUIRE(RERR_InfoMap_GetSize(copy) == 3);
+        REQUIRE(RERR_InfoMap_GetSize(m) == 2);
+        RERR_InfoMap_Destroy(copy);
+    }
+
+    RERR_InfoMap_Destroy(m);
+    RERR_InfoMap_Destroy(base);
+}
+
+TEST_CASE("Overlay layers", "[RERR_InfoMap]") {
+    // Large (hash-indexed) base
+    RERR_InfoMapPtr m = RERR_InfoMap_Create();
+    char key[32]; // Room for "layer" and any int
+    for (int i = 0; i < 100; ++i) {
+        snprintf(key, sizeof(key), "base%02d", i);
+        RERR_InfoMap_SetI64(m, key, i);
+    }
+    RERR_InfoMap_MakeImmutable(m);
+
+    // Many more layers than the depth limit
+    for (int i = 0; i < 30; ++i) {
+        RERR_InfoMapPtr next = RERR_InfoMap_CreateOverlay(m);
+        snprintf(key, sizeof(key), "layer%02d", i);
+        RERR_InfoMap_SetI64(next, key, i);
+        snprintf(key, sizeof(key), "base%02d", i);
+        RERR_InfoMap_Remove(next, key);
+        RERR_InfoMap_MakeImmutable(next);
+        RERR_InfoMap_Destroy(m);
+        m = next;
+        REQUIRE(RERR_InfoMap_GetSize(m) == 100);
+    }
+
+    int64_t value;
+    REQUIRE(RERR_InfoMap_GetI64(m, "layer00", &value));
+    REQUIRE(value == 0);
+    REQUIRE(RERR_InfoMap_GetI64(m, "layer29", &value));
+    REQUIRE(value == 29);
+    REQUIRE_FALSE(RERR_InfoMap_HasKey(m, "base29"));
+    REQUIRE(RERR_InfoMap_GetI64(m, "base30", &value));
+    REQUIRE(value == 30);
+
+    // Concurrent first iteration of a shared overlay
+    std::vector<std::thread> threads;
+    std::vector<size_t> counts(4);
+    for (size_t t = 0; t < counts.size(); ++t) {
+        threads.emplace_back([&, t] {
+            size_t n = 0;
+            RERR_InfoMapIterator end = RERR_InfoMap_End(m);
+            for (RERR_InfoMapIterator it = RERR_InfoMap_Begin(m); it != end;
+                 it = RERR_InfoMap_Advance(m, it)) {
+                ++n;
+            }
+            counts[t] = n;
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t n : counts) {
+        REQUIRE(n == 100);
+    }
+    std::vector<std::string> keys = IteratedKeys(m);
+    REQUIRE(keys.front() == "base30");
+    REQUIRE(keys.back() == "layer29");
+
+    RERR_InfoMap_Destroy(m);
+}
+
 TEST_CASE("Out of memory", "[RERR_InfoMap]") {
     RERR_InfoMapPtr m = RERR_InfoMap_CreateOutOfMemory();
     REQUIRE(m != nullptr);
@@ -8,7 +8,11 @@
 
 #include "TestDefs.h"
 
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
 
 TEST_CASE("C++ Example") {
     RERR::Error noerror;
@@ -40,6 +44,15 @@ TEST_CASE("C++ Example") {
         REQUIRE(!e2.GetMessage().empty());
     }
 
+    RERR_DomainHandle handle;
+    REQUIRE(RERR::LookupDomain(domain, handle).IsSuccess());
+    RERR::Error herr(handle, 43, TESTSTR("msg"));
+    REQUIRE(herr.GetDomain() == domain);
+    REQUIRE(herr.GetCode() == 43);
+    RERR::Error hwrapped(std::move(herr), handle, 44, TESTSTR("msg"));
+    REQUIRE(hwrapped.GetCode() == 44);
+    REQUIRE(hwrapped.GetCause().GetCode() == 43);
+
     // C++ to C
     RERR::Error err3(TESTSTR("msg"));
     std::string msg3 = err3.GetMessage();
@@ -72,3 +85,192 @@ TEST_CASE("C++ Example") {
 
     RERR::UnregisterAllDomains();
 }
+
+TEST_CASE("C++ static messages are not copied") {
+    static const char literal[] = "literal msg";
+    RERR_ErrorPtr cptr =
+        RERR::Error(RERR::StaticMessage(literal)).ReleaseCPtr();
+    REQUIRE(RERR_Error_GetMessage(cptr) == literal);
+    RERR_Error_Destroy(cptr);
+
+    // Messages are copied unless marked static
+    const char local[] = "local msg";
+    cptr = RERR::Error(local).ReleaseCPtr();
+    REQUIRE(RERR_Error_GetMessage(cptr) != local);
+    REQUIRE(std::string(RERR_Error_GetMessage(cptr)) == local);
+    RERR_Error_Destroy(cptr);
+
+    RERR::Error wrapped{RERR::Error(RERR::StaticMessage(literal)),
+                        RERR::StaticMessage(literal)};
+    cptr = wrapped.ReleaseCPtr();
+    REQUIRE(RERR_Error_GetMessage(cptr) == literal);
+    REQUIRE(RERR_Error_GetMessage(RERR_Error_GetCause(cptr)) == literal);
+    RERR_Error_Destroy(cptr);
+}
+
+TEST_CASE("C++ code formatting into buffers") {
+    const char *domain = TESTSTR("domain");
+    REQUIRE(RERR::RegisterDomain(domain, RERR_CodeFormat_I16 |
+                                             RERR_CodeFormat_Hex16)
+                .IsSuccess());
+    RERR::Error err(domain, 42, TESTSTR("msg"));
+    REQUIRE(err.FormatCode() == "42 (0x002a)");
+
+    char buf[RERR_FORMATTED_CODE_MAX_SIZE];
+    REQUIRE(err.FormatCode(buf, sizeof(buf)) == 11);
+    REQUIRE(std::string(buf) == "42 (0x002a)");
+    REQUIRE(err.FormatCode(buf, 3) == 2);
+    REQUIRE(std::string(buf) == "42");
+
+    std::string s = "code ";
+    s.reserve(64);
+    const char *data = s.data();
+    err.AppendFormattedCode(s);
+    REQUIRE(s == "code 42 (0x002a)");
+    REQUIRE(s.data() == data);
+
+    RERR::UnregisterAllDomains();
+}
+
+TEST_CASE("C++ error formatting") {
+    const char *domain = TESTSTR("domain");
+    REQUIRE(RERR::RegisterDomain(domain, RERR_CodeFormat_I32).IsSuccess());
+    RERR::Error err(RERR::Error("root"), domain, 7, "outer");
+    std::string expected =
+        std::string("outer [") + domain + " 7]\nCaused by: root";
+
+    REQUIRE(err.Format() == expected);
+
+    std::string s = "> ";
+    err.Format(s);
+    REQUIRE(s == "> " + expected);
+
+    std::ostringstream os;
+    err.Format(os);
+    REQUIRE(os.str() == expected);
+
+    char buf[8];
+    REQUIRE(err.Format(buf, sizeof(buf)) == expected.size());
+    REQUIRE(std::string(buf) == expected.substr(0, sizeof(buf) - 1));
+    char big[128];
+    REQUIRE(err.Format(big, sizeof(big)) == expected.size());
+    REQUIRE(std::string(big) == expected);
+
+    REQUIRE(err.Format(RERR_ErrorFormatJSON).front() == '[');
+
+    RERR::UnregisterAllDomains();
+}
+
+TEST_CASE("C++ error and info views") {
+    const char *domain = TESTSTR("domain");
+    REQUIRE(RERR::RegisterDomain(domain, RERR_CodeFormat_I32).IsSuccess());
+    RERR::InfoMap info{RERR::InfoMap::InitItem::I64("channel", 3)};
+    RERR_ErrorPtr cInner = RERR_Error_CreateWithInfo(
+        domain, 5, info.ReleaseCPtr(), TESTSTR("inner"));
+    RERR::Error err(RERR::Error(std::move(cInner)), TESTSTR("outer"));
+
+    RERR::ErrorView view = err.View();
+    REQUIRE(view.IsError());
+    REQUIRE(!view.HasCode());
+    REQUIRE(view.GetInfo().IsEmpty());
+    REQUIRE(view.GetCause().GetCode() == 5);
+    REQUIRE(view.GetCause().GetCause().IsSuccess());
+
+    std::vector<int32_t> codes;
+    for (RERR::ErrorView e : view.CauseChain()) {
+        codes.push_back(e.GetCode());
+    }
+    REQUIRE(codes == std::vector<int32_t>{0, 5});
+    REQUIRE(std::distance(view.CauseChain().begin(),
+                          view.CauseChain().end()) == 2);
+    REQUIRE(RERR::ErrorView().CauseChain().begin() ==
+            RERR::ErrorView().CauseChain().end());
+
+    RERR::InfoMapView infoView = view.GetCause().GetInfo();
+    int64_t channel = 0;
+    REQUIRE(infoView.GetI64("channel", channel));
+    REQUIRE(channel == 3);
+    std::size_t n = 0;
+    for (auto item : infoView) {
+        REQUIRE(item.GetKey() == "channel");
+        ++n;
+    }
+    REQUIRE(n == 1);
+    REQUIRE(err.BorrowInfo().GetCPtr() == nullptr);
+
+    RERR::UnregisterAllDomains();
+}
+
+TEST_CASE("C++ serialization") {
+    RERR::Error err(RERR::Error("root"), "outer");
+    std::vector<unsigned char> data = err.Serialize();
+    RERR::Error decoded;
+    REQUIRE(RERR::Error::Deserialize(data.data(), data.size(), decoded)
+                .IsSuccess());
+    REQUIRE(decoded.Format() == "outer\nCaused by: root");
+
+    REQUIRE(RERR::Error::Deserialize(data.data(), 3, decoded).GetCode() ==
+            RERR_ECODE_SERIAL_MALFORMED);
+    REQUIRE(decoded.IsSuccess());
+}
+
+TEST_CASE("C++ string arguments") {
+    const char *domain = TESTSTR("domain");
+    REQUIRE(RERR::RegisterDomain(domain, RERR_CodeFormat_I32).IsSuccess());
+
+    std::string text = "message and more";
+    const char *ptr = text.c_str();
+    RERR::Error err(RERR::StringRef(ptr, 7));
+    REQUIRE(err.GetMessage() == "message");
+    RERR::Error coded(domain, 1, text);
+    REQUIRE(coded.GetMessage() == text);
+    RERR::Error wrapped(std::move(coded), domain, 2, ptr);
+    REQUIRE(wrapped.GetMessage() == text);
+    REQUIRE(wrapped.GetMessageCStr() != ptr); // Pointers are copied
+
+    RERR::InfoMap info;
+    info.SetString("key", RERR::StringRef(ptr + 8, 3));
+    std::string value;
+    REQUIRE(info.GetString("key", value));
+    REQUIRE(value == "and");
+
+#ifdef RERR_HAVE_STRING_VIEW
+    std::string_view view(text);
+    RERR::Error fromView(domain, 3, view.substr(0, 7));
+    REQUIRE(fromView.GetMessage() == "message");
+    info.SetString("view", view.substr(12));
+    std::string_view got;
+    REQUIRE(info.GetString("view", got));
+    REQUIRE(got == "more");
+    REQUIRE((*info.begin()).GetStringView() == "and");
+#endif
+
+    RERR::UnregisterAllDomains();
+}
+
+TEST_CASE("C++ deferred messages") {
+    const char *domain = TESTSTR("domain");
+    REQUIRE(RERR::RegisterDomain(domain, RERR_CodeFormat_I32).IsSuccess());
+    RERR_DomainHandle handle;
+    REQUIRE(RERR::LookupDomain(domain, handle).IsSuccess());
+
+    int port = 8080;
+    auto cause = RERR::Error::Deferred(handle, 1, [port] {
+        return "cannot bind port " + std::to_string(port);
+    });
+    REQUIRE(cause.GetCode() == 1);
+    auto wrapped = RERR::Error::Deferred(std::move(cause), handle, 2, [] {
+        return std::string("server failed to start");
+    });
+    REQUIRE(cause.IsSuccess());
+    REQUIRE(wrapped.GetCode() == 2);
+    REQUIRE(wrapped.GetMessage() == "server failed to start");
+    REQUIRE(wrapped.GetCause().GetMessage() == "cannot bind port 8080");
+
+    auto throwing = RERR::Error::Deferred(handle, 3, []() -> std::string {
+        throw std::runtime_error("oops");
+    });
+    REQUIRE(throwing.GetMessage() == "(error message unavailable)");
+
+    RERR::UnregisterAllDomains();
+}
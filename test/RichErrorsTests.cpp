@@ -4,11 +4,19 @@
 
 #include <catch2/catch.hpp>
 
+#include "RichErrors/Inline.h"
 #include "RichErrors/RichErrors.h"
 
 #include "TestDefs.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
 
 TEST_CASE("No-error should behave normally") {
     RERR_ErrorPtr noerr = RERR_NO_ERROR;
@@ -149,6 +157,40 @@ TEST_CASE("Create without code") {
     REQUIRE(RERR_Error_GetMessage(err) != NULL);
     REQUIRE(strlen(RERR_Error_GetMessage(err)) > 0);
     RERR_Error_Destroy(err);
+
+    // Long message
+    std::string longMsg(1000, 'x');
+    err = RERR_Error_Create(longMsg.c_str());
+    REQUIRE(RERR_Error_GetMessage(err) == longMsg);
+    RERR_Error_Destroy(err);
+}
+
+TEST_CASE("Create with static message") {
+    static const char msg[] = "static msg";
+    RERR_ErrorPtr err = RERR_Error_CreateStatic(msg);
+    REQUIRE(err != RERR_NO_ERROR);
+    REQUIRE(RERR_Error_GetMessage(err) == msg); // Not a copy
+
+    const char *domain = TESTSTR("domain");
+    RERR_ErrorPtr e = RERR_Domain_Register(domain, RERR_CodeFormat_I32);
+    REQUIRE(e == RERR_NO_ERROR);
+
+    err = RERR_Error_WrapWithCodeStatic(err, domain, 42, msg);
+    REQUIRE(RERR_Error_GetCode(err) == 42);
+    REQUIRE(RERR_Error_GetMessage(err) == msg);
+    REQUIRE(RERR_Error_GetMessage(RERR_Error_GetCause(err)) == msg);
+    RERR_Error_Destroy(err);
+
+    // Validation is the same as for the copying variant
+    err = RERR_Error_CreateWithCodeStatic(TESTSTR("nonexistent"), 1, msg);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_DOMAIN_NOT_REGISTERED);
+    RERR_Error_Destroy(err);
+
+    err = RERR_Error_CreateStatic("");
+    REQUIRE(strlen(RERR_Error_GetMessage(err)) > 0);
+    RERR_Error_Destroy(err);
+
+    RERR_Domain_UnregisterAll();
 }
 
 TEST_CASE("Create with code") {
@@ -193,6 +235,324 @@ TEST_CASE("Create with code") {
     RERR_Domain_UnregisterAll();
 }
 
+TEST_CASE("Create with info") {
+    const char *domain = TESTSTR("domain");
+    RERR_ErrorPtr e = RERR_Domain_Register(domain, RERR_CodeFormat_I32);
+    REQUIRE(e == RERR_NO_ERROR);
+
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetI64(info, "channel", 3);
+    RERR_ErrorPtr err =
+        RERR_Error_CreateWithInfo(domain, 42, info, TESTSTR("msg"));
+    REQUIRE(RERR_Error_HasInfo(err));
+    RERR_InfoMapPtr got = RERR_Error_GetInfo(err);
+    int64_t channel;
+    REQUIRE(RERR_InfoMap_GetI64(got, "channel", &channel));
+    REQUIRE(channel == 3);
+    RERR_InfoMap_Destroy(got);
+
+    RERR_InfoMapPtr borrowed = RERR_Error_BorrowInfo(err);
+    REQUIRE(RERR_InfoMap_GetI64(borrowed, "channel", &channel));
+    REQUIRE(channel == 3);
+    REQUIRE(RERR_Error_BorrowInfo(RERR_NO_ERROR) == NULL);
+    REQUIRE(RERR_Error_BorrowInfo(RERR_Error_CreateOutOfMemory()) == NULL);
+
+    // The info map is released with the error (checked by leak detection)
+    RERR_ErrorPtr copy;
+    RERR_Error_Copy(err, &copy);
+    RERR_Error_Destroy(err);
+    REQUIRE(RERR_Error_HasInfo(copy));
+    RERR_Error_Destroy(RERR_Error_Wrap(copy, TESTSTR("wrapper")));
+
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Stats") {
+    RERR_Stats before;
+    RERR_Stats after;
+    if (!RERR_Stats_Get(&before)) {
+        REQUIRE(before.errorsCreated == 0);
+        REQUIRE(before.bytesAllocated == 0);
+        return;
+    }
+
+    RERR_ErrorPtr err = RERR_Error_Create(TESTSTR("msg"));
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    REQUIRE(RERR_Stats_Get(&after));
+    REQUIRE(after.errorsLive == before.errorsLive + 1);
+    REQUIRE(after.errorsCreated == before.errorsCreated + 1);
+    REQUIRE(after.infoMapsLive == before.infoMapsLive + 1);
+    REQUIRE(after.infoMapsCreated == before.infoMapsCreated + 1);
+
+    RERR_Error_Destroy(err);
+    RERR_InfoMap_Destroy(info);
+    REQUIRE(RERR_Stats_Get(&after));
+    REQUIRE(after.errorsLive == before.errorsLive);
+    REQUIRE(after.infoMapsLive == before.infoMapsLive);
+    REQUIRE(after.allocationsLive <= before.allocationsLive + 2); // Pool
+
+    REQUIRE(RERR_Domain_Register(TESTSTR("domain"), RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    REQUIRE(RERR_Stats_Get(&after));
+    REQUIRE(after.domainsRegistered == before.domainsRegistered + 1);
+    REQUIRE(after.bytesAllocated > before.bytesAllocated);
+    RERR_Domain_UnregisterAll();
+    REQUIRE(RERR_Stats_Get(&after));
+    REQUIRE(after.domainsRegistered == 0);
+}
+
+TEST_CASE("Create with domain handle") {
+    const char *domain = TESTSTR("domain");
+    RERR_DomainHandle handle;
+
+    // Cannot look up unregistered domain
+    RERR_ErrorPtr err = RERR_Domain_Lookup(domain, &handle);
+    REQUIRE(handle == nullptr);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_DOMAIN_NOT_REGISTERED);
+    RERR_Error_Destroy(err);
+
+    err = RERR_Domain_Lookup(NULL, &handle);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_NULL_ARGUMENT);
+    RERR_Error_Destroy(err);
+
+    REQUIRE(RERR_Domain_Register(domain, RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    REQUIRE(RERR_Domain_Lookup(domain, &handle) == RERR_NO_ERROR);
+    REQUIRE(handle != nullptr);
+
+    RERR_DomainHandle handle2;
+    REQUIRE(RERR_Domain_Lookup(domain, &handle2) == RERR_NO_ERROR);
+    REQUIRE(handle2 == handle);
+
+    const char *msg = TESTSTR("msg");
+    err = RERR_Error_CreateWithDomainHandle(handle, 42, msg);
+    REQUIRE(RERR_Error_HasCode(err));
+    REQUIRE(strcmp(RERR_Error_GetDomain(err), domain) == 0);
+    REQUIRE(RERR_Error_GetCode(err) == 42);
+    REQUIRE(strcmp(RERR_Error_GetMessage(err), msg) == 0);
+
+    RERR_ErrorPtr wrap =
+        RERR_Error_WrapWithDomainHandle(err, handle, 43, TESTSTR("msg"));
+    REQUIRE(RERR_Error_GetCode(wrap) == 43);
+    REQUIRE(RERR_Error_GetCause(wrap) == err);
+    RERR_Error_Destroy(wrap);
+
+    // Null handle allowed only without code
+    err = RERR_Error_CreateWithDomainHandle(NULL, 0, TESTSTR("msg"));
+    REQUIRE(err != RERR_NO_ERROR);
+    REQUIRE(!RERR_Error_HasCode(err));
+    RERR_Error_Destroy(err);
+    err = RERR_Error_CreateWithDomainHandle(NULL, 42, TESTSTR("msg"));
+    REQUIRE(strcmp(RERR_Error_GetDomain(err), RERR_DOMAIN_RICHERRORS) == 0);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_NULL_ARGUMENT);
+    RERR_Error_Destroy(err);
+
+    // System domains can be looked up
+    REQUIRE(RERR_Domain_Lookup(RERR_DOMAIN_RICHERRORS, &handle) ==
+            RERR_NO_ERROR);
+    REQUIRE(handle != nullptr);
+
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Concurrent domain registration and lookup") {
+    const char *domain = TESTSTR("domain");
+    REQUIRE(RERR_Domain_Register(domain, RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                RERR_ErrorPtr err = RERR_Error_CreateWithCode(domain, 42, "");
+                if (strcmp(RERR_Error_GetDomain(err), domain) != 0 ||
+                    RERR_Error_GetCode(err) != 42) {
+                    ++failures;
+                }
+                RERR_Error_Destroy(err);
+            }
+        });
+    }
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 100; ++i) {
+        names.push_back(std::string(TESTSTR("domain")) + '-' +
+                        std::to_string(i));
+    }
+    for (auto const &name : names) {
+        RERR_ErrorPtr err =
+            RERR_Domain_Register(name.c_str(), RERR_CodeFormat_I32);
+        if (err != RERR_NO_ERROR) {
+            ++failures;
+            RERR_Error_Destroy(err);
+        }
+    }
+
+    done = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    REQUIRE(failures == 0);
+
+    for (auto const &name : names) {
+        RERR_ErrorPtr err = RERR_Error_CreateWithCode(name.c_str(), 1, "");
+        REQUIRE(strcmp(RERR_Error_GetDomain(err), name.c_str()) == 0);
+        RERR_Error_Destroy(err);
+    }
+
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Copies can be destroyed concurrently") {
+    const char *domain = TESTSTR("domain");
+    RERR_ErrorPtr e = RERR_Domain_Register(domain, RERR_CodeFormat_I32);
+    REQUIRE(e == RERR_NO_ERROR);
+
+    RERR_ErrorPtr err = RERR_Error_WrapWithCode(
+        RERR_Error_Create(TESTSTR("msg")), domain, 42, TESTSTR("msg"));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        std::vector<RERR_ErrorPtr> copies(1000);
+        for (auto &copy : copies) {
+            RERR_Error_Copy(err, &copy);
+        }
+        threads.emplace_back([copies] {
+            for (auto copy : copies) {
+                (void)RERR_Error_GetMessage(RERR_Error_GetCause(copy));
+                RERR_Error_Destroy(copy);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(RERR_Error_GetCode(err) == 42);
+    RERR_Error_Destroy(err);
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Pool") {
+    REQUIRE(RERR_Pool_Reserve(4, 2) == RERR_NO_ERROR);
+
+    std::vector<RERR_ErrorPtr> errs;
+    for (int i = 0; i < 8; ++i) {
+        errs.push_back(RERR_Error_Create(TESTSTR("msg")));
+    }
+    std::string longMsg(1000, 'x');
+    errs.push_back(RERR_Error_Create(longMsg.c_str()));
+    REQUIRE(RERR_Error_GetMessage(errs.back()) == longMsg);
+
+    // Blocks freed on another thread join that thread's pool
+    std::thread t([errs] {
+        for (auto err : errs) {
+            RERR_Error_Destroy(err);
+        }
+        RERR_Pool_Drain();
+    });
+    t.join();
+
+    RERR_Pool_SetLimits(0, 0);
+    const char *msg = TESTSTR("msg");
+    RERR_ErrorPtr err = RERR_Error_Create(msg);
+    REQUIRE(strcmp(RERR_Error_GetMessage(err), msg) == 0);
+    RERR_Error_Destroy(err);
+
+    RERR_Pool_SetLimits(32, 32);
+    RERR_Pool_Drain();
+}
+
+namespace {
+
+struct TestAllocatorState {
+    int allocations;
+    int frees;
+    int failAfter; // Fail allocations once this many have succeeded
+};
+
+void *TestAlloc(void *context, size_t size) {
+    auto state = static_cast<TestAllocatorState *>(context);
+    if (state->allocations >= state->failAfter) {
+        return nullptr;
+    }
+    ++state->allocations;
+    return malloc(size);
+}
+
+void *TestRealloc(void *context, void *ptr, size_t size) {
+    auto state = static_cast<TestAllocatorState *>(context);
+    if (!ptr) {
+        return TestAlloc(context, size);
+    }
+    if (state->allocations >= state->failAfter) {
+        return nullptr;
+    }
+    return realloc(ptr, size);
+}
+
+void TestFree(void *context, void *ptr) {
+    auto state = static_cast<TestAllocatorState *>(context);
+    if (ptr) {
+        ++state->frees;
+    }
+    free(ptr);
+}
+
+} // namespace
+
+TEST_CASE("Custom allocator") {
+    // Pooled blocks belong to the previous allocator, and would also
+    // prevent us from observing allocations.
+    RERR_Pool_SetLimits(0, 0);
+
+    TestAllocatorState state{0, 0, 1000};
+    RERR_Allocator allocator{TestAlloc, TestRealloc, TestFree, &state};
+    REQUIRE(RERR_Allocator_Set(&allocator) == RERR_NO_ERROR);
+
+    RERR_Allocator current;
+    RERR_Allocator_Get(&current);
+    REQUIRE(current.context == &state);
+
+    const char *domain = TESTSTR("domain");
+    RERR_ErrorPtr err = RERR_Domain_Register(domain, RERR_CodeFormat_I32);
+    REQUIRE(err == RERR_NO_ERROR);
+
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(info, "key", "value");
+    REQUIRE(RERR_InfoMap_GetSize(info) == 1);
+    RERR_InfoMap_Destroy(info);
+    err = RERR_Error_CreateWithCode(domain, 42, TESTSTR("msg"));
+    err = RERR_Error_Wrap(err, TESTSTR("msg"));
+    REQUIRE(state.allocations > 0);
+    REQUIRE(!RERR_Error_IsOutOfMemory(err));
+    RERR_Error_Destroy(err);
+
+    // Allocation failure yields the out-of-memory sentinels
+    state.failAfter = state.allocations;
+    err = RERR_Error_Create(TESTSTR("msg"));
+    REQUIRE(RERR_Error_IsOutOfMemory(err));
+    err = RERR_Error_Wrap(err, TESTSTR("msg"));
+    REQUIRE(RERR_Error_IsOutOfMemory(err));
+    RERR_Error_Destroy(err);
+    info = RERR_InfoMap_Create();
+    REQUIRE(RERR_InfoMap_IsOutOfMemory(info));
+    RERR_InfoMap_Destroy(info);
+
+    RERR_Domain_UnregisterAll();
+    REQUIRE(RERR_Allocator_Set(NULL) == RERR_NO_ERROR);
+    RERR_Pool_SetLimits(32, 32);
+
+    REQUIRE(state.frees == state.allocations);
+
+    RERR_Allocator bad{TestAlloc, TestRealloc, nullptr, &state};
+    err = RERR_Allocator_Set(&bad);
+    REQUIRE(RERR_Error_GetCode(err) == RERR_ECODE_NULL_ARGUMENT);
+    RERR_Error_Destroy(err);
+}
+
 TEST_CASE("Wrap without code") {
     RERR_ErrorPtr cause = RERR_Error_Create(TESTSTR("msg"));
     RERR_ErrorPtr wrap = RERR_Error_Wrap(cause, TESTSTR("msg"));
@@ -308,4 +668,440 @@ TEST_CASE("Code formatting") {
     FormatCode(RERR_CodeFormat_I32 | RERR_CodeFormat_Hex32, -1, buf,
                strlen("-1 (0x") + 1);
     CHECK(strcmp(buf, "-1") == 0);
+
+    // Extremes
+    FormatCode(RERR_CodeFormat_I32, INT32_MIN, buf, sizeof(buf));
+    CHECK(strcmp(buf, "-2147483648") == 0);
+    FormatCode(RERR_CodeFormat_I16, -32768, buf, sizeof(buf));
+    CHECK(strcmp(buf, "-32768") == 0);
+    FormatCode(RERR_CodeFormat_U16 | RERR_CodeFormat_Hex16, 0x12345, buf,
+               sizeof(buf));
+    CHECK(strcmp(buf, "9029 (0x2345)") == 0);
+    FormatCode(RERR_CodeFormat_Hex32 | RERR_CodeFormat_HexNoPad, 0xabc, buf,
+               sizeof(buf));
+    CHECK(strcmp(buf, "0xabc") == 0);
+    FormatCode(RERR_CodeFormat_I32, 1234567890, buf, sizeof(buf));
+    CHECK(strcmp(buf, "1234567890") == 0);
+}
+
+TEST_CASE("Code formatting with length") {
+    char buf[RERR_FORMATTED_CODE_MAX_SIZE];
+    CHECK(RERR_Error_FormatCodeLen(RERR_NO_ERROR, NULL, 0) == 9);
+    CHECK(RERR_Error_FormatCodeLen(RERR_NO_ERROR, buf, 4) == 3);
+    CHECK(strcmp(buf, "(no") == 0);
+
+    REQUIRE(RERR_Domain_Register(
+                "test", RERR_CodeFormat_I32 | RERR_CodeFormat_Hex32) ==
+            RERR_NO_ERROR);
+    RERR_ErrorPtr err =
+        RERR_Error_CreateWithCode("test", -5, TESTSTR("msg"));
+    CHECK(RERR_Error_FormatCodeLen(err, NULL, 0) == strlen("-5 (0xfffffffb)"));
+    CHECK(RERR_Error_FormatCodeLen(err, buf, sizeof(buf)) ==
+          strlen("-5 (0xfffffffb)"));
+    CHECK(strcmp(buf, "-5 (0xfffffffb)") == 0);
+    CHECK(RERR_Error_FormatCodeLen(err, buf, 3) == 2);
+    CHECK(strcmp(buf, "-5") == 0);
+    CHECK(RERR_Error_FormatCodeLen(err, buf, 2) == 1);
+    CHECK(strcmp(buf, "?") == 0);
+    RERR_Error_Destroy(err);
+    RERR_Domain_UnregisterAll();
+}
+
+static bool AppendToString(void *context, const char *data, size_t size) {
+    static_cast<std::string *>(context)->append(data, size);
+    return true;
+}
+
+TEST_CASE("Format error chain") {
+    std::string out;
+    REQUIRE(RERR_Error_Format(RERR_NO_ERROR, AppendToString, &out, 0));
+    CHECK(out == "(no error)");
+    out.clear();
+    REQUIRE(RERR_Error_Format(RERR_NO_ERROR, AppendToString, &out,
+                              RERR_ErrorFormatJSON));
+    CHECK(out == "[]");
+
+    REQUIRE(RERR_Domain_Register("test", RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(info, "path", "C:\\a \"b\"");
+    RERR_InfoMap_SetI64(info, "n", -3);
+    RERR_InfoMap_SetBool(info, "ok", false);
+    RERR_ErrorPtr err = RERR_Error_WrapWithInfo(
+        RERR_Error_Create("root"), "test", 5, info, "outer");
+
+    out.clear();
+    REQUIRE(RERR_Error_Format(err, AppendToString, &out, 0));
+    CHECK(out == "outer [test 5] {n=-3, ok=false, path=\"C:\\a \"b\"\"}\n"
+                 "Caused by: root");
+
+    out.clear();
+    REQUIRE(RERR_Error_Format(err, AppendToString, &out,
+                              RERR_ErrorFormatNoInfo |
+                                  RERR_ErrorFormatNoCauses));
+    CHECK(out == "outer [test 5]");
+
+    out.clear();
+    REQUIRE(RERR_Error_Format(err, AppendToString, &out,
+                              RERR_ErrorFormatJSON));
+    CHECK(out == "[{\"message\": \"outer\", \"domain\": \"test\", "
+                 "\"code\": 5, \"formattedCode\": \"5\", \"info\": "
+                 "{\"n\": -3, \"ok\": false, \"path\": "
+                 "\"C:\\\\a \\\"b\\\"\"}}, {\"message\": \"root\"}]");
+
+    RERR_InfoMapPtr blobsInfo = RERR_InfoMap_Create();
+    const unsigned char bytes[] = {0x0f, 0xa0};
+    const int64_t ints[] = {1, -2};
+    const double doubles[] = {0.5, INFINITY};
+    RERR_InfoMap_SetBytes(blobsInfo, "b", bytes, sizeof(bytes));
+    RERR_InfoMap_SetF64Array(blobsInfo, "f", doubles, 2);
+    RERR_InfoMap_SetI64Array(blobsInfo, "i", ints, 2);
+    RERR_ErrorPtr blobs =
+        RERR_Error_CreateWithInfo("test", 6, blobsInfo, "blobs");
+    out.clear();
+    REQUIRE(RERR_Error_Format(blobs, AppendToString, &out, 0));
+    CHECK(out == "blobs [test 6] {b=0x0fa0, f=[0.5, inf], i=[1, -2]}");
+    out.clear();
+    REQUIRE(RERR_Error_Format(blobs, AppendToString, &out,
+                              RERR_ErrorFormatJSON));
+    CHECK(out == "[{\"message\": \"blobs\", \"domain\": \"test\", "
+                 "\"code\": 6, \"formattedCode\": \"6\", \"info\": "
+                 "{\"b\": \"0fa0\", \"f\": [0.5, null], "
+                 "\"i\": [1, -2]}}]");
+    RERR_Error_Destroy(blobs);
+
+    // Writing stops when the sink fails
+    int calls = 0;
+    CHECK_FALSE(RERR_Error_Format(
+        err,
+        [](void *context, const char *, size_t) {
+            ++*static_cast<int *>(context);
+            return false;
+        },
+        &calls, 0));
+    CHECK(calls == 1);
+    CHECK_FALSE(RERR_Error_Format(err, NULL, NULL, 0));
+
+    RERR_Error_Destroy(err);
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Serialize round trip") {
+    REQUIRE(RERR_Domain_Register("test", RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetString(info, "path", "/dev/cam0");
+    RERR_InfoMap_SetBool(info, "ok", true);
+    RERR_InfoMap_SetI64(info, "i", -7);
+    RERR_InfoMap_SetU64(info, "u", UINT64_MAX);
+    RERR_InfoMap_SetF64(info, "f", 0.25);
+    const unsigned char bytes[] = {1, 2, 3};
+    const int64_t ints[] = {-1, INT64_MIN};
+    const double doubles[] = {1.5};
+    RERR_InfoMap_SetBytes(info, "b", bytes, sizeof(bytes));
+    RERR_InfoMap_SetI64Array(info, "ia", ints, 2);
+    RERR_InfoMap_SetF64Array(info, "fa", doubles, 1);
+    RERR_ErrorPtr err = RERR_Error_WrapWithInfo(
+        RERR_Error_Wrap(RERR_Error_CreateOutOfMemory(), "middle"), "test",
+        -3, info, "outer");
+
+    size_t size = RERR_Error_Serialize(err, NULL, 0);
+    std::vector<unsigned char> buf(size);
+    CHECK(RERR_Error_Serialize(err, buf.data(), size - 1) == size);
+    REQUIRE(RERR_Error_Serialize(err, buf.data(), size) == size);
+
+    for (uint32_t flags : {0u, (uint32_t)RERR_DeserializeBorrowStrings}) {
+        RERR_ErrorPtr decoded;
+        REQUIRE(RERR_Error_Deserialize(buf.data(), size, flags, &decoded) ==
+                RERR_NO_ERROR);
+        CHECK(strcmp(RERR_Error_GetDomain(decoded), "test") == 0);
+        CHECK(RERR_Error_GetCode(decoded) == -3);
+        CHECK(strcmp(RERR_Error_GetMessage(decoded), "outer") == 0);
+        bool borrowed = RERR_Error_GetMessage(decoded) >=
+                            reinterpret_cast<const char *>(buf.data()) &&
+                        RERR_Error_GetMessage(decoded) <
+                            reinterpret_cast<const char *>(buf.data()) + size;
+        CHECK(borrowed == (flags != 0));
+
+        RERR_InfoMapPtr got = RERR_Error_BorrowInfo(decoded);
+        CHECK(RERR_InfoMap_GetSize(got) == 8);
+        const char *s;
+        bool b;
+        int64_t i;
+        uint64_t u;
+        double f;
+        CHECK((RERR_InfoMap_GetString(got, "path", &s) &&
+               strcmp(s, "/dev/cam0") == 0));
+        CHECK((RERR_InfoMap_GetBool(got, "ok", &b) && b));
+        CHECK((RERR_InfoMap_GetI64(got, "i", &i) && i == -7));
+        CHECK((RERR_InfoMap_GetU64(got, "u", &u) && u == UINT64_MAX));
+        CHECK((RERR_InfoMap_GetF64(got, "f", &f) && f == 0.25));
+        const void *data;
+        size_t n;
+        CHECK((RERR_InfoMap_GetBytes(got, "b", &data, &n) && n == 3 &&
+               memcmp(data, bytes, 3) == 0));
+        const int64_t *is;
+        CHECK((RERR_InfoMap_GetI64Array(got, "ia", &is, &n) && n == 2 &&
+               is[0] == -1 && is[1] == INT64_MIN));
+        const double *fs;
+        CHECK((RERR_InfoMap_GetF64Array(got, "fa", &fs, &n) && n == 1 &&
+               fs[0] == 1.5));
+
+        RERR_ErrorPtr middle = RERR_Error_GetCause(decoded);
+        CHECK(!RERR_Error_HasCode(middle));
+        CHECK(strcmp(RERR_Error_GetMessage(middle), "middle") == 0);
+        CHECK(RERR_Error_IsOutOfMemory(RERR_Error_GetCause(middle)));
+        RERR_Error_Destroy(decoded);
+    }
+
+    RERR_ErrorPtr decoded;
+    size_t noErrSize = RERR_Error_Serialize(RERR_NO_ERROR, buf.data(), size);
+    REQUIRE(RERR_Error_Deserialize(buf.data(), noErrSize, 0, &decoded) ==
+            RERR_NO_ERROR);
+    CHECK(decoded == RERR_NO_ERROR);
+
+    RERR_Error_Destroy(err);
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Deserialize rejects bad input") {
+    REQUIRE(RERR_Domain_Register("test", RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    RERR_ErrorPtr err = RERR_Error_Wrap(
+        RERR_Error_CreateWithCode("test", 1, "inner"), "outer");
+    std::vector<unsigned char> buf(RERR_Error_Serialize(err, NULL, 0));
+    RERR_Error_Serialize(err, buf.data(), buf.size());
+    RERR_Error_Destroy(err);
+
+    // Every truncation fails without reading out of bounds
+    for (size_t n = 0; n < buf.size(); ++n) {
+        std::vector<unsigned char> truncated(buf.begin(), buf.begin() + n);
+        RERR_ErrorPtr decoded;
+        RERR_ErrorPtr e = RERR_Error_Deserialize(
+            truncated.data(), truncated.size(), 0, &decoded);
+        CHECK(RERR_Error_GetCode(e) == RERR_ECODE_SERIAL_MALFORMED);
+        CHECK(decoded == RERR_NO_ERROR);
+        RERR_Error_Destroy(e);
+    }
+
+    RERR_ErrorPtr decoded;
+    buf[4] = RERR_SERIAL_VERSION + 1;
+    RERR_ErrorPtr e = RERR_Error_Deserialize(buf.data(), buf.size(), 0,
+                                             &decoded);
+    CHECK(RERR_Error_GetCode(e) == RERR_ECODE_SERIAL_VERSION);
+    RERR_Error_Destroy(e);
+    buf[4] = RERR_SERIAL_VERSION;
+
+    RERR_Domain_UnregisterAll();
+    e = RERR_Error_Deserialize(buf.data(), buf.size(), 0, &decoded);
+    CHECK(RERR_Error_GetCode(e) == RERR_ECODE_DOMAIN_NOT_REGISTERED);
+    CHECK(decoded == RERR_NO_ERROR);
+    RERR_Error_Destroy(e);
+}
+
+TEST_CASE("Create with message length") {
+    const char text[] = "message and more";
+    RERR_ErrorPtr err = RERR_Error_CreateN(text, 7);
+    CHECK(strcmp(RERR_Error_GetMessage(err), "message") == 0);
+    RERR_ErrorPtr wrapped = RERR_Error_WrapN(err, text + 12, 4);
+    CHECK(strcmp(RERR_Error_GetMessage(wrapped), "more") == 0);
+    RERR_Error_Destroy(wrapped);
+
+    REQUIRE(RERR_Domain_Register("test", RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    err = RERR_Error_CreateWithCodeN("test", 3, text, 0);
+    CHECK(RERR_Error_GetCode(err) == 3);
+    CHECK(strcmp(RERR_Error_GetMessage(err), "(empty error message)") == 0);
+
+    RERR_InfoMapPtr info = RERR_InfoMap_Create();
+    RERR_InfoMap_SetStringN(info, "key", text + 8, 3);
+    wrapped = RERR_Error_WrapWithInfoN(err, "test", 4, info, text, 11);
+    CHECK(strcmp(RERR_Error_GetMessage(wrapped), "message and") == 0);
+    const char *value;
+    REQUIRE(RERR_InfoMap_GetString(RERR_Error_BorrowInfo(wrapped), "key",
+                                   &value));
+    CHECK(strcmp(value, "and") == 0);
+    RERR_Error_Destroy(wrapped);
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Inline accessors") {
+    REQUIRE(RERR_INLINE_ABI_IS_COMPATIBLE());
+
+    REQUIRE(RERR_Domain_Register("test", RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    RERR_ErrorPtr noCode = RERR_Error_Create("msg");
+    RERR_ErrorPtr withCode = RERR_Error_CreateWithCode("test", -42, "msg");
+    RERR_ErrorPtr errs[] = {RERR_NO_ERROR, RERR_Error_CreateOutOfMemory(),
+                            noCode, withCode};
+    for (RERR_ErrorPtr err : errs) {
+        CHECK(RERR_Inline_IsOutOfMemory(err) == RERR_Error_IsOutOfMemory(err));
+        CHECK(RERR_Inline_HasCode(err) == RERR_Error_HasCode(err));
+        CHECK(RERR_Inline_GetCode(err) == RERR_Error_GetCode(err));
+    }
+    CHECK(RERR_Inline_GetCode(withCode) == -42);
+    RERR_Error_Destroy(noCode);
+    RERR_Error_Destroy(withCode);
+    RERR_Domain_UnregisterAll();
+}
+
+namespace {
+
+struct DeferredArgs {
+    const char *what;
+    int count;
+    std::atomic<int> *calls;
+};
+
+size_t FormatDeferredArgs(char *dest, size_t destSize, const void *args) {
+    auto a = static_cast<const DeferredArgs *>(args);
+    ++*a->calls;
+    if (a->count < 0) {
+        return RERR_MESSAGE_FORMAT_FAILED;
+    }
+    std::string msg(static_cast<size_t>(a->count), '.');
+    int n = snprintf(dest, destSize, "%s%s", a->what, msg.c_str());
+    return static_cast<size_t>(n);
+}
+
+} // namespace
+
+TEST_CASE("Deferred message") {
+    REQUIRE(RERR_Domain_Register("test", RERR_CodeFormat_I32) ==
+            RERR_NO_ERROR);
+    RERR_DomainHandle domain;
+    REQUIRE(RERR_Domain_Lookup("test", &domain) == RERR_NO_ERROR);
+    std::atomic<int> calls{0};
+
+    SECTION("Not formatted unless requested") {
+        DeferredArgs args{"cause", 3, &calls};
+        RERR_ErrorPtr cause = RERR_Error_CreateDeferred(
+            domain, 1, FormatDeferredArgs, &args, sizeof(args));
+        args.what = "changed after creation";
+        RERR_ErrorPtr err = RERR_Error_WrapDeferred(
+            cause, domain, 2, FormatDeferredArgs, &args, sizeof(args));
+        CHECK(RERR_Error_GetCode(err) == 2);
+        CHECK(RERR_Error_GetCode(RERR_Error_GetCause(err)) == 1);
+        CHECK(calls == 0);
+
+        const char *msg = RERR_Error_GetMessage(RERR_Error_GetCause(err));
+        CHECK(strcmp(msg, "cause...") == 0);
+        CHECK(calls == 1);
+        CHECK(RERR_Error_GetMessage(RERR_Error_GetCause(err)) == msg);
+        CHECK(calls == 1);
+        RERR_Error_Destroy(err);
+        CHECK(calls == 1);
+    }
+
+    SECTION("Long message") {
+        DeferredArgs args{"x", 1000, &calls};
+        RERR_ErrorPtr err = RERR_Error_CreateDeferred(
+            domain, 1, FormatDeferredArgs, &args, sizeof(args));
+        CHECK(strlen(RERR_Error_GetMessage(err)) == 1001);
+        RERR_Error_Destroy(err);
+    }
+
+    SECTION("Formatting failure is retried") {
+        DeferredArgs args{"x", -1, &calls};
+        RERR_ErrorPtr err = RERR_Error_CreateDeferred(
+            domain, 1, FormatDeferredArgs, &args, sizeof(args));
+        CHECK(strcmp(RERR_Error_GetMessage(err),
+                     "(error message unavailable)") == 0);
+        CHECK(strcmp(RERR_Error_GetMessage(err),
+                     "(error message unavailable)") == 0);
+        CHECK(calls == 2);
+        RERR_Error_Destroy(err);
+    }
+
+    SECTION("Concurrent first access") {
+        DeferredArgs args{"shared", 10, &calls};
+        RERR_ErrorPtr err = RERR_Error_CreateDeferred(
+            NULL, 0, FormatDeferredArgs, &args, sizeof(args));
+        std::vector<std::thread> threads;
+        std::vector<const char *> results(8);
+        for (size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back(
+                [&, i] { results[i] = RERR_Error_GetMessage(err); });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        for (const char *r : results) {
+            CHECK(r == results[0]);
+        }
+        CHECK(strcmp(results[0], "shared..........") == 0);
+        RERR_Error_Destroy(err);
+    }
+
+    SECTION("Invalid arguments") {
+        RERR_ErrorPtr err =
+            RERR_Error_CreateDeferred(domain, 1, NULL, NULL, 0);
+        CHECK(RERR_Error_GetCode(err) == RERR_ECODE_NULL_ARGUMENT);
+        RERR_Error_Destroy(err);
+        err = RERR_Error_CreateDeferred(NULL, 1, FormatDeferredArgs, NULL, 0);
+        CHECK(RERR_Error_GetCode(err) == RERR_ECODE_NULL_ARGUMENT);
+        RERR_Error_Destroy(err);
+    }
+
+    RERR_Domain_UnregisterAll();
+}
+
+TEST_CASE("Deep cause chains") {
+    RERR_Stats before;
+    bool haveStats = RERR_Stats_Get(&before);
+
+    // Uniquely owned causes are packed into arenas
+    RERR_ErrorPtr err = RERR_Error_Create("leaf");
+    for (int i = 0; i < 20; ++i) {
+        err = RERR_Error_Wrap(err, std::to_string(i).c_str());
+    }
+    if (haveStats) {
+        RERR_Stats after;
+        REQUIRE(RERR_Stats_Get(&after));
+        CHECK(after.errorsLive == before.errorsLive + 21);
+        CHECK(after.allocations - before.allocations <= 5);
+    }
+
+    RERR_ErrorPtr e = err;
+    for (int i = 19; i >= 0; --i) {
+        CHECK(RERR_Error_GetMessage(e) == std::to_string(i));
+        e = RERR_Error_GetCause(e);
+    }
+    CHECK(strcmp(RERR_Error_GetMessage(e), "leaf") == 0);
+
+    // A copy of an inner error outlives the rest of the chain
+    RERR_ErrorPtr inner;
+    RERR_Error_Copy(RERR_Error_GetCause(RERR_Error_GetCause(err)), &inner);
+    RERR_Error_Destroy(err);
+    CHECK(strcmp(RERR_Error_GetMessage(inner), "17") == 0);
+    CHECK(strcmp(RERR_Error_GetMessage(RERR_Error_GetCause(inner)), "16") ==
+          0);
+
+    // Wrapping one that is not the newest in its arena, or a shared error
+    err = RERR_Error_Wrap(inner, "wrap inner");
+    RERR_ErrorPtr copy;
+    RERR_Error_Copy(err, &copy);
+    err = RERR_Error_Wrap(err, "wrap shared");
+    RERR_Error_Destroy(copy);
+    CHECK(strcmp(RERR_Error_GetMessage(RERR_Error_GetCause(err)),
+                 "wrap inner") == 0);
+    CHECK(strcmp(RERR_Error_GetMessage(RERR_Error_GetCause(
+                     RERR_Error_GetCause(err))),
+                 "17") == 0);
+    RERR_Error_Destroy(err);
+
+    // Destruction does not recurse, even without arenas
+    err = RERR_Error_Create("leaf");
+    for (int i = 0; i < 200000; ++i) {
+        RERR_Error_Copy(err, &copy);
+        err = RERR_Error_Wrap(err, "x");
+        RERR_Error_Destroy(copy);
+    }
+    RERR_Error_Destroy(err);
+
+    if (haveStats) {
+        RERR_Stats after;
+        REQUIRE(RERR_Stats_Get(&after));
+        CHECK(after.errorsLive == before.errorsLive);
+    }
 }